@@ -0,0 +1,50 @@
+#include "ArduCastArena.h"
+
+#include <stdlib.h>
+
+ArduCastArena::ArduCastArena(uint32_t size)
+  : base((uint8_t*)malloc(size)), capacity(base != NULL ? size : 0), owned(true)
+{
+}
+
+ArduCastArena::ArduCastArena(uint8_t *buffer, uint32_t size)
+  : base(buffer), capacity(buffer != NULL ? size : 0), owned(false)
+{
+}
+
+ArduCastArena::~ArduCastArena(){
+  if ( owned )
+    free(base);
+}
+
+void* ArduCastArena::allocate(uint32_t size){
+  //keep the blocks aligned, the base from malloc already is
+  uint32_t start = ARENA_ALIGNED(used);
+  if ( size == 0 || start > capacity || size > capacity - start )
+    return NULL;
+  used = start + size;
+  if ( used > highWater )
+    highWater = used;
+  return base + start;
+}
+
+uint32_t ArduCastArena::getMark(){
+  return used;
+}
+
+void ArduCastArena::release(uint32_t mark){
+  if ( mark < used )
+    used = mark;
+}
+
+uint32_t ArduCastArena::getSize(){
+  return capacity;
+}
+
+uint32_t ArduCastArena::getUsed(){
+  return used;
+}
+
+uint32_t ArduCastArena::getHighWater(){
+  return highWater;
+}
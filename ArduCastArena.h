@@ -0,0 +1,94 @@
+/**
+ * ArduCastArena.h - Fixed size memory arena for ArduCastControl
+ * https://github.com/andrasbiro/chromecastcontrol
+ */
+
+#ifndef ARDUCASTARENA_H
+#define ARDUCASTARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Alignment of the blocks allocated from \ref ArduCastArena
+ */
+#ifndef ARENA_ALIGN
+#define ARENA_ALIGN 8
+#endif
+
+/**
+ * Rounds \ref size up to \ref ARENA_ALIGN
+ */
+#define ARENA_ALIGNED(size) (((size) + ARENA_ALIGN - 1) & ~(uint32_t)(ARENA_ALIGN - 1))
+
+/**
+ * Simple bump allocator over a single memory block, allocated (or given) at
+ * construction. Blocks can't be freed one by one, but everything allocated
+ * after a mark can be released at once (see \ref getMark() and
+ * \ref release()), which suits temporary workspaces.
+ * 
+ * The arena keeps track of the most memory ever used, so the size can be
+ * tuned to the actual use.
+ */
+class ArduCastArena {
+private:
+  uint8_t *const base;
+  const uint32_t capacity;
+  const bool owned;
+  uint32_t used = 0;
+  uint32_t highWater = 0;
+
+public:
+  /**
+   * Constructor. Allocates \ref size bytes from heap. If the allocation fails,
+   * the arena has 0 size.
+   */
+  ArduCastArena(uint32_t size);
+
+  /**
+   * Constructor using an existing buffer, e.g. a static array
+   * \param[in] buffer
+   *    The buffer, must outlive the arena and should be aligned to
+   *    \ref ARENA_ALIGN
+   * \param[in] size
+   *    Size of \ref buffer
+   */
+  ArduCastArena(uint8_t *buffer, uint32_t size);
+
+  ~ArduCastArena();
+
+  /**
+   * Allocates a block from the arena, aligned to \ref ARENA_ALIGN
+   * \return
+   *    The block or NULL if it doesn't fit
+   */
+  void* allocate(uint32_t size);
+
+  /**
+   * Returns the current position of the arena, which can be passed to
+   * \ref release() later.
+   */
+  uint32_t getMark();
+
+  /**
+   * Releases everything allocated after \ref mark
+   */
+  void release(uint32_t mark);
+
+  /**
+   * Returns the size of the arena in bytes
+   */
+  uint32_t getSize();
+
+  /**
+   * Returns the number of bytes currently allocated
+   */
+  uint32_t getUsed();
+
+  /**
+   * Returns the most bytes ever allocated at the same time
+   */
+  uint32_t getHighWater();
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "ArduCastCapture.h"
+
+static const uint8_t CAPTURE_HEADER[CAPTURE_HEADER_SIZE] = { 'A', 'C', 'A', 'P', 1 };
+
+static void put32(uint8_t *p, uint32_t value){
+  p[0] = value >> 24;
+  p[1] = value >> 16;
+  p[2] = value >> 8;
+  p[3] = value;
+}
+
+ArduCastCapture::ArduCastCapture(Print &_out)
+  : out(&_out), ring(NULL), size(0)
+{
+}
+
+ArduCastCapture::ArduCastCapture(uint8_t *_ring, uint32_t _size)
+  : ring(_ring), size(_ring != NULL ? _size : 0)
+{
+}
+
+void ArduCastCapture::ringWrite(const uint8_t *data, uint32_t len){
+  //at most two pieces, before and after the wrap
+  while ( len > 0 ){
+    uint32_t piece = size - head;
+    if ( piece > len )
+      piece = len;
+    memcpy(ring + head, data, piece);
+    head = (head + piece) % size;
+    used += piece;
+    data += piece;
+    len -= piece;
+  }
+}
+
+uint8_t ArduCastCapture::ringAt(uint32_t offset){
+  return ring[(head + size - used + offset) % size];
+}
+
+void ArduCastCapture::record(captureDirection_t direction, const uint8_t *frame, uint32_t len){
+  if ( !enabled )
+    return;
+  uint8_t header[CAPTURE_RECORD_HEADER_SIZE];
+  put32(header, millis());
+  header[4] = direction;
+  put32(header+5, len);
+
+  if ( out != NULL ){
+    if ( !headerWritten ){
+      out->write(CAPTURE_HEADER, sizeof(CAPTURE_HEADER));
+      headerWritten = true;
+    }
+    out->write(header, sizeof(header));
+    out->write(frame, len);
+    return;
+  }
+
+  uint32_t recordSize = sizeof(header) + len;
+  if ( recordSize > size ){
+    dropped++;
+    return;
+  }
+  //drop the oldest records until it fits
+  while ( size - used < recordSize ){
+    uint32_t oldLen = ((uint32_t)ringAt(5) << 24) | ((uint32_t)ringAt(6) << 16) | ((uint32_t)ringAt(7) << 8) | ringAt(8);
+    used -= CAPTURE_RECORD_HEADER_SIZE + oldLen;
+    dropped++;
+  }
+  ringWrite(header, sizeof(header));
+  ringWrite(frame, len);
+}
+
+void ArduCastCapture::setEnabled(bool enable){
+  enabled = enable;
+}
+
+uint32_t ArduCastCapture::dump(Print &dumpOut){
+  if ( ring == NULL )
+    return 0;
+  uint32_t written = dumpOut.write(CAPTURE_HEADER, sizeof(CAPTURE_HEADER));
+  uint32_t tail = (head + size - used) % size;
+  if ( tail + used <= size ){
+    written += dumpOut.write(ring + tail, used);
+  } else {
+    written += dumpOut.write(ring + tail, size - tail);
+    written += dumpOut.write(ring, used - (size - tail));
+  }
+  return written;
+}
+
+void ArduCastCapture::clear(){
+  head = 0;
+  used = 0;
+}
+
+uint32_t ArduCastCapture::getUsed(){
+  return used;
+}
+
+uint32_t ArduCastCapture::getDropped(){
+  return dropped;
+}
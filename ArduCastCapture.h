@@ -0,0 +1,126 @@
+/**
+ * ArduCastCapture.h - Binary capture of the CastMessage traffic
+ * https://github.com/andrasbiro/chromecastcontrol
+ */
+
+#ifndef ARDUCASTCAPTURE_H
+#define ARDUCASTCAPTURE_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+/**
+ * Size of the header of a capture, see \ref ArduCastCapture
+ */
+#define CAPTURE_HEADER_SIZE 5
+
+/**
+ * Size of the header of a record, see \ref ArduCastCapture
+ */
+#define CAPTURE_RECORD_HEADER_SIZE 9
+
+/**
+ * Direction of a captured frame
+ */
+typedef enum captureDirection_t {
+  CAPTURE_RX = 0,   ///< Received from the chromecast
+  CAPTURE_TX = 1,   ///< Sent to the chromecast
+} captureDirection_t;
+
+/**
+ * Records the raw frames of a connection in both directions, to reproduce
+ * field problems or to benchmark the library against real traffic, see
+ * \ref ArduCastReplayClient. Set with \ref ArduCastControl::setCapture().
+ *
+ * The capture is a binary stream, all numbers are big endian (like the
+ * length field of the frames):
+ *
+ *     header: "ACAP" version(1)
+ *     record: time(4, ms) direction(1, captureDirection_t) length(4) frame
+ *
+ * The frame is the message as on the wire, including its length field.
+ * Received frames bigger than the receive buffer are recorded truncated,
+ * with their original length field.
+ *
+ * The records are either written to a Print (e.g. a file) right away, or
+ * kept in a ring buffer (the oldest ones are dropped when it's full), which
+ * can be written out with \ref dump() later, e.g. after a problem.
+ */
+class ArduCastCapture {
+private:
+  Print *out = NULL;
+  uint8_t *const ring;
+  const uint32_t size;
+  uint32_t head = 0;          ///< Next free byte of the ring
+  uint32_t used = 0;          ///< Bytes in the ring
+  bool headerWritten = false;
+  bool enabled = true;
+  uint32_t dropped = 0;
+
+  /**
+   * Copies \ref len bytes to the ring at \ref head
+   */
+  void ringWrite(const uint8_t *data, uint32_t len);
+
+  /**
+   * Returns the byte at \ref offset from the oldest byte of the ring
+   */
+  uint8_t ringAt(uint32_t offset);
+
+public:
+  /**
+   * Constructor, writing the records to \ref _out as they come
+   */
+  ArduCastCapture(Print &_out);
+
+  /**
+   * Constructor, keeping the records in a ring buffer
+   * \param[in] _ring
+   *    The buffer, must outlive the capture
+   * \param[in] _size
+   *    Size of \ref _ring. Records bigger than this are dropped.
+   */
+  ArduCastCapture(uint8_t *_ring, uint32_t _size);
+
+  /**
+   * Records a frame. Called by \ref ArduCastControl.
+   * \param[in] direction
+   *    \ref CAPTURE_RX or \ref CAPTURE_TX
+   * \param[in] frame
+   *    The frame, including its length field
+   * \param[in] len
+   *    Length of \ref frame
+   */
+  void record(captureDirection_t direction, const uint8_t *frame, uint32_t len);
+
+  /**
+   * Pauses or resumes the capture
+   */
+  void setEnabled(bool enable);
+
+  /**
+   * Writes the ring as a capture (with the header) to \ref dumpOut, e.g. a
+   * file. Nothing is written in Print mode.
+   * \return
+   *    Bytes written
+   */
+  uint32_t dump(Print &dumpOut);
+
+  /**
+   * Drops the records of the ring
+   */
+  void clear();
+
+  /**
+   * Returns the bytes in the ring, without the header
+   */
+  uint32_t getUsed();
+
+  /**
+   * Returns the number of records dropped: the oldest ones overwritten in
+   * the ring, and the ones which didn't fit at all
+   */
+  uint32_t getDropped();
+};
+
+#endif
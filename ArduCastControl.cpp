@@ -18,16 +18,17 @@ const char CC_NS_HEARTBEAT[] = "urn:x-cast:com.google.cast.tp.heartbeat";
 const char CC_NS_MEDIA[] = "urn:x-cast:com.google.cast.media";
 const char CC_MSG_CONNECT[] = "{\"type\": \"CONNECT\"}";
 const char CC_MSG_PING[] = "{\"type\": \"PING\"}";
+const char CC_MSG_PONG[] = "{\"type\": \"PONG\"}";
 const char CC_MSG_GET_STATUS[] = "{\"type\": \"GET_STATUS\", \"requestId\": 1}"; 
 
-//incomplet msgs as these need some args to the end
-const char CC_MSG_PLAY[] = "{\"type\": \"PLAY\", \"requestId\": 2, \"mediaSessionId\": ";
-const char CC_MSG_PAUSE[] = "{\"type\": \"PAUSE\", \"requestId\": 2, \"mediaSessionId\": ";
-const char CC_MSG_NEXT[] = "{\"type\": \"QUEUE_NEXT\", \"requestId\": 2, \"mediaSessionId\": ";
-const char CC_MSG_PREV[] = "{\"type\": \"QUEUE_PREV\", \"requestId\": 2, \"mediaSessionId\": ";
-const char CC_MSG_SET_VOL[] = "{\"type\": \"SET_VOLUME\", \"requestId\": 2, \"volume\": {\"level\": ";//this need double braces!
-const char CC_MSG_VOL_MUTE[] = "{\"type\": \"SET_VOLUME\", \"requestId\": 2, \"volume\": {\"muted\": ";//this need double braces!
-static char cc_msg_ctrl[128];
+//format strings for commands, the first argument is always the requestId
+const char CC_MSG_PLAY[] = "{\"type\": \"PLAY\", \"requestId\": %lu, \"mediaSessionId\": %d}";
+const char CC_MSG_PAUSE[] = "{\"type\": \"PAUSE\", \"requestId\": %lu, \"mediaSessionId\": %d}";
+const char CC_MSG_NEXT[] = "{\"type\": \"QUEUE_NEXT\", \"requestId\": %lu, \"mediaSessionId\": %d}";
+const char CC_MSG_PREV[] = "{\"type\": \"QUEUE_PREV\", \"requestId\": %lu, \"mediaSessionId\": %d}";
+const char CC_MSG_SEEK[] = "{\"type\": \"SEEK\", \"requestId\": %lu, \"mediaSessionId\": %d, \"currentTime\": %f}";
+const char CC_MSG_SET_VOL[] = "{\"type\": \"SET_VOLUME\", \"requestId\": %lu, \"volume\": {\"level\": %f}}";
+const char CC_MSG_VOL_MUTE[] = "{\"type\": \"SET_VOLUME\", \"requestId\": %lu, \"volume\": {\"muted\": %s}}";
 
 // void ArduCastConnection::init(WiFiClientSecure& client, int keepAlive, uint8_t *writeBuffer, int writeBufferSize){
 //   //this->client = client;
@@ -38,9 +39,96 @@ static char cc_msg_ctrl[128];
 // }
 
 
+uint8_t* ArduCastTxRing::reserve(uint32_t len){
+  if ( !wrapped && head == tail ) //empty, start over to have the most room
+    head = tail = 0;
+  if ( !wrapped ){
+    if ( size - head >= len ){
+      reserved = head;
+      return buffer + head;
+    }
+    //the message is kept continuous, so wrap to the beginning as a whole
+    if ( tail >= len ){
+      reserved = 0;
+      return buffer;
+    }
+    return NULL;
+  }
+  if ( tail - head >= len ){
+    reserved = head;
+    return buffer + head;
+  }
+  return NULL;
+}
+
+void ArduCastTxRing::commit(uint32_t len){
+  if ( capture != NULL )
+    capture->record(CAPTURE_TX, buffer + reserved, len);
+  if ( !wrapped && reserved != head ){
+    wrapAt = head;
+    wrapped = true;
+  }
+  head = reserved + len;
+  if ( pending() > highWater )
+    highWater = pending();
+}
+
+void ArduCastTxRing::flush(){
+  while ( pending() > 0 ){
+    uint32_t end = wrapped ? wrapAt : head;
+    if ( tail == end ){ //continue at the beginning
+      tail = 0;
+      wrapped = false;
+      continue;
+    }
+    uint32_t written = client.write(buffer + tail, end - tail);
+    CC_TRACE(TRACE_FLUSH, 0, written);
+    tail += written;
+    if ( tail < end )
+      return; //TCP channel is busy, try again later
+  }
+}
+
+void ArduCastTxRing::clear(){
+  head = tail = wrapAt = 0;
+  wrapped = false;
+}
+
+uint32_t ArduCastTxRing::pending(){
+  if ( wrapped )
+    return wrapAt - tail + head;
+  return head - tail;
+}
+
+uint32_t ArduCastTxRing::getSize(){
+  return size;
+}
+
+void ArduCastTxRing::setCapture(ArduCastCapture *_capture){
+  capture = _capture;
+}
+
+uint32_t ArduCastTxRing::getHighWater(){
+  return highWater;
+}
+
 int ArduCastConnection::connect(const char* destinationId){
   // Serial.printf("Connect to %s\n", destinationId);
   strncpy(destId, destinationId, sizeof(destId));
+  destId[sizeof(destId)-1] = '\0';
+#if MSG_PREFIX_CACHE > 0
+  //cached prefixes contain the destination
+  for(uint8_t i = 0; i < MSG_PREFIX_CACHE; i++)
+    prefixes[i].len = 0;
+#endif
+  //the fixed messages only depend on the destination, so encode them here
+  int len = encodeMsg(pingFrame, sizeof(pingFrame), CC_NS_HEARTBEAT, CC_MSG_PING);
+  pingFrameLen = len > 0 ? len : 0;
+  statusFrameLen = 0;
+  if ( statusNameSpace != NULL ){
+    len = encodeMsg(statusFrame, sizeof(statusFrame), statusNameSpace, CC_MSG_GET_STATUS);
+    statusFrameLen = len > 0 ? len : 0;
+  }
   int err =  writeMsg(CC_NS_CONNECTION, CC_MSG_CONNECT);
   pinged(); //do not ping immediately - we probably want to check status anyway
   connected = true;
@@ -58,16 +146,29 @@ void ArduCastConnection::setDisconnect(){
 channelConnection_t ArduCastConnection::getConnectionStatus(){
   if ( !client.connected() || !connected )
     return CH_DISCONNECTED;
-  if ( (unsigned long)(lastMsgAt + 3*keepAlive) < millis() ){
+  if ( millis() - lastMsgAt > 3*keepAlive ){
     connected = false;
     return CH_DISCONNECTED;
   }
-  if ( (unsigned long)(lastMsgAt + keepAlive) < millis())
+  if ( millis() - lastMsgAt > keepAlive )
     return CH_NEEDS_PING;
   else
     return CH_CONNECTED;
 }
 
+void ArduCastConnection::setKeepAlive(uint32_t ms){
+  keepAlive = ms;
+}
+
+uint32_t ArduCastConnection::getKeepAlive(){
+  return keepAlive;
+}
+
+unsigned long ArduCastConnection::getPingDeadline(){
+  //getConnectionStatus() changes to CH_NEEDS_PING after this
+  return lastMsgAt + keepAlive + 1;
+}
+
 const char* ArduCastConnection::getDestinationId(){
   return destId;
 }
@@ -83,12 +184,167 @@ bool ArduCastConnection::encode_string(pb_ostream_t *stream, const pb_field_iter
   return pb_encode_string(stream, (uint8_t*)str, strlen(str));
 }
 
-int ArduCastConnection::writeMsg(const char* nameSpace, const char* payload){
-  if ( !client.connected() )
+/**
+ * Writes a varint to \ref buffer, which must have room for 5 bytes.
+ * Returns the number of bytes written.
+ */
+static uint8_t pbEncodeVarint(uint8_t *buffer, uint32_t value){
+  uint8_t len = 0;
+  while ( value > 0x7F ){
+    buffer[len++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  buffer[len++] = value;
+  return len;
+}
+
+/**
+ * Returns the encoded size of a length delimited field of \ref len bytes
+ */
+static uint32_t pbStringSize(uint32_t len){
+  uint8_t lenField[5];
+  return 1 + pbEncodeVarint(lenField, len) + len;
+}
+
+/**
+ * Writes a length delimited string field to \ref buffer.
+ * Returns the number of bytes written or 0 if it doesn't fit in \ref bufSize.
+ */
+static uint32_t pbEncodeString(uint8_t *buffer, uint32_t bufSize, uint8_t tag, const char *str, uint32_t len){
+  uint8_t header[6];
+  uint8_t headerLen = 0;
+  header[headerLen++] = (tag << 3) | PB_WT_STRING;
+  headerLen += pbEncodeVarint(header+headerLen, len);
+  if ( headerLen + len > bufSize )
+    return 0;
+  memcpy(buffer, header, headerLen);
+  memcpy(buffer+headerLen, str, len);
+  return headerLen + len;
+}
+
+int ArduCastConnection::encodePrefix(uint8_t *buffer, uint32_t bufSize, const char* nameSpace, uint8_t *nsOffset){
+  uint32_t offset = 0, written;
+  if ( bufSize < 2 )
+    return -1;
+  //fields in the order of the .proto file, same as nanopb
+  buffer[offset++] = (extensions_api_cast_channel_CastMessage_protocol_version_tag << 3) | PB_WT_VARINT;
+  buffer[offset++] = extensions_api_cast_channel_CastMessage_ProtocolVersion_CASTV2_1_0;
+  written = pbEncodeString(buffer+offset, bufSize-offset, extensions_api_cast_channel_CastMessage_source_id_tag, CC_SOURCEID, sizeof(CC_SOURCEID)-1);
+  if ( written == 0 )
+    return -1;
+  offset += written;
+  written = pbEncodeString(buffer+offset, bufSize-offset, extensions_api_cast_channel_CastMessage_destination_id_tag, destId, strlen(destId));
+  if ( written == 0 )
     return -1;
-   
+  offset += written;
+  uint32_t nsLen = strlen(nameSpace);
+  written = pbEncodeString(buffer+offset, bufSize-offset, extensions_api_cast_channel_CastMessage_namespace_fix_tag, nameSpace, nsLen);
+  if ( written == 0 )
+    return -1;
+  offset += written;
+  if ( nsOffset != NULL )
+    *nsOffset = offset - nsLen;
+  return offset;
+}
+
+const msgPrefix_t* ArduCastConnection::getPrefix(const char* nameSpace){
+#if MSG_PREFIX_CACHE > 0
+  for(uint8_t i = 0; i < MSG_PREFIX_CACHE; i++){
+    const msgPrefix_t &p = prefixes[i];
+    if ( p.len > 0 && strncmp((const char*)p.data + p.nsOffset, nameSpace, p.nsLen) == 0 && nameSpace[p.nsLen] == '\0' )
+      return &p;
+  }
+  //miss: replace the entries round robin
+  msgPrefix_t &p = prefixes[nextPrefix];
+  int len = encodePrefix(p.data, sizeof(p.data), nameSpace, &p.nsOffset);
+  if ( len < 0 ){
+    p.len = 0;
+    return NULL;
+  }
+  p.len = len;
+  p.nsLen = strlen(nameSpace);
+  nextPrefix = (nextPrefix + 1) % MSG_PREFIX_CACHE;
+  return &p;
+#else
+  (void)nameSpace;
+  return NULL;
+#endif
+}
+
+int ArduCastConnection::getMsgLength(const char* nameSpace, const char* payload){
+  return getMsgLength(nameSpace, strlen(payload));
+}
+
+int ArduCastConnection::getMsgLength(const char* nameSpace, uint32_t payloadLen){
+  uint8_t lenField[5];
+  uint32_t len = 4;
+  const msgPrefix_t *prefix = getPrefix(nameSpace);
+  if ( prefix != NULL ){
+    len += prefix->len;
+  } else {
+    //same fields as encodePrefix()
+    len += 2 + pbStringSize(sizeof(CC_SOURCEID)-1) + pbStringSize(strlen(destId)) + pbStringSize(strlen(nameSpace));
+  }
+  //payload_type and the payload field, same size for both types
+  uint64_t total = (uint64_t)len + 2 + 1 + pbEncodeVarint(lenField, payloadLen) + payloadLen;
+  //the receiver would drop it
+  if ( total - 4 > MAX_MESSAGE_SIZE )
+    return -2;
+  return total;
+}
+
+int ArduCastConnection::encodeMsg(uint8_t *buffer, uint32_t bufSize, const char* nameSpace, const char* payload){
+  return encodeMsg(buffer, bufSize, nameSpace, payload, strlen(payload));
+}
+
+int ArduCastConnection::encodeMsg(uint8_t *buffer, uint32_t bufSize, const char* nameSpace, const char* payload, uint32_t payloadLen){
+  return encode(buffer, bufSize, nameSpace, (const uint8_t*)payload, payloadLen, extensions_api_cast_channel_CastMessage_PayloadType_STRING);
+}
+
+int ArduCastConnection::encodeBinaryMsg(uint8_t *buffer, uint32_t bufSize, const char* nameSpace, const uint8_t* payload, uint32_t payloadLen){
+  return encode(buffer, bufSize, nameSpace, payload, payloadLen, extensions_api_cast_channel_CastMessage_PayloadType_BINARY);
+}
+
+int ArduCastConnection::encode(uint8_t *buffer, uint32_t bufSize, const char* nameSpace, const uint8_t* payload, uint32_t payloadLen, uint8_t payloadType){
+  uint32_t offset = 4;
+  const msgPrefix_t *prefix = getPrefix(nameSpace);
+  if ( prefix != NULL ){
+    if ( offset + prefix->len > bufSize )
+      return -2;
+    memcpy(buffer+offset, prefix->data, prefix->len);
+    offset += prefix->len;
+  } else {
+    int len = encodePrefix(buffer+offset, bufSize-offset, nameSpace, NULL);
+    if ( len < 0 )
+      return -2;
+    offset += len;
+  }
+
+  if ( offset + 2 > bufSize )
+    return -2;
+  buffer[offset++] = (extensions_api_cast_channel_CastMessage_payload_type_tag << 3) | PB_WT_VARINT;
+  buffer[offset++] = payloadType;
+  uint8_t tag = payloadType == extensions_api_cast_channel_CastMessage_PayloadType_BINARY ?
+    extensions_api_cast_channel_CastMessage_payload_binary_tag : extensions_api_cast_channel_CastMessage_payload_utf8_tag;
+  uint32_t written = pbEncodeString(buffer+offset, bufSize-offset, tag, (const char*)payload, payloadLen);
+  if ( written == 0 )
+    return -2;
+  offset += written;
+
+  uint32_t bodyLen = offset - 4;
+  buffer[0] = (bodyLen>>24) & 0xFF;
+  buffer[1] = (bodyLen>>16) & 0xFF;
+  buffer[2] = (bodyLen>>8) & 0xFF;
+  buffer[3] = (bodyLen>>0) & 0xFF;
+
+  return offset;
+}
+
+int ArduCastConnection::encodeMsgPb(uint8_t *buffer, uint32_t bufSize, const char* nameSpace, const char* payload){
+  if ( bufSize < 4 )
+    return -2;
   extensions_api_cast_channel_CastMessage newMsg = extensions_api_cast_channel_CastMessage_init_zero;
-  pb_ostream_t stream = pb_ostream_from_buffer(writeBuffer+4, writeBufferSize-4);
+  pb_ostream_t stream = pb_ostream_from_buffer(buffer+4, bufSize-4);
   newMsg.source_id.arg = (void*)CC_SOURCEID;
   newMsg.source_id.funcs.encode = encode_string;
   newMsg.destination_id.arg = (void*)destId;
@@ -103,83 +359,447 @@ int ArduCastConnection::writeMsg(const char* nameSpace, const char* payload){
   if (!status)
     return -2;
   
-  writeBuffer[0] = (stream.bytes_written>>24) & 0xFF;
-  writeBuffer[1] = (stream.bytes_written>>16) & 0xFF;
-  writeBuffer[2] = (stream.bytes_written>>8) & 0xFF;
-  writeBuffer[3] = (stream.bytes_written>>0) & 0xFF;
+  buffer[0] = (stream.bytes_written>>24) & 0xFF;
+  buffer[1] = (stream.bytes_written>>16) & 0xFF;
+  buffer[2] = (stream.bytes_written>>8) & 0xFF;
+  buffer[3] = (stream.bytes_written>>0) & 0xFF;
 
-  uint32_t len = client.write(writeBuffer, stream.bytes_written+4);
-  if (len < stream.bytes_written+4)
+  return stream.bytes_written+4;
+}
+
+int ArduCastConnection::writeMsg(const char* nameSpace, const char* payload){
+  return writeMsg(nameSpace, payload, strlen(payload));
+}
+
+int ArduCastConnection::writeMsg(const char* nameSpace, const char* payload, uint32_t payloadLen){
+  return write(nameSpace, (const uint8_t*)payload, payloadLen, extensions_api_cast_channel_CastMessage_PayloadType_STRING);
+}
+
+int ArduCastConnection::writeBinaryMsg(const char* nameSpace, const uint8_t* payload, uint32_t payloadLen){
+  return write(nameSpace, payload, payloadLen, extensions_api_cast_channel_CastMessage_PayloadType_BINARY);
+}
+
+int ArduCastConnection::write(const char* nameSpace, const uint8_t* payload, uint32_t payloadLen, uint8_t payloadType){
+  if ( !client.connected() )
+    return -1;
+
+  int len = getMsgLength(nameSpace, payloadLen);
+  if ( len < 0 )
+    return len;
+  if ( (uint32_t)len > tx.getSize() )
+    return -2; //would never fit
+  uint8_t *frame = tx.reserve(len);
+  if ( frame == NULL )
     return -3;
-  
+  int encoded = encode(frame, len, nameSpace, payload, payloadLen, payloadType);
+  if ( encoded < 0 )
+    return encoded;
+  tx.commit(encoded);
+  tx.flush();
+  countOut(nameSpace, encoded);
+  return 0;
+}
+
+int ArduCastConnection::writeFrame(const uint8_t *frame, uint32_t len, const char* nameSpace){
+  if ( !client.connected() )
+    return -1;
+
+  if ( len > tx.getSize() )
+    return -2; //would never fit
+  uint8_t *reserved = tx.reserve(len);
+  if ( reserved == NULL )
+    return -3;
+  memcpy(reserved, frame, len);
+  tx.commit(len);
+  tx.flush();
+  countOut(nameSpace, len);
   return 0;
 }
 
+void ArduCastConnection::setMetrics(castMetrics_t *_metrics, ArduCastStringTable *_namespaces){
+  metrics = _metrics;
+  namespaces = _namespaces;
+}
+
+void ArduCastConnection::countOut(const char* nameSpace, uint32_t len){
+  if ( metrics == NULL )
+    return;
+  uint8_t id = namespaces->lookup((const uint8_t*)nameSpace, strlen(nameSpace));
+  CC_TRACE(TRACE_WRITE, id, len);
+  if ( id >= METRICS_NAMESPACES )
+    id = 0;
+  metrics->ns[id].framesOut++;
+  metrics->ns[id].bytesOut += len;
+}
+
+int ArduCastConnection::writePing(){
+  if ( pingFrameLen == 0 )
+    return writeMsg(CC_NS_HEARTBEAT, CC_MSG_PING);
+  return writeFrame(pingFrame, pingFrameLen, CC_NS_HEARTBEAT);
+}
+
+int ArduCastConnection::writeGetStatus(){
+  if ( statusFrameLen == 0 )
+    return writeMsg(statusNameSpace, CC_MSG_GET_STATUS);
+  return writeFrame(statusFrame, statusFrameLen, statusNameSpace);
+}
+
 
 ////////////////////////
 
 
-uint32_t ArduCastControl::getIncomingMessageLength(WiFiClientSecure &client){
-  uint8_t buffer[4];
-  client.peekBytes(buffer, 4);
-  uint32_t len = (buffer[0]<<24) + (buffer[1]<<16) + (buffer[2]<<8) + buffer[3];
-  return len;
+#ifdef ARDUCAST_USE_ARDUINOJSON
+/**
+ * ArduinoJson allocator using the arena of an instance. A document allocates
+ * a single pool, which is released from the arena when the document is
+ * destroyed.
+ */
+class ArenaJsonAllocator {
+  private:
+    ArduCastArena *arena;
+    uint32_t mark = 0;
+    size_t allocated = 0;
+  public:
+    ArenaJsonAllocator(ArduCastArena &_arena) : arena(&_arena) {}
+    void* allocate(size_t size){
+      mark = arena->getMark();
+      void *pool = arena->allocate(size);
+      allocated = pool != NULL ? size : 0;
+      return pool;
+    }
+    void deallocate(void* ptr){
+      if ( ptr != NULL )
+        arena->release(mark);
+    }
+    void* reallocate(void* ptr, size_t size){
+      //only used to shrink the pool, which is not worth it in an arena,
+      //and the pool can't grow in place
+      return size <= allocated ? ptr : NULL;
+    }
+};
+typedef BasicJsonDocument<ArenaJsonAllocator> ArenaJsonDocument;
+#endif
+
+const castConfig_t CC_DEFAULT_CONFIG = { CONNBUFFER_SIZE, TXBUFFER_SIZE, JSONBUFFER_SIZE, STRING_FIELD_SIZE };
+
+//used by the string fields if they couldn't be allocated
+static char emptyString[1] = "";
+
+ArduCastControl::ArduCastControl()
+  : ArduCastControl(CC_DEFAULT_CONFIG)
+{
 }
 
+ArduCastControl::ArduCastControl(const castConfig_t &config)
+  : arena(arenaSize(config, true, true)), shared(&ownBuffer),
+    connBuffer((uint8_t*)arena.allocate(config.bufferSize)), connBufferSize(connBuffer != NULL ? config.bufferSize : 0),
+    jsonBufferSize(config.jsonBufferSize),
+    txRing(client, (uint8_t*)arena.allocate(config.txBufferSize), config.txBufferSize)
+{
+  ownBuffer.buffer = connBuffer;
+  ownBuffer.size = connBufferSize;
+  initStrings(config.stringSize);
+  initNamespaces();
+  deviceConnection.setMetrics(&metrics, &namespaces);
+  applicationConnection.setMetrics(&metrics, &namespaces);
+}
 
-uint32_t ArduCastControl::getRawMessage(uint8_t *buffer, uint16_t bufSize, WiFiClientSecure &client, uint32_t timeout){
-  unsigned long start = millis();
-  // Serial.printf("Checking read %d\n", client.available());
-  if (bufSize <= 4 || client.available() < 4 ){
-    return 0;
+ArduCastControl::ArduCastControl(sharedBuffer_t &buffer, const castConfig_t &config)
+  : arena(arenaSize(config, false, buffer.jsonArena == NULL)), shared(&buffer), connBuffer(buffer.buffer), connBufferSize(buffer.size),
+    jsonBufferSize(buffer.jsonArena != NULL ? buffer.jsonSize : config.jsonBufferSize),
+    txRing(client, (uint8_t*)arena.allocate(config.txBufferSize), config.txBufferSize)
+{
+  initStrings(config.stringSize);
+  initNamespaces();
+  deviceConnection.setMetrics(&metrics, &namespaces);
+  applicationConnection.setMetrics(&metrics, &namespaces);
+}
+
+ArduCastControl::~ArduCastControl(){
+  if ( shared->owner == this )
+    shared->owner = NULL;
+}
+
+uint32_t ArduCastControl::arenaSize(const castConfig_t &config, bool withBuffer, bool withJson){
+  uint32_t size = 4 * ARENA_ALIGNED(config.stringSize) + ARENA_ALIGNED(config.txBufferSize);
+  if ( withBuffer )
+    size += ARENA_ALIGNED(config.bufferSize);
+#ifdef ARDUCAST_USE_ARDUINOJSON
+  if ( withJson )
+    size += ARENA_ALIGNED(config.jsonBufferSize);
+#else
+  (void)withJson;
+#endif
+  return size;
+}
+
+void ArduCastControl::initStrings(uint8_t size){
+  char **strings[] = { &displayName, &statusText, &title, &artist };
+  for(uint8_t i = 0; i < sizeof(strings)/sizeof(strings[0]); i++){
+    *strings[i] = (char*)arena.allocate(size);
+    if ( *strings[i] == NULL ){
+      //all or nothing, so a single stringSize works for every field
+      for(uint8_t j = 0; j < sizeof(strings)/sizeof(strings[0]); j++)
+        *strings[j] = emptyString;
+      stringSize = 0;
+      return;
+    }
+    (*strings[i])[0] = '\0';
   }
+  stringSize = size;
+}
+
+void ArduCastControl::initNamespaces(){
+  namespaces.add(CC_NS_CONNECTION, NS_CONNECTION);
+  namespaces.add(CC_NS_HEARTBEAT, NS_HEARTBEAT);
+  namespaces.add(CC_NS_RECEIVER, NS_RECEIVER);
+  namespaces.add(CC_NS_MEDIA, NS_MEDIA);
+}
+
+uint32_t ArduCastControl::getConnectTime(){
+  return metrics.connectTime;
+}
 
-  uint16_t len = getIncomingMessageLength(client);
-  while ( client.available() < len+4 ){
-    if (millis() - start > timeout ){
+/**
+ * Adds \ref value to the bucket of its magnitude, see
+ * \ref METRICS_HISTOGRAM_SIZE
+ */
+static void histogramAdd(castHistogram_t &histogram, uint32_t value){
+  uint8_t bucket = 0;
+  for(uint32_t v = value; v > 0 && bucket < METRICS_HISTOGRAM_SIZE - 1; v >>= 1)
+    bucket++;
+  histogram.count[bucket]++;
+  if ( value > histogram.max )
+    histogram.max = value;
+}
+
+const castMetrics_t& ArduCastControl::getMetrics(){
+  return metrics;
+}
+
+void ArduCastControl::resetMetrics(){
+  uint32_t connectTime = metrics.connectTime;
+  memset(&metrics, 0, sizeof(metrics));
+  metrics.connectTime = connectTime;
+}
+
+/**
+ * Prints the non-empty buckets of a histogram as <limit:count, the last
+ * bucket as >=limit:count
+ */
+static void dumpHistogram(const char *name, const castHistogram_t &histogram){
+  Serial.printf("%s max:%u", name, histogram.max);
+  for(uint8_t i = 0; i < METRICS_HISTOGRAM_SIZE; i++){
+    if ( histogram.count[i] == 0 )
+      continue;
+    if ( i < METRICS_HISTOGRAM_SIZE - 1 )
+      Serial.printf(" <%lu:%u", 1UL << i, histogram.count[i]);
+    else
+      Serial.printf(" >=%lu:%u", 1UL << (i - 1), histogram.count[i]);
+  }
+  Serial.println();
+}
+
+void ArduCastControl::dumpMetrics(){
+  for(uint8_t i = 0; i < METRICS_NAMESPACES; i++){
+    const nsMetrics_t &ns = metrics.ns[i];
+    if ( ns.framesIn > 0 || ns.framesOut > 0 )
+      Serial.printf("NS%d in:%u/%uB out:%u/%uB\n", i, ns.framesIn, ns.bytesIn, ns.framesOut, ns.bytesOut);
+  }
+  Serial.printf("RX truncated:%u/%uB dropped:%u timeout:%u parse:%u\n", metrics.framesTruncated,
+                metrics.bytesDropped, metrics.framesDropped, metrics.rxTimeouts, metrics.parseErrors);
+  Serial.printf("Timeouts response:%u command:%u\n", metrics.responseTimeouts, metrics.commandTimeouts);
+  Serial.printf("Connects:%u failed:%u last:%ums\n", metrics.connects, metrics.connectFailures, metrics.connectTime);
+  dumpHistogram("Latency ms", metrics.latency);
+  dumpHistogram("Parse us", metrics.parseTime);
+}
+
+castMemoryStats_t ArduCastControl::getMemoryStats(){
+  castMemoryStats_t stats;
+  stats.arenaSize = arena.getSize();
+  stats.arenaHighWater = arena.getHighWater();
+  stats.bufferSize = connBufferSize;
+  stats.txBufferSize = txRing.getSize();
+  stats.txHighWater = txRing.getHighWater();
+  stats.largestMessage = largestMessage;
+  stats.jsonHighWater = jsonHighWater;
+  return stats;
+}
+
+bool ArduCastControl::usesBuffer(const sharedBuffer_t &buffer){
+  return shared == &buffer;
+}
+
+void ArduCastControl::purgeRawMessage(castClient_t &client){
+  uint8_t scratch[64];
+  while ( client.available() > 0 )
+    client.read(scratch, sizeof(scratch));
+  rxExpected = 0;
+  rxReceived = 0;
+  rxDump = 0;
+  if ( shared->owner == this )
+    shared->owner = NULL;
+}
+
+bool ArduCastControl::rxInProgress(){
+  return rxReceived > 0;
+}
+
+uint32_t ArduCastControl::getRawMessage(uint8_t *buffer, uint32_t bufSize, castClient_t &client, uint32_t timeout){
+  int available = client.available();
+  // Serial.printf("Checking read %d\n", available);
+  if ( available <= 0 ){
+    if ( rxInProgress() && millis() - rxLastAt > timeout ){
       // Serial.println("timeout");
-      while(client.available())
-        client.read();
+      metrics.rxTimeouts++;
+      purgeRawMessage(client);
+    }
+    return 0;
+  }
+  if ( bufSize <= 4 )
+    return 0;
+  rxLastAt = millis();
+
+  //length field first
+  if ( rxReceived < 4 ){
+    int toRead = 4 - rxReceived;
+    if ( toRead > available )
+      toRead = available;
+    int got = client.read(buffer+rxReceived, toRead);
+    if ( got <= 0 )
+      return 0;
+    rxReceived += got;
+    available -= got;
+    if ( rxReceived < 4 )
       return 0;
+
+    uint32_t len = ((uint32_t)buffer[0]<<24) + ((uint32_t)buffer[1]<<16) + ((uint32_t)buffer[2]<<8) + buffer[3];
+    if ( len > MAX_MESSAGE_SIZE ){
+      //we're out of sync with the stream, no way to recover the message boundaries
+      metrics.framesDropped++;
+      purgeRawMessage(client);
+      return 0;
+    }
+    rxExpected = len + 4;
+    if ( rxExpected > largestMessage )
+      largestMessage = rxExpected;
+    rxDump = 0;
+    if ( rxExpected > bufSize ){
+      rxDump = rxExpected - bufSize;
+      rxExpected = bufSize;
+      metrics.framesTruncated++;
+      metrics.bytesDropped += rxDump;
     }
   }
 
-  uint32_t dump = 0;
-  if ( bufSize < len + 4 ){
-    dump = len - (bufSize-4);
-    len = bufSize-4;
+  //then the body, as much as fits in the buffer
+  if ( rxReceived < rxExpected && available > 0 ){
+    uint32_t toRead = rxExpected - rxReceived;
+    if ( toRead > (uint32_t)available )
+      toRead = available;
+    int got = client.read(buffer+rxReceived, toRead);
+    if ( got > 0 ){
+      rxReceived += got;
+      available -= got;
+    }
   }
-  client.readBytes(buffer, len+4);
-  while ( dump > 0){
-    client.read();
-    dump--;
+
+  //drop the part of an oversized message that doesn't fit
+  while ( rxReceived == rxExpected && rxDump > 0 && available > 0 ){
+    uint8_t scratch[64];
+    uint32_t toRead = sizeof(scratch);
+    if ( toRead > rxDump )
+      toRead = rxDump;
+    if ( toRead > (uint32_t)available )
+      toRead = available;
+    int got = client.read(scratch, toRead);
+    if ( got <= 0 )
+      break;
+    rxDump -= got;
+    available -= got;
   }
-  return len+4;
+
+  if ( rxReceived < rxExpected || rxDump > 0 )
+    return 0;
+
+  uint32_t len = rxReceived;
+  rxExpected = 0;
+  rxReceived = 0;
+  return len;
 }
 
 
 
-int ArduCastControl::connect(const char* host){
-  client.allowSelfSignedCerts(); //chromecast seems to use self signed cert
+int ArduCastControl::connect(const char* host, uint16_t port){
+  if ( strlen(host) >= sizeof(this->host) )
+    return -10;
+  //a different device, forget the application running on the previous one,
+  //and never offer its TLS session to another host
+  if ( strcmp(host, this->host) != 0 || port != this->port ){
+    sessionId[0] = '\0';
+    mediaSessionId = 0;
+#if TLS_SESSION_CACHE
+    tlsSession = BearSSL::Session();
+#endif
+  }
+  if ( host != this->host )
+    strcpy(this->host, host);
+  this->port = port;
+
+  //chromecast seems to use self signed cert
+#if defined(ESP8266)
+  client.allowSelfSignedCerts();
+#else
+  client.setInsecure();
+#endif
+#if TLS_SESSION_CACHE
+  //resumed if it's valid, updated by the handshake otherwise
+  client.setSession(&tlsSession);
+#endif
 
-  int err = client.connect(host, 8009);
+  unsigned long connectStart = millis();
+  int err = client.connect(host, port);
   if ( !err ){
+    //jittered, so devices don't retry in sync
+    uint32_t half = backoff / 2;
+    reconnectAt = millis() + half + random(half + 1);
+    backoff = backoff < maxBackoff / 2 ? backoff * 2 : maxBackoff;
+    metrics.connectFailures++;
     return -10;
   }
   
+  metrics.connectTime = millis() - connectStart;
+  metrics.connects++;
+  backoff = minBackoff;
+  clearRequests();
   connectionStatus =  TCPALIVE;
+  //the application channel belonged to the previous TCP connection
+  applicationConnection.setDisconnect();
+  purgeRawMessage(client); //new stream, drop any partial message
+  txRing.clear();
+  deviceStatusAt = 0;
+  mediaStatusAt = 0;
+  devicePollAvoidedAt = 0;
+  mediaPollAvoidedAt = 0;
+  pongNeeded = 0;
   
   // deviceConnection.init(client, PING_TIMEOUT, connBuffer, CONNBUFFER_SIZE);
   // applicationConnection.init(client, PING_TIMEOUT, connBuffer, CONNBUFFER_SIZE);
   err = deviceConnection.connect(CC_MAIN_DESTIID);
-  if ( err == 0 )
+  sources.clear();
+  sources.add(deviceConnection.getDestinationId(), SRC_DEVICE);
+  if ( err == 0 ){
     connectionStatus = CONNECTED;
+    //rejoin the application we were connected to, without waiting for the status
+    if ( sessionId[0] != '\0' )
+      connectionStatus = CONNECT_TO_APPLICATION;
+  }
   return err;
 }
 
 void ArduCastControl::printRawMsg(int64_t len, uint8_t *buffer){
 
-  Serial.printf("Message Length: %lld\n", len);
+  Serial.printf("Message Length: %lld\n", (long long)len);
  
   Serial.print("Message: ");
 
@@ -198,276 +818,829 @@ void ArduCastControl::printRawMsg(int64_t len, uint8_t *buffer){
   Serial.println();
 }
 
-uint8_t ArduCastControl::pbDecodeVarint(uint8_t *bufferStart, uint32_t *decodedInt){
-  *decodedInt = 0;
-  int8_t decoded = -1;
-  do {
-    decoded++;
-    //Serial.printf("curr=0x%02x, in=0x%02x, d=%d\n", *decodedInt, bufferStart[decoded], decoded);
-    *decodedInt |= (bufferStart[decoded] & 0x7f) << (decoded * 7);
-  } while ( bufferStart[decoded] & 0x80 );
-  return decoded+1;
+uint8_t ArduCastControl::pbDecodeVarint(const uint8_t *buffer, const uint8_t *end, uint64_t *value){
+  //up to 28 bits (keys, lengths) in 32 bit arithmetic, it's much faster on the ESPs
+  uint32_t low = 0;
+  uint8_t i = 0;
+  for(; i < 4 && buffer + i < end; i++){
+    low |= (uint32_t)(buffer[i] & 0x7f) << (i * 7);
+    if ( (buffer[i] & 0x80) == 0 ){
+      *value = low;
+      return i + 1;
+    }
+  }
+  //at most 10 bytes, the last one only has 1 significant bit
+  uint64_t decoded = low;
+  for(; i < 10 && buffer + i < end; i++){
+    decoded |= (uint64_t)(buffer[i] & 0x7f) << (i * 7);
+    if ( (buffer[i] & 0x80) == 0 ){
+      *value = decoded;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+uint8_t ArduCastControl::pbDecodeHeader(const uint8_t *buffer, const uint8_t *end, uint32_t *tag, uint8_t *wire, uint64_t *lengthOrValue){
+  uint64_t key;
+  uint8_t processedBytes = pbDecodeVarint(buffer, end, &key);
+  //tags are 29 bits, 0 is invalid
+  if ( processedBytes == 0 || (key >> 32) != 0 || (key >> 3) == 0 )
+    return 0;
+  *tag = key >> 3;
+  *wire = key & 0x07;
+  buffer += processedBytes;
+
+  uint8_t valueBytes;
+  switch ( *wire ){
+    case PB_WT_VARINT:
+    case PB_WT_STRING:
+      valueBytes = pbDecodeVarint(buffer, end, lengthOrValue);
+      if ( valueBytes == 0 )
+        return 0;
+      break;
+    case PB_WT_64BIT:
+    case PB_WT_32BIT:
+      //little endian
+      valueBytes = *wire == PB_WT_64BIT ? 8 : 4;
+      if ( end - buffer < valueBytes )
+        return 0;
+      *lengthOrValue = 0;
+      for(uint8_t i = valueBytes; i > 0; i--)
+        *lengthOrValue = (*lengthOrValue << 8) | buffer[i-1];
+      break;
+    default: //groups are deprecated, not used by CastMessage
+      return 0;
+  }
+  return processedBytes + valueBytes;
+}
+
+/**
+ * Wire type of the CastMessage fields, by tag
+ */
+static const uint8_t CAST_MSG_WIRE[CAST_MSG_FIELDS] = {
+  0xFF,             //no tag 0
+  PB_WT_VARINT,     //protocol_version
+  PB_WT_STRING,     //source_id
+  PB_WT_STRING,     //destination_id
+  PB_WT_STRING,     //namespace
+  PB_WT_VARINT,     //payload_type
+  PB_WT_STRING,     //payload_utf8
+  PB_WT_STRING,     //payload_binary
+};
+
+int ArduCastControl::pbIndexMessage(const uint8_t *buffer, uint32_t len, bool truncated, castMsgIndex_t *index){
+  const uint8_t *end = buffer + len;
+  const uint8_t *p = buffer;
+  index->found = 0;
+  index->truncated = 0;
+  //no tag 0, an empty field for the missing ones
+  index->fields[0].offset = 0;
+  index->fields[0].len = 0;
+  while ( p < end ){
+    uint32_t tag;
+    uint8_t wire;
+    uint32_t length;  //or the value, truncated to 32 bits
+    bool cut = false;
+    //single byte key and value or length up to 2 bytes, all the fields of
+    //a CastMessage up to 16kB, without 64 bit arithmetic
+    if ( p[0] >= 0x08 && p[0] < 0x80 && end - p >= 3 &&
+         ((p[0] & 0x07) == PB_WT_VARINT || (p[0] & 0x07) == PB_WT_STRING) &&
+         (p[1] < 0x80 || p[2] < 0x80) ){
+      tag = p[0] >> 3;
+      wire = p[0] & 0x07;
+      if ( p[1] < 0x80 ){
+        length = p[1];
+        p += 2;
+      } else {
+        length = (p[1] & 0x7f) | ((uint32_t)p[2] << 7);
+        p += 3;
+      }
+    } else {
+      uint64_t lengthOrValue;
+      uint8_t processed = pbDecodeHeader(p, end, &tag, &wire, &lengthOrValue);
+      if ( processed == 0 )
+        return truncated ? 0 : -1; //the rest was cut, keep what was indexed
+      p += processed;
+      length = lengthOrValue;
+      if ( wire == PB_WT_STRING && lengthOrValue > (uint64_t)(end - p) )
+        length = UINT32_MAX; //checked below
+    }
+    if ( wire == PB_WT_STRING && length > (uint32_t)(end - p) ){
+      if ( !truncated )
+        return -1;
+      length = end - p;
+      cut = true;
+    }
+    if ( tag < CAST_MSG_FIELDS ){
+      if ( wire != CAST_MSG_WIRE[tag] )
+        return -1;
+      castField_t &field = index->fields[tag];
+      field.offset = p - buffer;
+      field.len = length;
+      index->found |= 1 << tag;
+      if ( cut )
+        index->truncated |= 1 << tag;
+    }
+    if ( wire == PB_WT_STRING )
+      p += length;
+  }
+  return 0;
+}
+
+
+void ArduCastControl::processJsonPayload(const uint8_t *payload, uint32_t len, uint8_t processPayload){
+  castStatus_t status;
+#ifdef ARDUCAST_USE_ARDUINOJSON
+  //the workspace is released from the arena when doc goes out of scope
+  ArduCastArena &workspace = shared->jsonArena != NULL ? *shared->jsonArena : arena;
+  ArenaJsonDocument doc(jsonBufferSize, ArenaJsonAllocator(workspace));
+  DeserializationError error = deserializeJson(doc, payload, len);
+  if ( doc.memoryUsage() > jsonHighWater )
+    jsonHighWater = doc.memoryUsage();
+  if ( error ){
+    metrics.parseErrors++;
+    return;
+  }
+  // serializeJsonPretty(doc, Serial);
+  // Serial.println();
+  memset(&status, 0, sizeof(status));
+  status.unescaped = true;
+  if ( doc.containsKey("type") ){
+    status.type.str = doc["type"].as<const char*>();
+    status.found |= CS_TYPE;
+  }
+  if ( doc.containsKey("requestId") ){
+    status.requestId = doc["requestId"];
+    status.found |= CS_REQUEST_ID;
+  }
+  if ( doc.containsKey("status") )
+    status.found |= CS_STATUS;
+  if ( processPayload == 1 ){
+    if ( doc["status"].containsKey("volume") ){
+      if( doc["status"]["volume"].containsKey("level")){
+        status.volume = doc["status"]["volume"]["level"];
+        status.found |= CS_VOLUME_LEVEL;
+      }
+      if( doc["status"]["volume"].containsKey("muted")){
+        status.muted = doc["status"]["volume"]["muted"].as<bool>();
+        status.found |= CS_VOLUME_MUTED;
+      }
+    }
+    if ( doc["status"].containsKey("applications") ){
+      if ( doc["status"]["applications"][0].containsKey("sessionId") ){
+        status.sessionId.str = doc["status"]["applications"][0]["sessionId"].as<const char*>();
+        status.found |= CS_SESSION_ID;
+      }
+      if ( doc["status"]["applications"][0].containsKey("statusText") ){
+        status.statusText.str = doc["status"]["applications"][0]["statusText"].as<const char*>();
+        status.found |= CS_STATUS_TEXT;
+      }
+      if ( doc["status"]["applications"][0].containsKey("displayName") ){
+        status.displayName.str = doc["status"]["applications"][0]["displayName"].as<const char*>();
+        status.found |= CS_DISPLAY_NAME;
+      }
+    }
+  } else {
+    if ( doc["status"][0].containsKey("mediaSessionId") ){
+      status.mediaSessionId = doc["status"][0]["mediaSessionId"];
+      status.found |= CS_MEDIA_SESSION_ID;
+    }
+    if ( doc["status"][0].containsKey("currentTime") ){
+      status.currentTime = doc["status"][0]["currentTime"];
+      status.found |= CS_CURRENT_TIME;
+    }
+    if ( doc["status"][0].containsKey("playbackRate") ){
+      status.playbackRate = doc["status"][0]["playbackRate"];
+      status.found |= CS_PLAYBACK_RATE;
+    }
+    if ( doc["status"][0].containsKey("playerState") ){
+      status.playerState.str = doc["status"][0]["playerState"].as<const char*>();
+      status.found |= CS_PLAYER_STATE;
+    }
+    if ( doc["status"][0].containsKey("media")){
+      status.found |= CS_MEDIA;
+      if ( doc["status"][0]["media"].containsKey("duration") ){
+        status.duration = doc["status"][0]["media"]["duration"];
+        status.found |= CS_DURATION;
+      }
+      if ( doc["status"][0]["media"]["metadata"].containsKey("title") ){
+        status.title.str = doc["status"][0]["media"]["metadata"]["title"].as<const char*>();
+        status.found |= CS_TITLE;
+      }
+      if ( doc["status"][0]["media"]["metadata"].containsKey("artist") ){
+        status.artist.str = doc["status"][0]["media"]["metadata"]["artist"].as<const char*>();
+        status.found |= CS_ARTIST;
+      }
+    }
+  }
+  //ArduinoJson returns terminated strings
+  jsonString_t *strings[] = { &status.type, &status.sessionId, &status.statusText, &status.displayName,
+                              &status.playerState, &status.title, &status.artist };
+  for(uint8_t i = 0; i < sizeof(strings)/sizeof(strings[0]); i++){
+    strings[i]->len = strings[i]->str != NULL ? strlen(strings[i]->str) : 0;
+  }
+#else
+  if ( !jsonExtractStatus(payload, len, &status) ){
+    metrics.parseErrors++;
+    return;
+  }
+#endif
+
+  //response to a command? 0 is unsolicited, 1 is GET_STATUS
+  if ( (status.found & CS_REQUEST_ID) && status.requestId > 1 ){
+    for(uint8_t i = 0; i < COMMAND_QUEUE_SIZE; i++){
+      if ( commands[i].state == CMD_PENDING && commands[i].requestId == status.requestId ){
+        bool isStatus = (status.found & CS_TYPE) &&
+            (jsonStringEquals(status.type, "RECEIVER_STATUS") || jsonStringEquals(status.type, "MEDIA_STATUS"));
+        histogramAdd(metrics.latency, millis() - commands[i].sentAt);
+        finishCommand(&commands[i], isStatus ? 0 : -13);
+        break;
+      }
+    }
+  }
+
+  //it pretty much must contain these
+  if ( !(status.found & CS_TYPE) || !(status.found & CS_STATUS) )
+    return;
+  bool applied = false;
+  if ( processPayload == 1 && jsonStringEquals(status.type, "RECEIVER_STATUS") ){
+    applyReceiverStatus(status);
+    deviceStatusAt = millis();
+    applied = true;
+  }
+  if ( processPayload == 2 && jsonStringEquals(status.type, "MEDIA_STATUS") ){
+    applyMediaStatus(status);
+    mediaStatusAt = millis();
+    applied = true;
+  }
+  if ( applied ){
+    if ( !(status.found & CS_REQUEST_ID) || status.requestId == 0 )
+      pushStats.statusPushed++;
+    else
+      pushStats.statusPolled++;
+  }
+}
+
+bool ArduCastControl::statusPollDue(unsigned long lastStatusAt, unsigned long &avoidedAt){
+  if ( !pushMode || lastStatusAt == 0 || millis() - lastStatusAt > statusFallbackInterval )
+    return true;
+  if ( avoidedAt == 0 || millis() - avoidedAt > RESPONSE_TIMEOUT ){
+    pushStats.pollsAvoided++;
+    avoidedAt = millis();
+  }
+  return false;
+}
+
+unsigned long ArduCastControl::statusDeadline(unsigned long lastStatusAt){
+  //same as statusPollDue(), without counting the avoided polls
+  if ( !pushMode || lastStatusAt == 0 )
+    return millis();
+  return lastStatusAt + statusFallbackInterval + 1;
+}
+
+void ArduCastControl::setPushMode(bool enable, uint32_t fallbackInterval){
+  pushMode = enable;
+  statusFallbackInterval = fallbackInterval;
+}
+
+void ArduCastControl::setCapture(ArduCastCapture *capture){
+  this->capture = capture;
+  txRing.setCapture(capture);
+}
+
+castClient_t& ArduCastControl::getClient(){
+  return client;
+}
+
+void ArduCastControl::setAutoReconnect(bool enable, uint32_t minBackoff, uint32_t maxBackoff){
+  autoReconnect = enable;
+  this->minBackoff = minBackoff;
+  this->maxBackoff = maxBackoff;
+  backoff = minBackoff;
+}
+
+void ArduCastControl::setKeepAlive(castSource_t channel, uint32_t ms){
+  if ( channel == SRC_APPLICATION )
+    applicationConnection.setKeepAlive(ms);
+  else
+    deviceConnection.setKeepAlive(ms);
+}
+
+/**
+ * Moves \ref until earlier if \ref deadline is before it. \ref until is
+ * relative to \ref now, so it works when millis() wraps around.
+ */
+static void earliest(uint32_t &until, unsigned long now, unsigned long deadline){
+  int32_t diff = (int32_t)(deadline - now);
+  if ( diff < 0 )
+    diff = 0;
+  if ( (uint32_t)diff < until )
+    until = diff;
+}
+
+unsigned long ArduCastControl::nextDeadline(){
+  unsigned long now = millis();
+  uint32_t until = UINT32_MAX;
+  //the next connection attempt, if the disconnection is already handled by loop()
+  if ( !client.connected() && connectionStatus == DISCONNECTED && autoReconnect && host[0] != '\0' ){
+    earliest(until, now, reconnectAt);
+    return now + until;
+  }
+  //loop() has to report the disconnection, or data is waiting
+  if ( !client.connected() || txRing.pending() > 0 || pongNeeded != 0 )
+    return now;
+  if ( client.available() > 0 ){
+    if ( shared->owner == NULL || shared->owner == this )
+      return now;
+    //the data can't be read until the other instance releases the buffer,
+    //at the latest when its message times out
+    earliest(until, now, shared->owner->rxLastAt + RX_TIMEOUT + 1);
+    earliest(until, now, now + SHARED_RX_POLL_INTERVAL);
+  }
+  if ( rxInProgress() )
+    earliest(until, now, rxLastAt + RX_TIMEOUT + 1);
+  for(uint8_t i = 0; i < COMMAND_QUEUE_SIZE; i++){
+    if ( commands[i].state == CMD_QUEUED )
+      return now;
+    if ( commands[i].state == CMD_PENDING )
+      earliest(until, now, commands[i].sentAt + COMMAND_TIMEOUT + 1);
+  }
+
+  if ( connectionStatus == CONNECT_TO_APPLICATION )
+    return now;
+  //same as the TX code of loop(), nothing else is written on a channel
+  //until its response arrives or times out
+  channelConnection_t device = deviceConnection.getConnectionStatus();
+  channelConnection_t application = applicationConnection.getConnectionStatus();
+  if ( requests[0].pending ){
+    earliest(until, now, requests[0].sentAt + RESPONSE_TIMEOUT + 1);
+  } else {
+    if ( application == CH_DISCONNECTED )
+      earliest(until, now, statusDeadline(deviceStatusAt));
+    if ( device != CH_DISCONNECTED )
+      earliest(until, now, deviceConnection.getPingDeadline());
+  }
+  if ( requests[1].pending ){
+    earliest(until, now, requests[1].sentAt + RESPONSE_TIMEOUT + 1);
+  } else if ( application != CH_DISCONNECTED ){
+    earliest(until, now, statusDeadline(mediaStatusAt));
+    earliest(until, now, applicationConnection.getPingDeadline());
+  }
+  return now + until;
+}
+
+uint32_t ArduCastControl::getSleepTime(){
+  unsigned long now = millis();
+  int32_t diff = (int32_t)(nextDeadline() - now);
+  return diff > 0 ? diff : 0;
+}
+
+const pushStats_t& ArduCastControl::getPushStats(){
+  return pushStats;
 }
 
-uint8_t ArduCastControl::pbDecodeHeader(uint8_t *bufferStart, uint8_t *tag, uint8_t *wire, uint32_t *lengthOrValue){
-  *wire = bufferStart[0] & 0x07;
-  *tag = bufferStart[0] >> 3;
-  uint8_t processedBytes = 1;
-  //Serial.printf("desc=0x%02x\n", bufferStart[0]);
-  processedBytes += pbDecodeVarint(bufferStart+1, lengthOrValue);
-  return processedBytes;
+/**
+ * Copies a string field from a decoded status, or clears it if it's not in
+ * the status.
+ * \return
+ *    True if the field changed
+ */
+static bool updateString(char *field, size_t fieldSize, const castStatus_t &status, uint32_t found, const jsonString_t &value){
+  if ( status.found & found )
+    return jsonCopyString(field, fieldSize, value, !status.unescaped);
+  if ( field[0] == '\0' )
+    return false;
+  field[0] = '\0';
+  return true;
 }
 
+void ArduCastControl::applyReceiverStatus(const castStatus_t &status){
+  uint16_t changed = 0;
+  //save the generic info
+  float newVolume = (status.found & CS_VOLUME_LEVEL) ? status.volume : -1.0;
+  bool newMuted = (status.found & CS_VOLUME_MUTED) ? status.muted : false;
+  if ( newVolume != volume )
+    changed |= SF_VOLUME;
+  if ( newMuted != isMuted )
+    changed |= SF_MUTED;
+  volume = newVolume;
+  isMuted = newMuted;
+
+  if ( status.found & CS_SESSION_ID ){
+    char newSessionId[sizeof(sessionId)];
+    jsonCopyString(newSessionId, sizeof(newSessionId), status.sessionId, !status.unescaped);
+    //RECEIVER_STATUS is also pushed e.g. on volume change, no need to
+    //reconnect to the application we're already connected to
+    if ( strcmp(newSessionId, sessionId) != 0 ||
+         applicationConnection.getConnectionStatus() == CH_DISCONNECTED ){
+      strcpy(sessionId, newSessionId);
+      connectionStatus = CONNECT_TO_APPLICATION;
+    }
+  } else
+    sessionId[0] = '\0';
+  if ( updateString(statusText, stringSize, status, CS_STATUS_TEXT, status.statusText) )
+    changed |= SF_APPLICATION;
+  if ( updateString(displayName, stringSize, status, CS_DISPLAY_NAME, status.displayName) )
+    changed |= SF_APPLICATION;
+
+  statusChanged(changed);
+}
+
+void ArduCastControl::applyMediaStatus(const castStatus_t &status){
+  uint16_t changed = 0;
+  mediaSessionId = (status.found & CS_MEDIA_SESSION_ID) ? status.mediaSessionId : -1;
+  float newTime = (status.found & CS_CURRENT_TIME) ? status.currentTime : 0.0;
+  if ( newTime != currentTime )
+    changed |= SF_CURRENT_TIME;
+  currentTime = newTime;
+  currentTimeAt = millis();
+  float newRate = (status.found & CS_PLAYBACK_RATE) ? status.playbackRate : 1.0;
+  if ( newRate != playbackRate )
+    changed |= SF_PLAYBACK_RATE;
+  playbackRate = newRate;
+
+  playerState_t newState = IDLE;
+  if ( status.found & CS_PLAYER_STATE ){
+    if ( jsonStringEquals(status.playerState, "BUFFERING") ){
+      newState = BUFFERING;
+    } else if ( jsonStringEquals(status.playerState, "PLAYING") ){
+      newState = PLAYING;
+    } else if ( jsonStringEquals(status.playerState, "PAUSED") ){
+      newState = PAUSED;
+    }
+  }
+  if ( newState != playerState )
+    changed |= SF_PLAYER_STATE;
+  playerState = newState;
+
+  //CC seems to skip sending media when it's busy, so we keep the old values
+  if ( status.found & CS_MEDIA ){
+    float newDuration = (status.found & CS_DURATION) ? status.duration : 0.0;
+    if ( newDuration != duration )
+      changed |= SF_MEDIA;
+    duration = newDuration;
+    if ( updateString(title, stringSize, status, CS_TITLE, status.title) )
+      changed |= SF_MEDIA;
+    if ( updateString(artist, stringSize, status, CS_ARTIST, status.artist) )
+      changed |= SF_MEDIA;
+  }
+
+  statusChanged(changed);
+}
+
+void ArduCastControl::statusChanged(uint16_t changed){
+  dirty |= changed;
+  changedInLoop |= changed;
+}
+
+void ArduCastControl::notifyChanges(){
+  uint16_t changed = changedInLoop;
+  changedInLoop = 0;
+  if ( changed == 0 )
+    return;
+  for(uint8_t i = 0; i < CHANGE_CALLBACKS_SIZE; i++){
+    if ( changeCallbacks[i].callback != NULL && (changeCallbacks[i].mask & changed) )
+      changeCallbacks[i].callback(*this, changeCallbacks[i].mask & changed, changeCallbacks[i].arg);
+  }
+}
+
+int ArduCastControl::onChange(uint16_t mask, changeCallback_t callback, void *arg){
+  for(uint8_t i = 0; i < CHANGE_CALLBACKS_SIZE; i++){
+    if ( changeCallbacks[i].callback == NULL ){
+      changeCallbacks[i].mask = mask;
+      changeCallbacks[i].callback = callback;
+      changeCallbacks[i].arg = arg;
+      return 0;
+    }
+  }
+  return -11;
+}
+
+void ArduCastControl::removeOnChange(changeCallback_t callback, void *arg){
+  for(uint8_t i = 0; i < CHANGE_CALLBACKS_SIZE; i++){
+    if ( changeCallbacks[i].callback == callback && changeCallbacks[i].arg == arg )
+      changeCallbacks[i].callback = NULL;
+  }
+}
+
+int ArduCastControl::onNamespace(const char *nameSpace, namespaceHandler_t handler, void *arg){
+  return addNamespaceHandler(nameSpace, false, handler, arg);
+}
+
+int ArduCastControl::onBinaryNamespace(const char *nameSpace, namespaceHandler_t handler, void *arg){
+  return addNamespaceHandler(nameSpace, true, handler, arg);
+}
+
+int ArduCastControl::addNamespaceHandler(const char *nameSpace, bool binary, namespaceHandler_t handler, void *arg){
+  for(uint8_t i = 0; i < NAMESPACE_HANDLERS_SIZE; i++){
+    if ( namespaceHandlers[i].id == 0 ){
+      //known namespace (either ours or registered already), or a new ID
+      uint8_t id = namespaces.lookup((const uint8_t*)nameSpace, strlen(nameSpace));
+      if ( id == 0 ){
+        id = NS_CUSTOM + i;
+        if ( namespaces.add(nameSpace, id) != 0 )
+          return -11;
+      }
+      namespaceHandlers[i].id = id;
+      namespaceHandlers[i].binary = binary;
+      namespaceHandlers[i].nameSpace = nameSpace;
+      namespaceHandlers[i].handler = handler;
+      namespaceHandlers[i].arg = arg;
+      return 0;
+    }
+  }
+  return -11;
+}
+
+void ArduCastControl::removeOnNamespace(const char *nameSpace, namespaceHandler_t handler, void *arg){
+  for(uint8_t i = 0; i < NAMESPACE_HANDLERS_SIZE; i++){
+    uint8_t id = namespaceHandlers[i].id;
+    if ( id == 0 || namespaceHandlers[i].handler != handler || namespaceHandlers[i].arg != arg || strcmp(namespaceHandlers[i].nameSpace, nameSpace) != 0 )
+      continue;
+    namespaceHandlers[i].id = 0;
+    if ( id < NS_CUSTOM )
+      continue;
+    //drop the namespace from the dispatch table with its last handler
+    bool used = false;
+    for(uint8_t j = 0; j < NAMESPACE_HANDLERS_SIZE; j++)
+      used |= namespaceHandlers[j].id == id;
+    if ( !used )
+      namespaces.remove(id);
+  }
+}
+
+void ArduCastControl::dispatchNamespace(uint8_t id, bool binary, uint8_t source, const uint8_t *payload, uint32_t len){
+  for(uint8_t i = 0; i < NAMESPACE_HANDLERS_SIZE; i++){
+    if ( namespaceHandlers[i].id == id && namespaceHandlers[i].binary == binary )
+      namespaceHandlers[i].handler(*this, source, namespaceHandlers[i].nameSpace, payload, len, namespaceHandlers[i].arg);
+  }
+}
+
+int ArduCastControl::sendMessage(castSource_t to, const char *nameSpace, const char *payload){
+  return sendMessage(to, nameSpace, payload, strlen(payload));
+}
+
+ArduCastConnection* ArduCastControl::getChannel(castSource_t to){
+  ArduCastConnection &connection = to == SRC_APPLICATION ? applicationConnection : deviceConnection;
+  if ( connectionStatus == DISCONNECTED || connection.getConnectionStatus() == CH_DISCONNECTED )
+    return NULL;
+  return &connection;
+}
+
+int ArduCastControl::sendMessage(castSource_t to, const char *nameSpace, const char *payload, uint32_t len){
+  ArduCastConnection *connection = getChannel(to);
+  if ( connection == NULL )
+    return -1;
+  return connection->writeMsg(nameSpace, payload, len);
+}
+
+int ArduCastControl::sendBinaryMessage(castSource_t to, const char *nameSpace, const uint8_t *payload, uint32_t len){
+  ArduCastConnection *connection = getChannel(to);
+  if ( connection == NULL )
+    return -1;
+  return connection->writeBinaryMsg(nameSpace, payload, len);
+}
+
+uint16_t ArduCastControl::getDirty(){
+  return dirty;
+}
+
+void ArduCastControl::clearDirty(uint16_t mask){
+  dirty &= ~mask;
+}
 
 connection_t ArduCastControl::loop(){
   if ( !client.connected() ){
-    client.stopAll();
+    client.stop();
+    txRing.clear();
+    purgeRawMessage(client);
+    finishAllCommands(-1);
     connectionStatus = DISCONNECTED;
-    return DISCONNECTED;
+    clearRequests();
+    if ( !autoReconnect || host[0] == '\0' || (int32_t)(millis() - reconnectAt) < 0 )
+      return DISCONNECTED;
+    //continue with the new connection, e.g. to rejoin the application
+    connect(host, port);
+    if ( !client.connected() )
+      return DISCONNECTED;
   }
   uint32_t read;
   bool rxProcessed = false;
   
   //--------------------- RX code -----------------------------
   do {
+    //another instance is downloading to the shared buffer, leave the data in the client
+    if ( shared->owner != NULL && shared->owner != this )
+      break;
     //download the msg to connBuffer (only accept what we expect)
-    read = getRawMessage(connBuffer, CONNBUFFER_SIZE, client, 100);
+    read = getRawMessage(connBuffer, connBufferSize, client, RX_TIMEOUT);
+    shared->owner = rxInProgress() ? this : NULL;
     if ( read > 0){
+      CC_TRACE(TRACE_FRAME_READ, 0, read);
+      if ( capture != NULL )
+        capture->record(CAPTURE_RX, connBuffer, read);
+      unsigned long parseStart = micros();
       rxProcessed = true; //this will disable tx operations in this loop
-      msgSent = false; //we assume this is a response to the message we sent
-      errorCount = 5; //connection is alive, reset errorCount
-      uint8_t processPayload = 0; //assume no need to process it
       //printRawMsg(read-4, connBuffer+4);
-      uint32_t offset = 4; //skip the length field, it's not pb
-      //iterate through protobuf
-      do {
-        uint8_t tag, wire;
-        uint32_t lengthOrValue;
-        
-        offset += pbDecodeHeader(connBuffer+offset, &tag, &wire, &lengthOrValue);
-        //check which device responded, accept it as pong
-        if ( tag == extensions_api_cast_channel_CastMessage_source_id_tag ){
-          if( 0 == memcmp(connBuffer+offset, deviceConnection.getDestinationId(), lengthOrValue))
-          {
-            //main device, process the payload of main RECEIVER_STATUS
-            // Serial.println("Pong from device");
-            deviceConnection.pinged();
-            processPayload = 1;
-          }
-          if ( applicationConnection.getConnectionStatus() != CH_DISCONNECTED &&
-              0 == memcmp(connBuffer+offset, applicationConnection.getDestinationId(), lengthOrValue))
-          {
-            //application, process the payload as MEDIA_STATUS
-            // Serial.println("Pong from app");
-            processPayload = 2;
-            applicationConnection.pinged();
-          }
+      //the length field is not pb, it's bigger than what we have if the message was truncated
+      uint32_t msgLen = ((uint32_t)connBuffer[0]<<24) + ((uint32_t)connBuffer[1]<<16) + ((uint32_t)connBuffer[2]<<8) + connBuffer[3];
+      castMsgIndex_t msg;
+      if ( pbIndexMessage(connBuffer+4, read-4, msgLen > read-4, &msg) != 0 ){
+        metrics.framesMalformed++;
+        continue;
+      }
+      CC_TRACE(TRACE_HEADER, msg.found, read);
+      uint8_t *fields = connBuffer+4;
+      uint8_t processPayload = 0; //assume no need to process it
+      uint8_t heartbeatFrom = 0; //channel of a heartbeat message, if any
+      uint8_t source = 0, nameSpace = 0;
+
+      //check which device responded, accept it as pong
+      if ( msg.found & (1 << extensions_api_cast_channel_CastMessage_source_id_tag) ){
+        const castField_t &field = msg.fields[extensions_api_cast_channel_CastMessage_source_id_tag];
+        source = sources.lookup(fields+field.offset, field.len);
+        if ( source == SRC_DEVICE ){
+          //main device, process the payload of main RECEIVER_STATUS
+          // Serial.println("Pong from device");
+          deviceConnection.pinged();
+          processPayload = 1;
+        } else if ( source == SRC_APPLICATION && applicationConnection.getConnectionStatus() != CH_DISCONNECTED ){
+          //application, process the payload as MEDIA_STATUS
+          // Serial.println("Pong from app");
+          processPayload = 2;
+          applicationConnection.pinged();
         }
-        //check the namespace, we're only process receiver and media
-        if ( tag == extensions_api_cast_channel_CastMessage_namespace_fix_tag ){
-          if( 0 == memcmp(connBuffer+offset, CC_NS_HEARTBEAT, lengthOrValue)){ //pong message, no need to process the payload
-            processPayload = 0; 
-          }
-          if( 0 == memcmp(connBuffer+offset, CC_NS_CONNECTION, lengthOrValue)){ //must be a close message
-            if ( processPayload == 1 ){
-              applicationConnection.setDisconnect();
-              deviceConnection.setDisconnect();
-              connectionStatus = TCPALIVE;
-              processPayload = false;
-            } else if ( processPayload == 2) {
-              applicationConnection.setDisconnect();
-              processPayload = false;
-            }
-          }
+      }
+      //we assume this is a response to the message we sent on the channel
+      if ( processPayload > 0 ){
+        channelRequest_t &request = requests[processPayload - 1];
+        if ( request.pending )
+          histogramAdd(metrics.latency, millis() - request.sentAt);
+        request.pending = false;
+        request.errorCount = 5; //channel is alive, reset errorCount
+      }
+      //check the namespace, we're only process receiver and media
+      if ( msg.found & (1 << extensions_api_cast_channel_CastMessage_namespace_fix_tag) ){
+        const castField_t &field = msg.fields[extensions_api_cast_channel_CastMessage_namespace_fix_tag];
+        nameSpace = namespaces.lookup(fields+field.offset, field.len);
+        if( nameSpace == NS_HEARTBEAT ){ //pong message, no need to process the payload
+          heartbeatFrom = processPayload;
+          processPayload = 0; 
         }
-
-        if ( processPayload > 0 && tag == extensions_api_cast_channel_CastMessage_payload_utf8_tag ){
-          DynamicJsonDocument doc(JSONBUFFER_SIZE);
-          DeserializationError error = deserializeJson(doc, connBuffer+offset, lengthOrValue);
-          if ( !error && doc.containsKey("type") && doc.containsKey("status") ){ //it pretty much must contain it
-            if ( processPayload == 1 && strcmp("RECEIVER_STATUS", doc["type"].as<char*>()) == 0 ) {
-              //save the generic info
-              if ( doc["status"].containsKey("volume") ){
-                if( doc["status"]["volume"].containsKey("level")){
-                  volume = doc["status"]["volume"]["level"];
-                } else
-                  volume = -1.0;
-                
-                if( doc["status"]["volume"].containsKey("muted"))
-                  isMuted = doc["status"]["volume"]["muted"].as<bool>();
-                else
-                  isMuted = false;
-              
-              } else {
-                volume = -1.0;
-                isMuted = false;
-              }
-              if ( doc["status"].containsKey("applications") ){
-                if ( doc["status"]["applications"][0].containsKey("sessionId") ){
-                  strncpy(sessionId, doc["status"]["applications"][0]["sessionId"].as<char*>() ,sizeof(sessionId));
-                  sessionId[sizeof(sessionId)-1] = '\n';
-                  connectionStatus = CONNECT_TO_APPLICATION;
-                } else 
-                  sessionId[0] = '\n';
-                if ( doc["status"]["applications"][0].containsKey("statusText") ){
-                  strncpy(statusText, doc["status"]["applications"][0]["statusText"].as<char*>() ,sizeof(statusText));
-                  statusText[sizeof(statusText)-1] = '\n';
-                } else
-                  statusText[0] = '\n';
-                if ( doc["status"]["applications"][0].containsKey("displayName") ){
-                  strncpy(displayName, doc["status"]["applications"][0]["displayName"].as<char*>() ,sizeof(displayName));
-                  displayName[sizeof(displayName)-1] = '\n';
-                } else
-                  displayName[0] = '\n';
-              } else {
-                sessionId[0] = '\0';
-                statusText[0] = '\0';
-                displayName[0] = '\0';
-              }
-            }
-            if ( processPayload == 2 && strcmp("MEDIA_STATUS", doc["type"].as<char*>()) == 0 ) {
-              if ( doc["status"][0].containsKey("mediaSessionId") )
-                mediaSessionId = doc["status"][0]["mediaSessionId"];
-              else
-                mediaSessionId = -1;
-              
-              if ( doc["status"][0].containsKey("currentTime") )
-                currentTime = doc["status"][0]["currentTime"];
-              else
-                currentTime = 0.0;
-            
-              if ( doc["status"][0].containsKey("playerState") ){
-                if ( strcmp("IDLE", doc["status"][0]["playerState"].as<char*>()) == 0 ){
-                  playerState = IDLE;
-                } else if ( strcmp("BUFFERING", doc["status"][0]["playerState"].as<char*>()) == 0 ){
-                  playerState = BUFFERING;
-                } else if ( strcmp("PLAYING", doc["status"][0]["playerState"].as<char*>()) == 0 ){
-                  playerState = PLAYING;
-                } else if ( strcmp("PAUSED", doc["status"][0]["playerState"].as<char*>()) == 0 ){
-                  playerState = PAUSED;
-                } else {
-                  playerState = IDLE;
-                }
-              } else
-                playerState = IDLE;
-              
-              if ( doc["status"][0].containsKey("media")){
-                if ( doc["status"][0]["media"].containsKey("duration") ){
-                  duration = doc["status"][0]["media"]["duration"];
-                } else {
-                  duration = 0.0;
-                }
-                if ( doc["status"][0]["media"].containsKey("metadata") ){
-                  if ( doc["status"][0]["media"]["metadata"].containsKey("title") ){
-                    strncpy(title, doc["status"][0]["media"]["metadata"]["title"].as<char*>() ,sizeof(title));
-                    title[sizeof(title)-1] = '\n';
-                  } else {
-                    title[0] = '\0';
-                  }
-                  if ( doc["status"][0]["media"]["metadata"].containsKey("artist") ){
-                    strncpy(artist, doc["status"][0]["media"]["metadata"]["artist"].as<char*>() ,sizeof(artist));
-                    artist[sizeof(artist)-1] = '\n';
-                  } else {
-                    artist[0] = '\0';
-                  }
-                } else {
-                  title[0] = '\n';
-                  artist[0] = '\n';  
-                }
-              } else {
-                //CC seems to skip sending this when it's busy, so we ignore the error
-                // duration = 0.0;
-                // title[0] = '\n';
-                // artist[0] = '\n';
-              }
-            }
+        if( nameSpace == NS_CONNECTION ){ //must be a close message
+          if ( processPayload == 1 ){
+            applicationConnection.setDisconnect();
+            deviceConnection.setDisconnect();
+            clearRequests(1);
+            connectionStatus = TCPALIVE;
+            processPayload = false;
+          } else if ( processPayload == 2) {
+            applicationConnection.setDisconnect();
+            processPayload = false;
           }
-          // serializeJsonPretty(doc, Serial);
-          // Serial.println();
         }
+        //anything else is only for the namespace handlers
+        if ( nameSpace != NS_RECEIVER && nameSpace != NS_MEDIA )
+          processPayload = 0;
+      }
 
+      uint8_t payloadTag = 0;
+      if ( msg.found & (1 << extensions_api_cast_channel_CastMessage_payload_utf8_tag) )
+        payloadTag = extensions_api_cast_channel_CastMessage_payload_utf8_tag;
+      else if ( msg.found & (1 << extensions_api_cast_channel_CastMessage_payload_binary_tag) )
+        payloadTag = extensions_api_cast_channel_CastMessage_payload_binary_tag;
+      const uint8_t *payload = fields + msg.fields[payloadTag].offset;
+      uint32_t payloadLen = msg.fields[payloadTag].len;
 
+      if ( processPayload > 0 && payloadTag == extensions_api_cast_channel_CastMessage_payload_utf8_tag ){
+        CC_TRACE(TRACE_JSON_PARSE, processPayload, payloadLen);
+        processJsonPayload(payload, payloadLen, processPayload);
+        CC_TRACE(TRACE_JSON_DONE, processPayload, 0);
+      }
 
+      if ( nameSpace > 0 && payloadTag > 0 ){
+        //the source is only reported if it's a connected channel
+        if ( source == SRC_APPLICATION && applicationConnection.getConnectionStatus() == CH_DISCONNECTED )
+          source = 0;
+        CC_TRACE(TRACE_DISPATCH, nameSpace, payloadLen);
+        dispatchNamespace(nameSpace, payloadTag == extensions_api_cast_channel_CastMessage_payload_binary_tag, source, payload, payloadLen);
+        CC_TRACE(TRACE_DISPATCH_DONE, nameSpace, 0);
+      }
 
-        //DEBUG code -- this does not work when DynamicJson is used, probably not enough heap
-        // Serial.printf("T:%d, W:%d", tag, wire);
-        // if ( wire == 2 ){
-        //   Serial.printf(" (%d): ", lengthOrValue);
-        //   Serial.printf("%.*s\n", lengthOrValue, connBuffer+offset);
-        // } else {
-        //   Serial.printf(": %d\n", lengthOrValue);
-        // }
-        //end of debug code
-
-
-        //for length delimited stuff, add the decoded length to the offset
-        if ( wire == 2)
-          offset+=lengthOrValue;
-      } while(offset<read);
+      //chromecast pings us too, answer it in the TX code (the buffer is in use now)
+      if ( heartbeatFrom > 0 && payloadTag == extensions_api_cast_channel_CastMessage_payload_utf8_tag ){
+        castStatus_t heartbeat;
+        jsonExtractStatus(payload, payloadLen, &heartbeat);
+        if ( (heartbeat.found & CS_TYPE) && jsonStringEquals(heartbeat.type, "PING") )
+          pongNeeded |= heartbeatFrom;
+      }
+      nsMetrics_t &ns = metrics.ns[nameSpace < METRICS_NAMESPACES ? nameSpace : 0];
+      ns.framesIn++;
+      ns.bytesIn += read;
+      histogramAdd(metrics.parseTime, micros() - parseStart);
+      CC_TRACE(TRACE_FRAME_DONE, nameSpace, 0);
     }
   } while ( read > 0);
   
   // ---------------- TX code ------------------------
-  //don't send msg if we just received one; wait 500ms for an answer
-  if ( !rxProcessed && (!msgSent || ((millis() - msgSentAt) > 500 ))){ 
-    //handle broken links
-    if ( msgSent ){
-      Serial.printf("EC:%d\n", errorCount);
-      if (--errorCount == 0 ){
-        client.stopAll();
+  //whatever the TCP channel didn't accept last time
+  txRing.flush();
+  //commands and pongs are written regardless of the status polling below
+  checkCommandTimeouts();
+  flushCommands();
+  //keep the pong for later if the TX ring is full
+  if ( (pongNeeded & 1) && deviceConnection.writeMsg(CC_NS_HEARTBEAT, CC_MSG_PONG) != -3 )
+    pongNeeded &= ~1;
+  if ( (pongNeeded & 2) && applicationConnection.writeMsg(CC_NS_HEARTBEAT, CC_MSG_PONG) != -3 )
+    pongNeeded &= ~2;
+
+  //don't send msg if we just received one; wait for an answer
+  if ( !rxProcessed ){
+    //handle broken links, each channel waits for its own response
+    for(uint8_t i = 0; i < 2; i++){
+      channelRequest_t &request = requests[i];
+      if ( !request.pending || millis() - request.sentAt <= RESPONSE_TIMEOUT )
+        continue;
+      request.pending = false;
+      metrics.responseTimeouts++;
+      if (--request.errorCount == 0 ){
+        client.stop();
+        txRing.clear();
+        finishAllCommands(-1);
         connectionStatus = DISCONNECTED;
-        msgSent = false;
+        clearRequests();
         return DISCONNECTED;
       }
     }
 
     // Serial.println("Preparing for msg");
-    msgSent = false;
     int err = 0;
     if ( connectionStatus == CONNECT_TO_APPLICATION ){
       // Serial.print("CA");
       err = applicationConnection.connect(sessionId);
+      sources.remove(SRC_APPLICATION);
+      sources.add(applicationConnection.getDestinationId(), SRC_APPLICATION);
+      mediaStatusAt = 0; //get the status of the new application right away
+      clearRequests(1); //nothing is expected from the new channel yet
       if ( err == 0 )
         connectionStatus = CONNECTED;
-    } else if ( applicationConnection.getConnectionStatus() == CH_DISCONNECTED ){
-      // Serial.print("GS");
-      err = deviceConnection.writeMsg(CC_NS_RECEIVER, CC_MSG_GET_STATUS);
-      if ( err == 0 ) {
-        msgSentAt = millis();
-        msgSent = true;
-      }
-    } else if ( deviceConnection.getConnectionStatus() == CH_NEEDS_PING ){
-      // Serial.print("ping main");
-      err = deviceConnection.writeMsg(CC_NS_HEARTBEAT, CC_MSG_PING);
-      if ( err == 0 ) {
-        msgSentAt = millis();
-        msgSent = true;
-      }
-    } else if ( applicationConnection.getConnectionStatus() == CH_CONNECTED ){
-      // Serial.print("GSA");
-      err = applicationConnection.writeMsg(CC_NS_MEDIA, CC_MSG_GET_STATUS);
-      if ( err == 0 ) {
-        msgSentAt = millis();
-        msgSent = true;
+    }
+    //GET_STATUS can follow the CONNECT right away
+    if ( connectionStatus != CONNECT_TO_APPLICATION ){
+      //the channels are independent, serve whatever is due on each, once
+      //the response to its last request arrived
+      if ( !requests[0].pending && applicationConnection.getConnectionStatus() == CH_DISCONNECTED && statusPollDue(deviceStatusAt, devicePollAvoidedAt) ){
+        // Serial.print("GS");
+        err = deviceConnection.writeGetStatus();
+        if ( err == 0 ) {
+          requests[0].sentAt = millis();
+          requests[0].pending = true;
+          pushStats.pollsSent++;
+        }
+      } else if ( !requests[0].pending && deviceConnection.getConnectionStatus() == CH_NEEDS_PING ){
+        // Serial.print("ping main");
+        err = deviceConnection.writePing();
+        if ( err == 0 ) {
+          requests[0].sentAt = millis();
+          requests[0].pending = true;
+        }
       }
-    } else if ( applicationConnection.getConnectionStatus() == CH_NEEDS_PING ){ //this will never happen, unless loop is called rarely
-      // Serial.print("ping app");
-      err = applicationConnection.writeMsg(CC_NS_HEARTBEAT, CC_MSG_PING);
-      if ( err == 0 ) {
-        msgSentAt = millis();
-        msgSent = true;
+      if ( !requests[1].pending && applicationConnection.getConnectionStatus() == CH_CONNECTED && statusPollDue(mediaStatusAt, mediaPollAvoidedAt) ){
+        // Serial.print("GSA");
+        err = applicationConnection.writeGetStatus();
+        if ( err == 0 ) {
+          requests[1].sentAt = millis();
+          requests[1].pending = true;
+          pushStats.pollsSent++;
+        }
+      } else if ( !requests[1].pending && applicationConnection.getConnectionStatus() == CH_NEEDS_PING ){ //only on an idle channel, e.g. in push mode
+        // Serial.print("ping app");
+        err = applicationConnection.writePing();
+        if ( err == 0 ) {
+          requests[1].sentAt = millis();
+          requests[1].pending = true;
+        }
       }
     }
-    // if (msgSent ){
+    // if ( requests[0].pending || requests[1].pending ){
     //    Serial.printf("Res: %d\n", err);
     // }
   }
 
+  notifyChanges();
   return getConnection();
 }
 
+void ArduCastControl::clearRequests(uint8_t channel){
+  for(uint8_t i = channel; i < 2; i++){
+    requests[i].pending = false;
+    requests[i].errorCount = 5;
+  }
+}
+
 connection_t ArduCastControl::getConnection(){
-  if ( msgSent )
+  if ( requests[0].pending || requests[1].pending )
     return WAIT_FOR_RESPONSE;
   if ( applicationConnection.getConnectionStatus() != CH_DISCONNECTED )
     return APPLICATION_RUNNING;
@@ -475,6 +1648,17 @@ connection_t ArduCastControl::getConnection(){
   return connectionStatus;
 }
 
+float ArduCastControl::getEstimatedTime(){
+  if ( playerState != PLAYING )
+    return currentTime;
+  float estimated = currentTime + (millis() - currentTimeAt) / 1000.0 * playbackRate;
+  if ( estimated < 0 )
+    estimated = 0;
+  if ( duration > 0 && estimated > duration )
+    estimated = duration;
+  return estimated;
+}
+
 void ArduCastControl::dumpStatus(){
   if ( getConnection() != DISCONNECTED && getConnection() != TCPALIVE ){
     Serial.printf("V:%f%c\n", volume, isMuted?'M':' ');
@@ -489,71 +1673,178 @@ void ArduCastControl::dumpStatus(){
 
 
 
-int ArduCastControl::play(){
-  if ( msgSent )
-    return -10;
+command_t* ArduCastControl::newCommand(){
+  for(uint8_t i = 0; i < COMMAND_QUEUE_SIZE; i++){
+    if ( commands[i].state == CMD_FREE ){
+      commands[i].requestId = nextRequestId++;
+      if ( nextRequestId < 2 ) //wrapped around
+        nextRequestId = 2;
+      return &commands[i];
+    }
+  }
+  return NULL;
+}
+
+int ArduCastControl::queueCommand(command_t *cmd, ArduCastConnection &connection, const char *nameSpace, commandCallback_t callback, void *callbackArg){
+  cmd->connection = &connection;
+  cmd->nameSpace = nameSpace;
+  cmd->callback = callback;
+  cmd->callbackArg = callbackArg;
+
+  //write immediately if nothing is queued before it
+  bool queued = false;
+  for(uint8_t i = 0; i < COMMAND_QUEUE_SIZE; i++){
+    if ( commands[i].state == CMD_QUEUED )
+      queued = true;
+  }
+  if ( queued ){
+    cmd->state = CMD_QUEUED;
+    return 0;
+  }
+
+  int err = connection.writeMsg(nameSpace, cmd->payload);
+  if ( err == -3 ){ //TX ring is full, flushCommands() will retry
+    cmd->state = CMD_QUEUED;
+    return 0;
+  }
+  if ( err != 0 ){
+    cmd->state = CMD_FREE;
+    return err;
+  }
+  cmd->state = CMD_PENDING;
+  cmd->sentAt = millis();
+  return 0;
+}
+
+void ArduCastControl::flushCommands(){
+  while ( true ){
+    //the oldest queued command is the one with the smallest requestId
+    command_t *cmd = NULL;
+    for(uint8_t i = 0; i < COMMAND_QUEUE_SIZE; i++){
+      if ( commands[i].state == CMD_QUEUED &&
+           (cmd == NULL || (int32_t)(commands[i].requestId - cmd->requestId) < 0) )
+        cmd = &commands[i];
+    }
+    if ( cmd == NULL )
+      return;
+
+    int err = cmd->connection->writeMsg(cmd->nameSpace, cmd->payload);
+    if ( err == -3 ){
+      return; //TX ring is full, retry in the next loop
+    } else if ( err != 0 ){
+      finishCommand(cmd, err);
+    } else {
+      cmd->state = CMD_PENDING;
+      cmd->sentAt = millis();
+    }
+  }
+}
+
+void ArduCastControl::checkCommandTimeouts(){
+  for(uint8_t i = 0; i < COMMAND_QUEUE_SIZE; i++){
+    if ( commands[i].state == CMD_PENDING && millis() - commands[i].sentAt > COMMAND_TIMEOUT ){
+      metrics.commandTimeouts++;
+      finishCommand(&commands[i], -12);
+    }
+  }
+}
+
+void ArduCastControl::finishCommand(command_t *cmd, int result){
+  //free the slot first, so the callback can issue a new command
+  cmd->state = CMD_FREE;
+  if ( cmd->callback != NULL )
+    cmd->callback(cmd->requestId, result, cmd->callbackArg);
+}
+
+void ArduCastControl::finishAllCommands(int result){
+  for(uint8_t i = 0; i < COMMAND_QUEUE_SIZE; i++){
+    if ( commands[i].state != CMD_FREE )
+      finishCommand(&commands[i], result);
+  }
+}
+
+int ArduCastControl::play(commandCallback_t callback, void *callbackArg){
+  if ( !client.connected() )
+    return -1;
   if ( mediaSessionId < 0 )
     return -9;
-  
-  snprintf(cc_msg_ctrl, sizeof(cc_msg_ctrl), "%s%d}", CC_MSG_PLAY, mediaSessionId );
-  return applicationConnection.writeMsg(CC_NS_MEDIA, cc_msg_ctrl);
+  command_t *cmd = newCommand();
+  if ( cmd == NULL )
+    return -11;
+
+  snprintf(cmd->payload, sizeof(cmd->payload), CC_MSG_PLAY, (unsigned long)cmd->requestId, mediaSessionId);
+  return queueCommand(cmd, applicationConnection, CC_NS_MEDIA, callback, callbackArg);
 }
 
-int ArduCastControl::pause(bool toggle){
-  if ( msgSent )
-    return -10;
+int ArduCastControl::pause(bool toggle, commandCallback_t callback, void *callbackArg){
+  if ( !client.connected() )
+    return -1;
   if ( mediaSessionId < 0 )
     return -9;
   
   if ( toggle && playerState == PAUSED )
-    return play();
-  else {
-    snprintf(cc_msg_ctrl, sizeof(cc_msg_ctrl), "%s%d}", CC_MSG_PAUSE, mediaSessionId );
-    return applicationConnection.writeMsg(CC_NS_MEDIA, cc_msg_ctrl);
-  }
+    return play(callback, callbackArg);
+
+  command_t *cmd = newCommand();
+  if ( cmd == NULL )
+    return -11;
+  snprintf(cmd->payload, sizeof(cmd->payload), CC_MSG_PAUSE, (unsigned long)cmd->requestId, mediaSessionId);
+  return queueCommand(cmd, applicationConnection, CC_NS_MEDIA, callback, callbackArg);
 }
 
-int ArduCastControl::prev(){
-  if ( msgSent )
-    return -10;
+int ArduCastControl::prev(commandCallback_t callback, void *callbackArg){
+  if ( !client.connected() )
+    return -1;
   if ( mediaSessionId < 0 )
     return -9;
+  command_t *cmd = newCommand();
+  if ( cmd == NULL )
+    return -11;
 
-  snprintf(cc_msg_ctrl, sizeof(cc_msg_ctrl), "%s%d}", CC_MSG_PREV, mediaSessionId );
-  return applicationConnection.writeMsg(CC_NS_MEDIA, cc_msg_ctrl);
+  snprintf(cmd->payload, sizeof(cmd->payload), CC_MSG_PREV, (unsigned long)cmd->requestId, mediaSessionId);
+  return queueCommand(cmd, applicationConnection, CC_NS_MEDIA, callback, callbackArg);
 }
 
-int ArduCastControl::next(){
-  if ( msgSent )
-    return -10;
+int ArduCastControl::next(commandCallback_t callback, void *callbackArg){
+  if ( !client.connected() )
+    return -1;
   if ( mediaSessionId < 0 )
     return -9;
+  command_t *cmd = newCommand();
+  if ( cmd == NULL )
+    return -11;
   
-  snprintf(cc_msg_ctrl, sizeof(cc_msg_ctrl), "%s%d}", CC_MSG_NEXT, mediaSessionId );
-  return applicationConnection.writeMsg(CC_NS_MEDIA, cc_msg_ctrl);
+  snprintf(cmd->payload, sizeof(cmd->payload), CC_MSG_NEXT, (unsigned long)cmd->requestId, mediaSessionId);
+  return queueCommand(cmd, applicationConnection, CC_NS_MEDIA, callback, callbackArg);
 }
 
-int ArduCastControl::seek(bool relative, float seekTo){
-  if ( msgSent )
-    return -10;
+int ArduCastControl::seek(bool relative, float seekTo, commandCallback_t callback, void *callbackArg){
+  if ( !client.connected() )
+    return -1;
   if ( mediaSessionId < 0 )
     return -9;
+  command_t *cmd = newCommand();
+  if ( cmd == NULL )
+    return -11;
   
   if ( relative )
-    seekTo += currentTime;
+    seekTo += getEstimatedTime();
   
   if ( seekTo < 0 )
     seekTo = 0;
   if ( seekTo > duration )
     seekTo = duration;
 
-  snprintf(cc_msg_ctrl, sizeof(cc_msg_ctrl), "{\"type\": \"SEEK\", \"requestId\": 2, \"mediaSessionId\": %d, \"currentTime\": %f}", mediaSessionId, seekTo);
-  return applicationConnection.writeMsg(CC_NS_MEDIA, cc_msg_ctrl);
+  snprintf(cmd->payload, sizeof(cmd->payload), CC_MSG_SEEK, (unsigned long)cmd->requestId, mediaSessionId, seekTo);
+  return queueCommand(cmd, applicationConnection, CC_NS_MEDIA, callback, callbackArg);
 }
 
-int ArduCastControl::setVolume(bool relative, float volumeTo){
-  if ( msgSent )
-    return -10;
+int ArduCastControl::setVolume(bool relative, float volumeTo, commandCallback_t callback, void *callbackArg){
+  if ( !client.connected() )
+    return -1;
+  command_t *cmd = newCommand();
+  if ( cmd == NULL )
+    return -11;
 
   if ( relative )
     volumeTo += volume;
@@ -563,18 +1854,20 @@ int ArduCastControl::setVolume(bool relative, float volumeTo){
   if ( volumeTo > 1 )
     volumeTo = 1;
   
-  snprintf(cc_msg_ctrl, sizeof(cc_msg_ctrl), "%s%f}}", CC_MSG_SET_VOL, volumeTo );
-  return deviceConnection.writeMsg(CC_NS_RECEIVER, cc_msg_ctrl);
+  snprintf(cmd->payload, sizeof(cmd->payload), CC_MSG_SET_VOL, (unsigned long)cmd->requestId, volumeTo);
+  return queueCommand(cmd, deviceConnection, CC_NS_RECEIVER, callback, callbackArg);
 }
 
-int ArduCastControl::setMute(bool newMute, bool toggle){
-  if ( msgSent )
-    return -10;
+int ArduCastControl::setMute(bool newMute, bool toggle, commandCallback_t callback, void *callbackArg){
+  if ( !client.connected() )
+    return -1;
+  command_t *cmd = newCommand();
+  if ( cmd == NULL )
+    return -11;
 
   if ( toggle )
     newMute = !isMuted;
   
-  snprintf(cc_msg_ctrl, sizeof(cc_msg_ctrl), "%s%s}}", CC_MSG_VOL_MUTE, newMute?"true":"false" );
-  return deviceConnection.writeMsg(CC_NS_RECEIVER, cc_msg_ctrl);
-
+  snprintf(cmd->payload, sizeof(cmd->payload), CC_MSG_VOL_MUTE, (unsigned long)cmd->requestId, newMute?"true":"false");
+  return queueCommand(cmd, deviceConnection, CC_NS_RECEIVER, callback, callbackArg);
 }
@@ -4,40 +4,455 @@
  * https://github.com/andrasbiro/chromecastcontrol
  */
 
+#ifndef ARDUCASTCONTROL_H
+#define ARDUCASTCONTROL_H
+
 #include <stdint.h>
+
+/**
+ * Define this to replay a capture instead of connecting to a chromecast,
+ * see \ref ArduCastReplayClient
+ */
+#ifdef ARDUCAST_REPLAY
+#include "ArduCastReplay.h"
+#define ARDUCAST_CLIENT ArduCastReplayClient
+#endif
+
+/**
+ * Set to 1 to keep the TLS session of the connection, and resume it when
+ * reconnecting to the same host. Resumption skips the key exchange of the
+ * handshake, which takes seconds on ESP8266. Only supported with the BearSSL
+ * client of ESP8266, so it's enabled by default there, unless
+ * \ref ARDUCAST_CLIENT is overridden.
+ */
+#ifndef TLS_SESSION_CACHE
+#if defined(ESP8266) && !defined(ARDUCAST_CLIENT)
+#define TLS_SESSION_CACHE 1
+#else
+#define TLS_SESSION_CACHE 0
+#endif
+#endif
+
+/**
+ * The TLS client class used for the connection. It must provide the
+ * WiFiClientSecure interface used by the library (connect, connected,
+ * available, read, write, stop and setInsecure, or allowSelfSignedCerts on
+ * ESP8266). Override it to build the library
+ * against a different TLS stack or a stand-in client, e.g. to run the
+ * protocol code off-device. The header declaring the class must be
+ * included before this file in that case.
+ */
+#ifndef ARDUCAST_CLIENT
 #include <WiFiClientSecure.h>
-#include <ArduinoJson.h>
+#define ARDUCAST_CLIENT WiFiClientSecure
+#endif
+
+typedef ARDUCAST_CLIENT castClient_t;
 
 #include "pb.h"
+#include "ArduCastJson.h"
+#include "ArduCastArena.h"
+#include "ArduCastStringTable.h"
+#include "ArduCastTrace.h"
+#include "ArduCastCapture.h"
 
+/**
+ * Define this to decode the payloads with ArduinoJson (the original
+ * implementation) instead of the allocation free extractor in ArduCastJson.h.
+ */
+#ifdef ARDUCAST_USE_ARDUINOJSON
+#include <ArduinoJson.h>
+#endif
 
 /**
- * Buffer size for JSON deconding used with ArduinoJson's dynamic allocation.
- * Allocated from heap.
+ * Default buffer size for JSON deconding used with ArduinoJson's dynamic
+ * allocation. Allocated from the arena of the instance while a message is
+ * decoded. Only used with \ref ARDUCAST_USE_ARDUINOJSON.
  */
 #ifndef JSONBUFFER_SIZE
 #define JSONBUFFER_SIZE 4096
 #endif
 
 /**
- * Common buffer used for both write and read a single protocolbuffer message.
- * Allocated with the class.
- * Biggest write is about 300B (seek), read can be much bigger. Maximum seems
- * to be about 2k, this is set to 4k for future proofing.
+ * Default size of the buffer used to receive a single protocolbuffer message.
+ * Allocated from the arena of the instance, unless a shared buffer is used
+ * (see \ref ArduCastHub). Can be set for each instance with
+ * \ref castConfig_t.
+ * Maximum message size seems to be about 2k, this is set to 4k for future
+ * proofing.
  */
 #ifndef CONNBUFFER_SIZE
 #define CONNBUFFER_SIZE 4096
 #endif 
 
 /**
- * Timeout for ping. If there was no received message for this amount of time
- * on a given channel, a PING message will be sent.
+ * Default size of the ring buffer of messages waiting to be written to the
+ * TCP channel (see \ref ArduCastTxRing). Allocated from the arena of the
+ * instance, can be set with \ref castConfig_t.
+ * Biggest write is about 250B (seek), a few of them should fit.
+ */
+#ifndef TXBUFFER_SIZE
+#define TXBUFFER_SIZE 512
+#endif
+
+/**
+ * Default size of the string fields (e.g. \ref ArduCastControl::title),
+ * including the terminating zero. Longer strings are truncated.
+ */
+#ifndef STRING_FIELD_SIZE
+#define STRING_FIELD_SIZE 50
+#endif
+
+/**
+ * Size of the namespace table used to dispatch the received messages, must be
+ * a power of 2. Holds one less namespace than its size; the library uses 4,
+ * and each namespace registered with \ref ArduCastControl::onNamespace()
+ * needs one more.
+ */
+#ifndef NAMESPACE_TABLE_SIZE
+#define NAMESPACE_TABLE_SIZE 16
+#endif
+
+/**
+ * Number of handlers which can be registered with
+ * \ref ArduCastControl::onNamespace()
+ */
+#ifndef NAMESPACE_HANDLERS_SIZE
+#define NAMESPACE_HANDLERS_SIZE 4
+#endif
+
+/**
+ * Default TCP port of the chromecast devices. Audio groups use a different
+ * port, which can be found with discovery (see ArduCastDiscovery.h).
+ */
+#ifndef CAST_PORT
+#define CAST_PORT 8009
+#endif
+
+/**
+ * Size of the copy of the host given to \ref ArduCastControl::connect(),
+ * including the terminating zero. Enough for an IP address or a
+ * .local name.
+ */
+#ifndef HOST_NAME_SIZE
+#define HOST_NAME_SIZE 64
+#endif
+
+/**
+ * Default keep-alive of the channels. If there was no received message for
+ * this amount of time on a given channel, a PING message will be sent; after
+ * 3 times this, the channel is considered disconnected. Can be set for each
+ * channel with \ref ArduCastControl::setKeepAlive().
  */
 #ifndef PING_TIMEOUT
 #define PING_TIMEOUT 5000
 #endif
 
+/**
+ * Time to wait for the response of a GET_STATUS or PING message. If nothing
+ * arrives, the message is retried, and the connection is dropped after 5
+ * consecutive failures on the same channel.
+ */
+#ifndef RESPONSE_TIMEOUT
+#define RESPONSE_TIMEOUT 500
+#endif
+
+/**
+ * Timeout for a partially received message. If a message started to arrive,
+ * but no new bytes were received for this amount of time, the TCP channel
+ * is purged and the partial message is dropped.
+ */
+#ifndef RX_TIMEOUT
+#define RX_TIMEOUT 1000
+#endif
+
+/**
+ * Poll interval of an instance which has data waiting, while another
+ * instance is receiving to the shared buffer (see \ref ArduCastHub). The
+ * data can only be read once the buffer is released.
+ */
+#ifndef SHARED_RX_POLL_INTERVAL
+#define SHARED_RX_POLL_INTERVAL 10
+#endif
+
+/**
+ * Maximum length of a single chromecast message (the CASTV2 protocol limits
+ * it to 64k). A bigger length field means the stream is out of sync, so it
+ * is purged instead of trying to download the message.
+ */
+#ifndef MAX_MESSAGE_SIZE
+#define MAX_MESSAGE_SIZE 65536
+#endif
+
+/**
+ * Default back-off of the automatic reconnection, see
+ * \ref ArduCastControl::setAutoReconnect(). The first attempt is made right
+ * away, then the back-off doubles with each failed attempt, from the minimum
+ * up to the maximum.
+ */
+#ifndef RECONNECT_MIN_BACKOFF
+#define RECONNECT_MIN_BACKOFF 500
+#endif
+
+#ifndef RECONNECT_MAX_BACKOFF
+#define RECONNECT_MAX_BACKOFF 60000
+#endif
+
+/**
+ * Default interval of status polling in push mode, see
+ * \ref ArduCastControl::setPushMode(). If no status was pushed by chromecast
+ * for this amount of time, GET_STATUS is sent.
+ */
+#ifndef STATUS_FALLBACK_INTERVAL
+#define STATUS_FALLBACK_INTERVAL 30000
+#endif
+
+/**
+ * Number of callbacks which can be registered with
+ * \ref ArduCastControl::onChange()
+ */
+#ifndef CHANGE_CALLBACKS_SIZE
+#define CHANGE_CALLBACKS_SIZE 4
+#endif
+
+/**
+ * Number of control commands (e.g. play or setVolume) that can be queued or
+ * waiting for a response at the same time.
+ */
+#ifndef COMMAND_QUEUE_SIZE
+#define COMMAND_QUEUE_SIZE 4
+#endif
+
+/**
+ * Buffer size for the payload of a single control command.
+ * Biggest is seek, which is about 100B.
+ */
+#ifndef COMMAND_PAYLOAD_SIZE
+#define COMMAND_PAYLOAD_SIZE 128
+#endif
+
+/**
+ * Timeout for the response of a control command. If no response with the
+ * command's requestId arrives in this time, the command fails.
+ */
+#ifndef COMMAND_TIMEOUT
+#define COMMAND_TIMEOUT 3000
+#endif
+
+/**
+ * Number of buckets of the histograms in \ref castMetrics_t. Bucket 0 counts
+ * the value 0, bucket i the values from 2^(i-1) to 2^i-1, the last bucket
+ * everything above.
+ */
+#ifndef METRICS_HISTOGRAM_SIZE
+#define METRICS_HISTOGRAM_SIZE 16
+#endif
+
+/**
+ * Number of encoded message prefixes (everything before the payload type) cached
+ * by each \ref ArduCastConnection, one for each namespace used on the
+ * channel. A channel typically uses 3 namespaces (connection, heartbeat and
+ * receiver or media). Set to 0 to disable caching.
+ */
+#ifndef MSG_PREFIX_CACHE
+#define MSG_PREFIX_CACHE 3
+#endif
+
+/**
+ * Buffer size of a single cached message prefix. Fits the longest destination
+ * ID with the standard namespaces; prefixes which don't fit are encoded for
+ * every message.
+ */
+#ifndef MSG_PREFIX_SIZE
+#define MSG_PREFIX_SIZE 112
+#endif
+
+/**
+ * Buffer size of the fully encoded PING and GET_STATUS messages kept by
+ * each \ref ArduCastConnection: the length field, the prefix and the payload.
+ */
+#define FIXED_FRAME_SIZE (4 + MSG_PREFIX_SIZE + 48)
+
+
+
+/**
+ * Ring buffer of encoded messages waiting to be written to the TCP channel.
+ * Messages are reserved as a single continuous block, so they can be encoded
+ * in place; if there's no room at the end of the buffer, the message wraps
+ * to the beginning as a whole.
+ * 
+ * Separate from the receive buffer, so messages can be written any time,
+ * even while a message is partially received. What the TCP channel doesn't
+ * accept right away stays in the ring and is written by \ref flush() later.
+ */
+class ArduCastTxRing {
+  private:
+    castClient_t &client;
+    uint8_t *const buffer;
+    const uint32_t size;
+    uint32_t head = 0;      ///< Next free byte
+    uint32_t tail = 0;      ///< Next byte to write to the TCP channel
+    uint32_t wrapAt = 0;    ///< End of the data before the wrap, if wrapped
+    uint32_t reserved = 0;  ///< Start of the block returned by reserve()
+    bool wrapped = false;   ///< True if data continues at the beginning of the buffer
+    uint32_t highWater = 0;
+    ArduCastCapture *capture = NULL;
+
+  public:
+    /**
+     * Constructor
+     * \param[in] _client
+     *    Reference of the TCP client to write to
+     * \param[in] _buffer
+     *    Buffer of the ring
+     * \param[in] _size
+     *    Size of \ref _buffer
+     */
+    ArduCastTxRing(castClient_t &_client, uint8_t *_buffer, uint32_t _size)
+      : client(_client), buffer(_buffer), size(_buffer != NULL ? _size : 0)
+      {};
+
+    /**
+     * Reserves a continuous block for a message. The message should be
+     * written to the block, then added to the ring with \ref commit().
+     * \return
+     *    The block or NULL if there's no room for \ref len bytes
+     */
+    uint8_t* reserve(uint32_t len);
+
+    /**
+     * Adds the message written to the block returned by the last
+     * \ref reserve() to the ring.
+     */
+    void commit(uint32_t len);
+
+    /**
+     * Writes as much of the ring to the TCP channel as it accepts
+     */
+    void flush();
+
+    /**
+     * Drops everything from the ring, e.g. when the TCP channel is closed
+     */
+    void clear();
+
+    /**
+     * Returns the number of bytes waiting to be written
+     */
+    uint32_t pending();
+
+    /**
+     * Returns the size of the ring
+     */
+    uint32_t getSize();
+
+    /**
+     * Returns the most bytes ever waiting in the ring
+     */
+    uint32_t getHighWater();
+
+    /**
+     * Sets where the committed messages are recorded, NULL to stop
+     */
+    void setCapture(ArduCastCapture *_capture);
+};
+
+/**
+ * IDs of the message sources in the dispatch table of \ref ArduCastControl
+ */
+typedef enum castSource_t {
+  SRC_DEVICE = 1,           ///< The device itself (receiver-0)
+  SRC_APPLICATION = 2,      ///< The application running on the device
+} castSource_t;
+
+/**
+ * IDs of the namespaces in the dispatch table of \ref ArduCastControl
+ */
+typedef enum castNamespace_t {
+  NS_CONNECTION = 1,
+  NS_HEARTBEAT,
+  NS_RECEIVER,
+  NS_MEDIA,
+  NS_CUSTOM,                ///< First ID of the namespaces registered with \ref ArduCastControl::onNamespace()
+} castNamespace_t;
+
+/**
+ * Namespaces used by the library
+ */
+extern const char CC_NS_CONNECTION[];
+extern const char CC_NS_RECEIVER[];
+extern const char CC_NS_HEARTBEAT[];
+extern const char CC_NS_MEDIA[];
+
+/**
+ * Number of namespaces counted separately by \ref castMetrics_t: the ones
+ * used by the library and the ones registered with
+ * \ref ArduCastControl::onNamespace(). Index 0 counts any other namespace.
+ */
+#define METRICS_NAMESPACES (NS_CUSTOM + NAMESPACE_HANDLERS_SIZE)
+
+/**
+ * Traffic of a namespace, see \ref castMetrics_t
+ */
+typedef struct nsMetrics_t {
+  uint32_t framesIn;
+  uint32_t bytesIn;         ///< Including the length field, only the part which fit in the buffer for truncated frames
+  uint32_t framesOut;
+  uint32_t bytesOut;        ///< Including the length field
+} nsMetrics_t;
+
+/**
+ * Histogram with logarithmic buckets, see \ref METRICS_HISTOGRAM_SIZE
+ */
+typedef struct castHistogram_t {
+  uint32_t count[METRICS_HISTOGRAM_SIZE];
+  uint32_t max;             ///< Largest value added
+} castHistogram_t;
+
+/**
+ * Protocol level counters of an \ref ArduCastControl instance, see
+ * \ref ArduCastControl::getMetrics(). Updating them costs a few additions
+ * per frame, so they are always enabled.
+ */
+typedef struct castMetrics_t {
+  nsMetrics_t ns[METRICS_NAMESPACES];   ///< Indexed by \ref castNamespace_t, 0 for unknown namespaces
+  uint32_t framesTruncated;   ///< Frames bigger than the receive buffer, processed truncated
+  uint32_t bytesDropped;      ///< Bytes of the truncated frames which didn't fit in the buffer
+  uint32_t framesDropped;     ///< Frames dropped, because their length was over \ref MAX_MESSAGE_SIZE (the rest of the stream is dropped too)
+  uint32_t framesMalformed;   ///< Frames dropped, because they couldn't be decoded as a CastMessage
+  uint32_t rxTimeouts;        ///< Partially received frames dropped after \ref RX_TIMEOUT
+  uint32_t parseErrors;       ///< Status payloads which couldn't be parsed as JSON
+  uint32_t responseTimeouts;  ///< GET_STATUS/PING without a response in \ref RESPONSE_TIMEOUT
+  uint32_t commandTimeouts;   ///< Commands failed with -12
+  uint32_t connects;          ///< Successful connections; all but the first are reconnections
+  uint32_t connectFailures;   ///< Failed connection attempts
+  uint32_t connectTime;       ///< Duration of the last successful TCP/TLS connection in ms
+  castHistogram_t latency;    ///< Time from a request to its response in ms
+  castHistogram_t parseTime;  ///< Time to process a received frame in us, including the namespace handlers
+} castMetrics_t;
+
+/**
+ * Number of fields of CastMessage, indexed by their tag (0 is unused)
+ */
+#define CAST_MSG_FIELDS 8
+
+/**
+ * A field of a received CastMessage, see \ref castMsgIndex_t
+ */
+typedef struct castField_t {
+  uint32_t offset;          ///< Offset of the data of a length-delimited field
+  uint32_t len;             ///< Length of a length-delimited field, or the value of a varint (low 32 bits)
+} castField_t;
 
+/**
+ * Fields of a received CastMessage, see
+ * \ref ArduCastControl::pbIndexMessage()
+ */
+typedef struct castMsgIndex_t {
+  uint8_t found;            ///< Bit (1 << tag) is set for the fields in the message
+  uint8_t truncated;        ///< Bit (1 << tag) is set for the field cut by the end of a truncated message
+  castField_t fields[CAST_MSG_FIELDS];  ///< Indexed by the tag, valid if the bit is set in \ref found
+} castMsgIndex_t;
 
 /**
  * Possible connection status for \ref ArduCastConnection
@@ -48,6 +463,17 @@ typedef enum channelConnection_t{
   CH_CONNECTED,           ///< Connected. Both TCP and application layer.
 }channelConnection_t;
 
+/**
+ * Encoded CastMessage fields up to the payload type for a given destination
+ * and namespace, see \ref ArduCastConnection::encodeMsg()
+ */
+typedef struct msgPrefix_t {
+  uint8_t len;                    ///< Length of \ref data, 0 if unused
+  uint8_t nsOffset;               ///< Offset of the namespace in \ref data
+  uint8_t nsLen;                  ///< Length of the namespace
+  uint8_t data[MSG_PREFIX_SIZE];
+} msgPrefix_t;
+
 /**
  * Class to maintain a chromecast connection channel. A typicial application
  * needs two:
@@ -63,20 +489,78 @@ typedef enum channelConnection_t{
  */
 class ArduCastConnection {
   private:
-    WiFiClientSecure& client;
-    const int keepAlive;
-    uint8_t *const writeBuffer;
-    const int writeBufferSize;
+    castClient_t& client;
+    uint32_t keepAlive;
+    ArduCastTxRing &tx;
     
     channelConnection_t connectionStatus = CH_DISCONNECTED;
-    char destId[50];
+    char destId[50] = "";
     unsigned long lastMsgAt = 0;
     bool connected = false;
+    const char *const statusNameSpace;
+    //PING and GET_STATUS, encoded when the destination is set, 0 length if didn't fit
+    uint8_t pingFrame[FIXED_FRAME_SIZE];
+    uint16_t pingFrameLen = 0;
+    uint8_t statusFrame[FIXED_FRAME_SIZE];
+    uint16_t statusFrameLen = 0;
+#if MSG_PREFIX_CACHE > 0
+    msgPrefix_t prefixes[MSG_PREFIX_CACHE] = {};
+    uint8_t nextPrefix = 0;
+#endif
+    castMetrics_t *metrics = NULL;
+    ArduCastStringTable *namespaces = NULL;
 
     /**
      * Encoder function required for protocol buffer encoding
      */
     static bool encode_string(pb_ostream_t *stream, const pb_field_iter_t *field, void * const *arg);
+
+    /**
+     * Encodes the CastMessage fields before the payload type
+     * (protocol_version, source_id, destination_id and namespace).
+     * \return
+     *    Length of the prefix, or -1 if it doesn't fit in \ref bufSize
+     */
+    int encodePrefix(uint8_t *buffer, uint32_t bufSize, const char* nameSpace, uint8_t *nsOffset);
+
+    /**
+     * Looks up the cached prefix of \ref nameSpace, encoding it to the cache
+     * if needed.
+     * \return
+     *    The cached prefix or NULL if it doesn't fit in the cache
+     */
+    const msgPrefix_t* getPrefix(const char* nameSpace);
+
+    /**
+     * Adds an already encoded message (including the length field) to the
+     * TX ring and writes it to the TCP channel.
+     * \param[in] nameSpace
+     *    Namespace of the message, for \ref metrics
+     * \return 
+     *    Same as \ref writeMsg()
+     */
+    int writeFrame(const uint8_t *frame, uint32_t len, const char* nameSpace);
+
+    /**
+     * Counts a message written on \ref nameSpace in \ref metrics
+     */
+    void countOut(const char* nameSpace, uint32_t len);
+
+    /**
+     * Encodes a message with the given payload type
+     * (extensions_api_cast_channel_CastMessage_PayloadType), the payload
+     * is written to payload_utf8 or payload_binary accordingly.
+     * \return
+     *    Same as \ref encodeMsg()
+     */
+    int encode(uint8_t *buffer, uint32_t bufSize, const char* nameSpace, const uint8_t* payload, uint32_t payloadLen, uint8_t payloadType);
+
+    /**
+     * Writes a message with the given payload type, see \ref encode()
+     * \return
+     *    Same as \ref writeMsg()
+     */
+    int write(const char* nameSpace, const uint8_t* payload, uint32_t payloadLen, uint8_t payloadType);
   public:
     /**
      * Constructor
@@ -84,14 +568,15 @@ class ArduCastConnection {
      *    Reference of already connected secure TCP client. Shared between
      *    multiple classes
      * \param[in] _keepAlive
-     *    Timeout ater CH_NEEDS_PING is set
-     * \param[in] _writeBuffer
-     *    Buffer to use by \ref writeMsg(). Shared between multiple classes
-     * \param[in] _writeBufferSize
-     *    Size of \ref _writeBuffer
-     */
-    ArduCastConnection(WiFiClientSecure &_client, int _keepAlive, uint8_t *_writeBuffer, int _writeBufferSize)
-      : client(_client), keepAlive(_keepAlive), writeBuffer(_writeBuffer), writeBufferSize(_writeBufferSize)
+     *    Timeout ater CH_NEEDS_PING is set, see \ref setKeepAlive()
+     * \param[in] _tx
+     *    TX ring used by \ref writeMsg(). Shared between multiple classes
+     * \param[in] _statusNameSpace
+     *    Namespace of GET_STATUS sent by \ref writeGetStatus(), e.g.
+     *    urn:x-cast:com.google.cast.media. NULL if not used.
+     */
+    ArduCastConnection(castClient_t &_client, uint32_t _keepAlive, ArduCastTxRing &_tx, const char *_statusNameSpace = NULL)
+      : client(_client), keepAlive(_keepAlive), tx(_tx), statusNameSpace(_statusNameSpace)
       {};
     
     /**
@@ -102,10 +587,20 @@ class ArduCastConnection {
      *    subsecvent \ref writeMsg() as destination.
      * \return 
      *    0 on success, -1 if TCP channel is not open, -2 if protobuf encoding
-     *    failed, -3 if TCP channel didn't accept the whole message
+     *    failed, -3 if there's no room in the TX ring
      */
     int connect(const char* destinationId);
 
+    /**
+     * Sets where the written messages are counted
+     * \param[in] _metrics
+     *    Metrics to update, NULL to disable counting
+     * \param[in] _namespaces
+     *    Table mapping the namespaces to their index in
+     *    \ref castMetrics_t::ns
+     */
+    void setMetrics(castMetrics_t *_metrics, ArduCastStringTable *_namespaces);
+
     /**
      * Resets \ref CH_NEEDS_PING status. Should be called if a message is
      * received on this channel.
@@ -125,6 +620,26 @@ class ArduCastConnection {
      */
     channelConnection_t getConnectionStatus();
 
+    /**
+     * Sets the keep-alive of the channel: a PING is needed if nothing was
+     * received for this amount of time, and the channel is disconnected
+     * after 3 times this. Can be changed any time.
+     * \param[in] ms
+     *    The keep-alive in ms, must not be 0
+     */
+    void setKeepAlive(uint32_t ms);
+
+    /**
+     * Returns the keep-alive of the channel, see \ref setKeepAlive()
+     */
+    uint32_t getKeepAlive();
+
+    /**
+     * Returns the time (as \ref millis()) when the channel will need a PING,
+     * unless something is received before. Only valid while connected.
+     */
+    unsigned long getPingDeadline();
+
     /**
      * Returns the destination ID of this channel
      * \return
@@ -133,16 +648,102 @@ class ArduCastConnection {
     const char* getDestinationId();
 
     /**
-     * Writes a message to this channel, to the stored destination ID
+     * Returns the length of a message to the stored destination ID, as
+     * encoded by \ref encodeMsg() or \ref encodeBinaryMsg().
+     * \return
+     *    Length of the message including the 4 byte length field, or -2 if
+     *    the message is longer than \ref MAX_MESSAGE_SIZE
+     */
+    int getMsgLength(const char* nameSpace, const char* payload);
+
+    /**
+     * Same as \ref getMsgLength(), with a payload of \ref payloadLen bytes.
+     */
+    int getMsgLength(const char* nameSpace, uint32_t payloadLen);
+
+    /**
+     * Encodes a message to \ref buffer, to the stored destination ID,
+     * without writing it to the TCP channel. Used by \ref writeMsg().
+     * 
+     * The fields are written directly, without nanopb. Everything before the
+     * payload only depends on the destination and the namespace, so it is
+     * cached (see \ref MSG_PREFIX_CACHE).
+     * \param[out] buffer
+     *    The buffer to encode to
+     * \param[in] bufSize
+     *    Size of \ref buffer
+     * \param[in] nameSpace
+     *    The namespace to write, e.g. urn:x-cast:com.google.cast.receiver
+     * \param[in] payload
+     *    The payload to write
+     * \return
+     *    Length of the encoded message in the buffer, including the 4 byte
+     *    length field, or -2 if the message doesn't fit in the buffer
+     */
+    int encodeMsg(uint8_t *buffer, uint32_t bufSize, const char* nameSpace, const char* payload);
+
+    /**
+     * Same as \ref encodeMsg(), with a payload of \ref payloadLen bytes,
+     * which doesn't need to be terminated.
+     */
+    int encodeMsg(uint8_t *buffer, uint32_t bufSize, const char* nameSpace, const char* payload, uint32_t payloadLen);
+
+    /**
+     * Same as \ref encodeMsg(), but the payload is written to the
+     * payload_binary field, with payload_type BINARY.
+     */
+    int encodeBinaryMsg(uint8_t *buffer, uint32_t bufSize, const char* nameSpace, const uint8_t* payload, uint32_t payloadLen);
+
+    /**
+     * Same as \ref encodeMsg(), but using nanopb's generic encoder. The
+     * output is the same byte by byte; this is kept as a reference.
+     */
+    int encodeMsgPb(uint8_t *buffer, uint32_t bufSize, const char* nameSpace, const char* payload);
+
+    /**
+     * Writes a message to this channel, to the stored destination ID.
+     * The message is encoded to the TX ring, and written to the TCP channel
+     * as far as it accepts it; the rest is written by
+     * \ref ArduCastTxRing::flush() later.
      * \param[in] nameSpace
      *    The namespace to write, e.g. urn:x-cast:com.google.cast.receiver
      * \param[in] payload
      *    The payload to write
      * \return 
      *    0 on success, -1 if TCP channel is not open, -2 if protobuf encoding
-     *    failed, -3 if TCP channel didn't accept the whole message
+     *    failed or the message is bigger than the TX ring, -3 if there's no
+     *    room in the TX ring (try again later)
      */
     int writeMsg(const char* nameSpace, const char* payload);
+
+    /**
+     * Same as \ref writeMsg(), with a payload of \ref payloadLen bytes,
+     * which doesn't need to be terminated, e.g. a part of a received message.
+     */
+    int writeMsg(const char* nameSpace, const char* payload, uint32_t payloadLen);
+
+    /**
+     * Same as \ref writeMsg(), but the payload is written to the
+     * payload_binary field, with payload_type BINARY.
+     */
+    int writeBinaryMsg(const char* nameSpace, const uint8_t* payload, uint32_t payloadLen);
+
+    /**
+     * Writes a PING message to this channel. The message is encoded once by
+     * \ref connect(), so this is a single copy to the TX ring.
+     * \return 
+     *    Same as \ref writeMsg()
+     */
+    int writePing();
+
+    /**
+     * Writes a GET_STATUS message (with requestId 1) to this channel, to the
+     * namespace given in the constructor. The message is encoded once by
+     * \ref connect(), so this is a single copy to the TX ring.
+     * \return 
+     *    Same as \ref writeMsg()
+     */
+    int writeGetStatus();
 };
 
 
@@ -169,6 +770,161 @@ typedef enum playerState_t{
   BUFFERING,                ///< Player is in PLAY mode but not actively playing content. currentTime will not change.
 } playerState_t;
 
+/**
+ * Callback called when a control command is finished.
+ * \param[in] requestId
+ *    The requestId of the command
+ * \param[in] result
+ *    0 if the response arrived, -1 if the TCP channel was closed,
+ *    -2 if protobuf encoding failed, -12 if the response didn't arrive in
+ *    \ref COMMAND_TIMEOUT, -13 if chromecast responded with an error
+ *    (e.g. INVALID_REQUEST)
+ * \param[in] arg
+ *    The argument given when the command was issued
+ */
+typedef void (*commandCallback_t)(uint32_t requestId, int result, void *arg);
+
+/**
+ * Possible states of a \ref command_t slot
+ */
+typedef enum commandState_t{
+  CMD_FREE,                 ///< Slot is not used
+  CMD_QUEUED,               ///< Command is waiting to be written to the TCP channel
+  CMD_PENDING,              ///< Command is written, waiting for the response
+} commandState_t;
+
+/**
+ * A control command in the command queue of \ref ArduCastControl.
+ */
+typedef struct command_t{
+  commandState_t state;
+  uint32_t requestId;
+  ArduCastConnection *connection;
+  const char *nameSpace;
+  unsigned long sentAt;
+  commandCallback_t callback;
+  void *callbackArg;
+  char payload[COMMAND_PAYLOAD_SIZE];
+} command_t;
+
+/**
+ * Counters of status messages, see \ref ArduCastControl::setPushMode()
+ */
+typedef struct pushStats_t{
+  uint32_t pollsSent;       ///< GET_STATUS messages sent
+  uint32_t pollsAvoided;    ///< GET_STATUS messages not sent because a recent status was pushed, at most one per channel and \ref RESPONSE_TIMEOUT
+  uint32_t statusPushed;    ///< Unsolicited status messages received (requestId 0)
+  uint32_t statusPolled;    ///< Status messages received as a response
+} pushStats_t;
+
+/**
+ * A GET_STATUS or PING waiting for its response on a channel
+ */
+typedef struct channelRequest_t{
+  unsigned long sentAt;     ///< Time when it was written
+  bool pending;             ///< True until a message arrives on the channel, or \ref RESPONSE_TIMEOUT
+  uint8_t errorCount;       ///< Timeouts left before the connection is dropped, reset by any message on the channel
+} channelRequest_t;
+
+/**
+ * Groups of status fields, used as bits of the dirty mask, see
+ * \ref ArduCastControl::getDirty() and \ref ArduCastControl::onChange()
+ */
+typedef enum statusField_t{
+  SF_VOLUME       = 1 << 0,   ///< \ref ArduCastControl::volume
+  SF_MUTED        = 1 << 1,   ///< \ref ArduCastControl::isMuted
+  SF_APPLICATION  = 1 << 2,   ///< \ref ArduCastControl::displayName and \ref ArduCastControl::statusText
+  SF_PLAYER_STATE = 1 << 3,   ///< \ref ArduCastControl::playerState
+  SF_CURRENT_TIME = 1 << 4,   ///< \ref ArduCastControl::currentTime
+  SF_MEDIA        = 1 << 5,   ///< \ref ArduCastControl::title, \ref ArduCastControl::artist and \ref ArduCastControl::duration
+  SF_PLAYBACK_RATE = 1 << 6,  ///< \ref ArduCastControl::playbackRate
+  SF_ALL          = 0xFFFF,
+} statusField_t;
+
+class ArduCastControl;
+
+/**
+ * Callback called from \ref ArduCastControl::loop() when status fields
+ * changed.
+ * \param[in] cc
+ *    The instance where the fields changed
+ * \param[in] changed
+ *    Bitmask of \ref statusField_t which changed, only the ones the callback
+ *    was registered for
+ * \param[in] arg
+ *    The argument given at registration
+ */
+typedef void (*changeCallback_t)(ArduCastControl &cc, uint16_t changed, void *arg);
+
+/**
+ * Callback called from \ref ArduCastControl::loop() when a message arrives
+ * on a namespace registered with \ref ArduCastControl::onNamespace() or
+ * \ref ArduCastControl::onBinaryNamespace().
+ * \param[in] cc
+ *    The instance which received the message
+ * \param[in] source
+ *    \ref castSource_t of the sender, 0 if it's neither the device nor the
+ *    connected application
+ * \param[in] nameSpace
+ *    The namespace, as registered
+ * \param[in] payload
+ *    The payload_utf8 or payload_binary field of the message. Points directly
+ *    into the receive buffer: it's not terminated, and only valid during the
+ *    call.
+ * \param[in] len
+ *    Length of \ref payload
+ * \param[in] arg
+ *    The argument given at registration
+ */
+typedef void (*namespaceHandler_t)(ArduCastControl &cc, uint8_t source, const char *nameSpace, const uint8_t *payload, uint32_t len, void *arg);
+
+/**
+ * Memory configuration of an \ref ArduCastControl instance. Everything is
+ * allocated from a single arena sized at construction.
+ */
+typedef struct castConfig_t {
+  uint32_t bufferSize;      ///< Size of the receive buffer, ignored if a shared buffer is used
+  uint32_t txBufferSize;    ///< Size of the TX ring
+  uint32_t jsonBufferSize;  ///< Size of the JSON workspace, only used with \ref ARDUCAST_USE_ARDUINOJSON
+  uint8_t stringSize;       ///< Size of each string field, including the terminating zero
+} castConfig_t;
+
+/**
+ * The default configuration, using \ref CONNBUFFER_SIZE, \ref TXBUFFER_SIZE,
+ * \ref JSONBUFFER_SIZE and \ref STRING_FIELD_SIZE
+ */
+extern const castConfig_t CC_DEFAULT_CONFIG;
+
+/**
+ * Memory use of an \ref ArduCastControl instance, see
+ * \ref ArduCastControl::getMemoryStats()
+ */
+typedef struct castMemoryStats_t {
+  uint32_t arenaSize;       ///< Size of the arena
+  uint32_t arenaHighWater;  ///< Most of the arena ever used
+  uint32_t bufferSize;      ///< Size of the receive buffer (own or shared)
+  uint32_t txBufferSize;    ///< Size of the TX ring
+  uint32_t txHighWater;     ///< Most bytes ever waiting in the TX ring
+  uint32_t largestMessage;  ///< Largest message received, including the length field. Messages bigger than \ref bufferSize were truncated
+  uint32_t jsonHighWater;   ///< Most of the JSON workspace ever used, 0 without \ref ARDUCAST_USE_ARDUINOJSON
+} castMemoryStats_t;
+
+/**
+ * Receive buffer which can be shared by multiple \ref ArduCastControl
+ * instances, see \ref ArduCastHub. A partially received message is kept in
+ * the buffer, so while an instance is receiving, the others can't receive.
+ *
+ * The JSON workspace can be shared too, as a status is decoded and applied
+ * within a single \ref ArduCastControl::loop().
+ */
+typedef struct sharedBuffer_t {
+  uint8_t *buffer;
+  uint32_t size;
+  ArduCastControl *owner;   ///< The instance receiving to the buffer, NULL if free
+  ArduCastArena *jsonArena; ///< Arena of the shared JSON workspace, NULL if the instances have their own. Only used with \ref ARDUCAST_USE_ARDUINOJSON
+  uint32_t jsonSize;        ///< Size of the shared JSON workspace
+} sharedBuffer_t;
+
 /**
  * Main class. This class can be used to connect to a chromecast device,
  * poll information from it, like what is currently cast to it and control
@@ -176,31 +932,134 @@ typedef enum playerState_t{
  */
 class ArduCastControl {
 private:
-  uint8_t connBuffer[CONNBUFFER_SIZE];
+  /**
+   * Memory of the instance: the receive buffer and the JSON workspace
+   * (unless shared), the TX ring and the string fields
+   */
+  ArduCastArena arena;
+
+  /**
+   * Used as \ref shared if the instance has its own buffer
+   */
+  sharedBuffer_t ownBuffer = {};
+
+  /**
+   * The buffer used for receiving messages
+   */
+  sharedBuffer_t *const shared;
+  uint8_t *const connBuffer;
+  const uint32_t connBufferSize;
+  const uint32_t jsonBufferSize;
+
+  /**
+   * Size of the string fields, 0 if they couldn't be allocated
+   */
+  uint8_t stringSize = 0;
+  uint32_t largestMessage = 0;
+  uint32_t jsonHighWater = 0;
+
+  /**
+   * Size of the arena needed for \ref config
+   * \param[in] withBuffer
+   *    True if the receive buffer is allocated from the arena
+   * \param[in] withJson
+   *    True if the JSON workspace is allocated from the arena
+   */
+  static uint32_t arenaSize(const castConfig_t &config, bool withBuffer, bool withJson);
+
+  /**
+   * Allocates the string fields from the arena
+   */
+  void initStrings(uint8_t size);
+
+  connection_t connectionStatus = DISCONNECTED;
+  char sessionId[50] = "";
+  int32_t mediaSessionId = 0;
+  castClient_t client;
+
+  /**
+   * Capture of the traffic, see \ref setCapture()
+   */
+  ArduCastCapture *capture = NULL;
+
+  /**
+   * Host given to the last \ref connect(), used for reconnection. Empty if
+   * \ref connect() wasn't called yet.
+   */
+  char host[HOST_NAME_SIZE] = "";
+  uint16_t port = CAST_PORT;
+  bool autoReconnect = false;
+  uint32_t minBackoff = RECONNECT_MIN_BACKOFF;
+  uint32_t maxBackoff = RECONNECT_MAX_BACKOFF;
+
+  /**
+   * Back-off after the next failed connection attempt
+   */
+  uint32_t backoff = RECONNECT_MIN_BACKOFF;
+
+  /**
+   * Time of the next automatic connection attempt
+   */
+  unsigned long reconnectAt = 0;
 
-  connection_t connectionStatus = DISCONNECTED;
-  char sessionId[50];
-  int32_t mediaSessionId;
-  WiFiClientSecure client;
-  uint8_t errorCount = 5;
+  /**
+   * Protocol counters, see \ref getMetrics()
+   */
+  castMetrics_t metrics = {};
+
+#if TLS_SESSION_CACHE
+  /**
+   * TLS session of \ref host and \ref port (compared as strings, not by
+   * the pointer given to \ref connect()), resumed by the next connection to
+   * it, and dropped when connecting to another device
+   */
+  BearSSL::Session tlsSession;
+#endif
+
+  /**
+   * Messages waiting to be written to \ref client, from both channels
+   */
+  ArduCastTxRing txRing;
 
   //IPAddress ccAddress = IPAddress(192, 168, 1, 12);//FIXME 
 
+  /**
+   * Dispatch tables of the received messages, mapping the source ID to
+   * \ref castSource_t and the namespace to \ref castNamespace_t
+   */
+  stringTableEntry_t sourceEntries[4];
+  ArduCastStringTable sources = ArduCastStringTable(sourceEntries, 4);
+  stringTableEntry_t namespaceEntries[NAMESPACE_TABLE_SIZE];
+  ArduCastStringTable namespaces = ArduCastStringTable(namespaceEntries, NAMESPACE_TABLE_SIZE);
+
+  /**
+   * Adds the namespaces used by the library to \ref namespaces
+   */
+  void initNamespaces();
+
   /**
    * Channel connection to the chromecast device itself (receiver-0)
    */
-  ArduCastConnection deviceConnection = ArduCastConnection(client, PING_TIMEOUT, connBuffer, CONNBUFFER_SIZE);
+  ArduCastConnection deviceConnection = ArduCastConnection(client, PING_TIMEOUT, txRing, CC_NS_RECEIVER);
 
   /**
    * Channel connection to the application running on chromecast, if any.
    */
-  ArduCastConnection applicationConnection = ArduCastConnection(client, PING_TIMEOUT, connBuffer, CONNBUFFER_SIZE);
+  ArduCastConnection applicationConnection = ArduCastConnection(client, PING_TIMEOUT, txRing, CC_NS_MEDIA);
 
   /**
    * Downloads a message from the TCP channel. Chromecast messages start with
    * the length coded in 4 bytes, this function will download based on that.
    * The length field will be included in the downloaded message.
    * 
+   * The function never waits for data: it reads whatever is available and
+   * keeps the state of the partially downloaded message (\ref rxExpected,
+   * \ref rxReceived, \ref rxDump) in the class, so the download continues
+   * on the next call. The partial message is kept in \ref buffer, so it
+   * must not be touched until the message is complete.
+   * If the message doesn't fit in the buffer, the beginning of it is kept
+   * and the rest is dropped as it arrives.
+   * 
    * \param[out] buffer
    *    The buffer where the message will be written
    * \param[in] bufSize
@@ -208,25 +1067,52 @@ private:
    * \param[in] client
    *    Reference to the client which should be a connected secure TCP client
    * \param[in] timeout
-   *    Timeout in ms. If a message can't be downloaded in this time, the
-   *    client will be purged for remaining data and the function returns.
+   *    Timeout in ms. If a partial message doesn't progress for this amount
+   *    of time, the client will be purged for remaining data and the partial
+   *    message is dropped.
    * \return 
-   *    The amount of data read in bytes. 0 on timeout or if there's no data
-   *    to read.
+   *    The length of the downloaded message in bytes, when a message is
+   *    complete. 0 if the message is not yet complete, on timeout or if
+   *    there's no data to read.
    */
-  uint32_t getRawMessage(uint8_t *buffer, uint16_t bufSize, WiFiClientSecure &client, uint32_t timeout);
+  uint32_t getRawMessage(uint8_t *buffer, uint32_t bufSize, castClient_t &client, uint32_t timeout);
 
   /**
-   * Helper function for \ref getRawMessage() to decode the length field of the
-   * message. Does not read from the channel, it uses peek() functions.
+   * Drops all data available on the TCP channel and resets the state of the
+   * partially downloaded message.
    * 
    * \param[in] client
-   *    Reference to the client which should be a connected secure TCP client,
-   *    with at least 4 bytes available to read.
-   * \return
-   *    The length of the message on \ref client.
+   *    Reference to the client which should be a connected secure TCP client
+   */
+  void purgeRawMessage(castClient_t &client);
+
+  /**
+   * Returns true if a message is partially downloaded to \ref connBuffer
+   * by this instance.
+   */
+  bool rxInProgress();
+
+
+  /**
+   * Length of the message being downloaded, including the length field.
+   * 0 if the length field is not yet downloaded.
+   */
+  uint32_t rxExpected = 0;
+
+  /**
+   * Number of bytes of the current message already in the buffer.
+   */
+  uint32_t rxReceived = 0;
+
+  /**
+   * Number of bytes still to be dropped from an oversized message.
+   */
+  uint32_t rxDump = 0;
+
+  /**
+   * Time of the last progress on the current message, used for timeout.
    */
-  uint32_t getIncomingMessageLength(WiFiClientSecure &client);
+  unsigned long rxLastAt = 0;
 
   /**
    * Debug function. Prints a protocol buffer message similarly how python
@@ -240,39 +1126,274 @@ private:
    */
   void printRawMsg(int64_t len, uint8_t *buffer);
 
-  uint8_t pbDecodeVarint(uint8_t *bufferStart, uint32_t *decodedInt);
 
   /**
-   * This is a very limited protobuf decoder, especially designed for
-   * chromecast's cast_channel messages. It supports unsigned varints up to
-   * 32 bits, in which case the value is returned in \ref lengthOrValue.
-   * It also supports length-delimited headers (e.g. strings), in which case
-   * \ref lengthOrValue is the length. In this case, the sting/bytestream
-   * is not processed, but it can be easily accessed by 
-   * \ref bufferStart + ret.
+   * Decodes a JSON payload to \ref status, either with the extractor in
+   * ArduCastJson.h or with ArduinoJson if \ref ARDUCAST_USE_ARDUINOJSON is
+   * defined, and updates the status fields from it.
    * 
-   * \param[in] bufferStart
+   * \param[in] payload
+   *    The payload, not terminated.
+   * \param[in] len
+   *    Length of the payload.
+   * \param[in] processPayload
+   *    1 if the payload is from the device (RECEIVER_STATUS is expected),
+   *    2 if the payload is from the application (MEDIA_STATUS is expected)
+   */
+  void processJsonPayload(const uint8_t *payload, uint32_t len, uint8_t processPayload);
+
+  /**
+   * Updates the fields reported by the device (e.g. \ref volume) from a
+   * decoded RECEIVER_STATUS.
+   */
+  void applyReceiverStatus(const castStatus_t &status);
+
+  /**
+   * Updates the fields reported by the application (e.g. \ref title) from a
+   * decoded MEDIA_STATUS.
+   */
+  void applyMediaStatus(const castStatus_t &status);
+
+  /**
+   * The request waiting for a response on each channel, 0 is the device and
+   * 1 is the application (as the bits of \ref pongNeeded). The channels wait
+   * and time out independently.
+   */
+  channelRequest_t requests[2] = {{0, false, 5}, {0, false, 5}};
+
+  /**
+   * Forgets the requests of the channels from \ref channel, e.g. after a
+   * disconnection
+   */
+  void clearRequests(uint8_t channel = 0);
+
+  /**
+   * Channels where chromecast sent a PING which should be answered.
+   * Bit 0 is the device, bit 1 is the application.
+   */
+  uint8_t pongNeeded = 0;
+
+  bool pushMode = false;
+  uint32_t statusFallbackInterval = STATUS_FALLBACK_INTERVAL;
+  pushStats_t pushStats = {};
+
+  /**
+   * Time of the last RECEIVER_STATUS/MEDIA_STATUS, 0 if there was none
+   * since the channel was connected.
+   */
+  unsigned long deviceStatusAt = 0;
+  unsigned long mediaStatusAt = 0;
+
+  /**
+   * Time when poll mode would have sent the last GET_STATUS on a channel,
+   * which was avoided in push mode, 0 if there was none.
+   */
+  unsigned long devicePollAvoidedAt = 0;
+  unsigned long mediaPollAvoidedAt = 0;
+
+  /**
+   * Time when \ref currentTime was received, for \ref getEstimatedTime()
+   */
+  unsigned long currentTimeAt = 0;
+
+  /**
+   * Fields changed since \ref clearDirty()
+   */
+  uint16_t dirty = 0;
+
+  /**
+   * Fields changed in the current \ref loop(), to be reported to the
+   * callbacks at the end of it
+   */
+  uint16_t changedInLoop = 0;
+
+  struct {
+    uint16_t mask;
+    changeCallback_t callback;
+    void *arg;
+  } changeCallbacks[CHANGE_CALLBACKS_SIZE] = {};
+
+  struct {
+    uint8_t id;             ///< ID of the namespace in \ref namespaces, 0 if the slot is free
+    bool binary;            ///< True for payload_binary, false for payload_utf8
+    const char *nameSpace;
+    namespaceHandler_t handler;
+    void *arg;
+  } namespaceHandlers[NAMESPACE_HANDLERS_SIZE] = {};
+
+  /**
+   * Returns the connection of a channel for \ref sendMessage(), or NULL if
+   * it's not connected
+   */
+  ArduCastConnection* getChannel(castSource_t to);
+
+  /**
+   * Registers a handler, see \ref onNamespace()
+   */
+  int addNamespaceHandler(const char *nameSpace, bool binary, namespaceHandler_t handler, void *arg);
+
+  /**
+   * Calls the handlers registered for namespace \ref id with a received
+   * payload.
+   */
+  void dispatchNamespace(uint8_t id, bool binary, uint8_t source, const uint8_t *payload, uint32_t len);
+
+  /**
+   * Records fields changed by a status message.
+   * \param[in] changed
+   *    Bitmask of \ref statusField_t
+   */
+  void statusChanged(uint16_t changed);
+
+  /**
+   * Calls the registered callbacks with the fields changed in this loop.
+   */
+  void notifyChanges();
+
+  /**
+   * Returns true if GET_STATUS should be sent on a channel, where the last
+   * status was received at \ref lastStatusAt. Always true in poll mode.
+   *
+   * Otherwise an avoided poll is counted, unless one was counted in the last
+   * \ref RESPONSE_TIMEOUT (at \ref avoidedAt): poll mode wouldn't send the
+   * next GET_STATUS before the response to the previous one.
+   */
+  bool statusPollDue(unsigned long lastStatusAt, unsigned long &avoidedAt);
+
+  /**
+   * Returns the time when \ref statusPollDue() becomes true
+   */
+  unsigned long statusDeadline(unsigned long lastStatusAt);
+
+  /**
+   * Queue of control commands. Commands are written in the order of their
+   * requestId and several of them can wait for a response at the same time.
+   */
+  command_t commands[COMMAND_QUEUE_SIZE] = {};
+
+  /**
+   * requestId of the next command. 0 is used by chromecast for unsolicited
+   * messages and 1 is used by GET_STATUS, so commands start from 2.
+   */
+  uint32_t nextRequestId = 2;
+
+  /**
+   * Allocates a free slot in \ref commands with a new requestId.
+   * \return
+   *    The allocated slot or NULL if the queue is full
+   */
+  command_t* newCommand();
+
+  /**
+   * Queues a command allocated with \ref newCommand() and tries to write
+   * it immediately.
+   * \param[in] cmd
+   *    The command with the payload already filled.
+   * \param[in] connection
+   *    The channel to write the command to
+   * \param[in] nameSpace
+   *    The namespace to write the command to
+   * \param[in] callback
+   *    Called when the command is finished, can be NULL
+   * \param[in] callbackArg
+   *    Argument passed to \ref callback
+   * \return
+   *    0 on success
+   */
+  int queueCommand(command_t *cmd, ArduCastConnection &connection, const char *nameSpace, commandCallback_t callback, void *callbackArg);
+
+  /**
+   * Writes the queued commands to the TCP channel, in order. Does nothing
+   * while a message is being received, as the buffer is in use.
+   */
+  void flushCommands();
+
+  /**
+   * Fails the commands waiting for a response longer than
+   * \ref COMMAND_TIMEOUT
+   */
+  void checkCommandTimeouts();
+
+  /**
+   * Finishes a command: calls its callback and frees its slot.
+   * \param[in] cmd
+   *    The command to finish
+   * \param[in] result
+   *    The result to pass to the callback
+   */
+  void finishCommand(command_t *cmd, int result);
+
+  /**
+   * Finishes all queued and pending commands with \ref result, e.g. when
+   * the TCP channel is closed.
+   */
+  void finishAllCommands(int result);
+
+public:
+  /**
+   * Decodes an unsigned varint of up to 64 bits.
+   * \param[in] buffer
+   *    The buffer where the varint starts
+   * \param[in] end
+   *    End of the buffer, nothing is read from here
+   * \param[out] value
+   *    The decoded value
+   * \return
+   *    The number of bytes processed, 0 if the varint is truncated or longer
+   *    than 10 bytes
+   */
+  static uint8_t pbDecodeVarint(const uint8_t *buffer, const uint8_t *end, uint64_t *value);
+
+  /**
+   * Decodes a protocol buffer field header (key) and the value or length
+   * following it, bounds checked against \ref end. Keys of any length and
+   * all the wire types except the deprecated groups are supported.
+   * For varint and fixed (64 and 32 bits) fields, the value is returned in
+   * \ref lengthOrValue, and the return value includes it. For
+   * length-delimited fields (e.g. strings), \ref lengthOrValue is the
+   * length; the data is not processed, but it can be accessed at
+   * \ref buffer + ret.
+   *
+   * \param[in] buffer
    *    The buffer where processing should start. This should point to a
    *    protocol buffer header.
+   * \param[in] end
+   *    End of the buffer, nothing is read from here
    * \param[out] tag
    *    The tag decoded from the protocol buffer header (i.e. the argument's
    *    number in the ordered list)
    * \param[out] wire
-   *    The wire decoded from the protocol buffer header. Should be either
-   *    0 (varint) or 2 (length-delimited). Otherwise the processing probably
-   *    failed
+   *    The wire type decoded from the protocol buffer header, see
+   *    pb_wire_type_t
    * \param[out] lengthOrValue
-   *    The decoded value for varint (\ref wire is 0) or the length of the
-   *    length-delimited type's length (\ref wire is 2)
+   *    The decoded value, or the length of a length-delimited field
    * \return
-   *    The number of bytes processed
+   *    The number of bytes processed, 0 if the field is malformed or
+   *    truncated. The data of a length-delimited field may still run past
+   *    \ref end.
    */
-  uint8_t pbDecodeHeader(uint8_t *bufferStart, uint8_t *tag, uint8_t *wire, uint32_t *lengthOrValue);
+  static uint8_t pbDecodeHeader(const uint8_t *buffer, const uint8_t *end, uint32_t *tag, uint8_t *wire, uint64_t *lengthOrValue);
 
-  unsigned long msgSentAt;
-  bool msgSent;
+  /**
+   * Decodes a CastMessage in a single pass, into the offsets of its fields.
+   * Unknown fields are skipped, whatever their wire type. Fields which
+   * don't have the wire type of the CastMessage definition make the message
+   * malformed. If a field appears more than once, the last one is indexed.
+   * \param[in] buffer
+   *    The message, without the length field
+   * \param[in] len
+   *    Length of \ref buffer
+   * \param[in] truncated
+   *    True if the message didn't fit in the buffer. In this case, a
+   *    length-delimited field running past the end is indexed up to the
+   *    end, and marked in \ref castMsgIndex_t::truncated.
+   * \param[out] index
+   *    The fields found
+   * \return
+   *    0 on success, -1 if the message is malformed
+   */
+  static int pbIndexMessage(const uint8_t *buffer, uint32_t len, bool truncated, castMsgIndex_t *index);
 
-public:
   //stuff reported by chromecast's main channel
 
   /**
@@ -280,25 +1401,25 @@ public:
    * Note that this is an UTF8 string
    * E.g. "Spotify"
    */
-  char displayName[50];
+  char *displayName;
 
   /**
    * statusText reported by chromecast or "" if nothing is reported.
    * Note that this is an UTF8 string
    * E.g. "Casting: <Title of the song>"
    */
-  char statusText[50];
+  char *statusText;
 
   /**
    * Volume reported by chromecast or -1 if nothing is reported
    * Should be between 0 and 1.
    */
-  float volume; //0-1, -1 if nothing is reported
+  float volume = -1; //0-1, -1 if nothing is reported
 
   /**
    * True if chromecast reported muted status, false otherwise
    */
-  bool isMuted;
+  bool isMuted = false;
 
   //only valid when application is running, otherwise not even cleared
 
@@ -306,51 +1427,125 @@ public:
    * playerState reported by the application or IDLE when nothing is reported
    * E.g. PLAYING
    */
-  playerState_t playerState;
+  playerState_t playerState = IDLE;
 
   /**
    * Duration of the song currently playing (if any) in seconds or 0
    * if nothing is reported
    */
-  float duration;
+  float duration = 0;
 
   /**
    * Current time in the song currently playing (if any) in seconds or 0
    * if nothing is reported
    */
-  float currentTime;
+  float currentTime = 0;
+
+  /**
+   * Playback rate reported by the application, 1 for normal speed or if
+   * nothing is reported
+   */
+  float playbackRate = 1.0;
 
   /**
    * Title of song currently playing or "" if nothing is reported.
    * Note that this is an UTF8 string
    */
-  char title[50];
+  char *title;
   
   /**
    * Artist of song currently playing or "" if nothing is reported.
    * Note that this is an UTF8 string
    */
-  char artist[50];
+  char *artist;
+
+  /**
+   * Constructor. Allocates the arena for \ref CC_DEFAULT_CONFIG from heap.
+   */
+  ArduCastControl();
+
+  /**
+   * Constructor with custom memory configuration. Allocates the arena for
+   * \ref config from heap.
+   */
+  ArduCastControl(const castConfig_t &config);
+
+  /**
+   * Constructor using a buffer shared with other instances, typically the
+   * one of an \ref ArduCastHub.
+   * \param[in] buffer
+   *    The shared buffer. Must outlive the instance.
+   * \param[in] config
+   *    Memory configuration, \ref castConfig_t::bufferSize is ignored, and
+   *    so is \ref castConfig_t::jsonBufferSize if the buffer comes with a
+   *    JSON workspace.
+   */
+  ArduCastControl(sharedBuffer_t &buffer, const castConfig_t &config = CC_DEFAULT_CONFIG);
+
+  ~ArduCastControl();
+
+  /**
+   * Returns true if the instance was constructed with \ref buffer
+   */
+  bool usesBuffer(const sharedBuffer_t &buffer);
+
+  /**
+   * Returns the memory use of the instance, which can be used to tune
+   * \ref castConfig_t.
+   */
+  castMemoryStats_t getMemoryStats();
+
+  /**
+   * Returns the duration of the TCP/TLS connection (mostly the handshake) of
+   * the last successful \ref connect() in ms, e.g. to check the effect of
+   * \ref TLS_SESSION_CACHE.
+   */
+  uint32_t getConnectTime();
+
+  /**
+   * Returns the protocol counters: traffic per namespace, dropped frames,
+   * parse errors, timeouts, connections and the histograms of the response
+   * latency and the processing time of the received frames.
+   * \return
+   *    Reference to the counters
+   */
+  const castMetrics_t& getMetrics();
+
+  /**
+   * Clears all the counters of \ref getMetrics(), except
+   * \ref castMetrics_t::connectTime
+   */
+  void resetMetrics();
 
   /**
-   * Constructor
+   * Prints \ref getMetrics() on Serial, one line per group
    */
-  ArduCastControl(){}
+  void dumpMetrics();
 
   /**
    * Connect to chromecast. First connects to the TCP/TLS port with
    * self-signed certificates allowed, then connects to the main channel
    * of the chromecast application layer.
    * 
+   * When reconnecting to the same host (e.g. after the WiFi was lost), the
+   * application which was running is rejoined right away, without waiting
+   * for the status of the device. If the application is gone in the
+   * meantime, chromecast closes the channel and the status is polled as
+   * usual.
+   * 
    * \param[in] host
-   *    Host of the device to connect.
+   *    Host of the device to connect. Copied, so it doesn't need to be
+   *    valid after the call.
+   * \param[in] port
+   *    TCP port of the device
    * 
    * \return 
    *    0 on success, -1 if TCP channel is not open, -2 if protobuf encoding
-   *    failed, -3 if TCP channel didn't accept the whole message, -10 if
-   *    the TCP/TLS channel can't be opened.
+   *    failed, -3 if there's no room in the TX ring, -10 if the TCP/TLS
+   *    channel can't be opened or \ref host is longer than
+   *    \ref HOST_NAME_SIZE.
    */
-  int connect(const char* host);
+  int connect(const char* host, uint16_t port = CAST_PORT);
 
   /**
    * Returns the current connection status
@@ -363,25 +1558,249 @@ public:
   /**
    * Loop function, intended to be called periodically.
    * \li First checks if the connection is alive and returns \ref DISCONNECTED
-   *    if not.
+   *    if not. With \ref setAutoReconnect(), it connects again when the
+   *    back-off allows it, and continues with the new connection.
    * \li Then checks and downlads all messages available on the TCP/TLS channel,
    *    set ping status of application channels, handles disconnect requests
    *    and updates status variables (e.g. \ref volume or \ref title).
    *    If there was anything read, the function returns.
-   * \li If notheing was read the function continous with writing a message.
-   *    It only writes, if nothing was written in the last 500ms where an
-   *    answer is expected. It writes a single message in the following order
-   *    of priority:
-   *    1: Connect to application if status is \ref CONNECT_TO_APPLICATION
-   *    2: Get status from main channel if no application is running
-   *    3: Ping on the main channel if needed
-   *    4: Get status from the application if it's running
-   *    5: Ping the application channel if needed (which shouldn't happen due to 4)
+   * \li If notheing was read the function continous with writing messages.
+   *    It only writes, if nothing was written in the last
+   *    \ref RESPONSE_TIMEOUT where an answer is expected. If the status is
+   *    \ref CONNECT_TO_APPLICATION, it connects to the application first.
+   *    Then each channel is served independently, with whatever is due
+   *    on it:
+   *    1: Get status from main channel if no application is running,
+   *       otherwise ping on the main channel if needed
+   *    2: Get status from the application if it's running, otherwise ping
+   *       the application channel if needed
+   *    Every received message counts as a response to a ping, so pings are
+   *    only sent on idle channels, e.g. in push mode.
    * \return
    *    The current connection status, at the end of the loop function.
    */
   connection_t loop();
 
+  /**
+   * Enables or disables push mode. By default (poll mode), \ref loop()
+   * sends GET_STATUS whenever it has nothing else to do. Chromecast pushes
+   * RECEIVER_STATUS and MEDIA_STATUS on every change to connected senders
+   * anyway, so in push mode \ref loop() relies on those, and only sends
+   * GET_STATUS when connecting to an application or when no status arrived
+   * on the channel for \ref fallbackInterval. The channels are kept alive
+   * with PING messages.
+   * 
+   * \param[in] enable
+   *    True for push mode, false for poll mode
+   * \param[in] fallbackInterval
+   *    Status is polled if nothing was pushed for this amount of time, in ms
+   */
+  void setPushMode(bool enable, uint32_t fallbackInterval = STATUS_FALLBACK_INTERVAL);
+
+  /**
+   * Records the frames received and sent from now on, e.g. to replay them
+   * later with \ref ArduCastReplayClient.
+   * \param[in] capture
+   *    The capture, must outlive the instance or be removed. NULL to stop
+   *    capturing.
+   */
+  void setCapture(ArduCastCapture *capture);
+
+  /**
+   * Returns the TLS client, e.g. to start the replay of
+   * \ref ArduCastReplayClient
+   */
+  castClient_t& getClient();
+
+  /**
+   * Returns the status message counters, e.g. to check how many polls
+   * were avoided in push mode.
+   * 
+   * \return
+   *    Reference to the counters
+   */
+  const pushStats_t& getPushStats();
+
+  /**
+   * Sets the keep-alive of a channel, see
+   * \ref ArduCastConnection::setKeepAlive(). A longer keep-alive means
+   * less traffic (and radio wake-ups) on idle channels, but a dead
+   * connection is detected later. Default is \ref PING_TIMEOUT.
+   * \param[in] channel
+   *    The device or the application channel
+   * \param[in] ms
+   *    The keep-alive in ms, must not be 0
+   */
+  void setKeepAlive(castSource_t channel, uint32_t ms);
+
+  /**
+   * Enables or disables the automatic reconnection. When enabled,
+   * \ref loop() connects to the host of the last \ref connect() if the
+   * connection is lost, right away for the first time, then with
+   * exponential back-off between the failed attempts. The back-off is
+   * jittered (a random time between the half and the full back-off), so
+   * several devices don't retry in sync, e.g. after a WiFi outage.
+   * Connecting blocks for the TLS handshake.
+   * 
+   * \param[in] enable
+   *    True to reconnect automatically
+   * \param[in] minBackoff
+   *    Back-off after the first failed attempt, in ms
+   * \param[in] maxBackoff
+   *    Maximum back-off, in ms
+   */
+  void setAutoReconnect(bool enable, uint32_t minBackoff = RECONNECT_MIN_BACKOFF, uint32_t maxBackoff = RECONNECT_MAX_BACKOFF);
+
+  /**
+   * Returns the time (as \ref millis()) when \ref loop() has something to do
+   * next: a status poll or ping due on a channel, a response or command
+   * timing out, or a partially received message timing out. Messages
+   * arriving on the TCP channel are not predicted, and in poll mode a status
+   * poll is due whenever the last one was answered. Data waiting while
+   * another instance holds the shared buffer is polled every
+   * \ref SHARED_RX_POLL_INTERVAL.
+   * 
+   * This doesn't change anything, so it can be called any time, e.g.
+   * right after \ref loop() to decide how long to sleep.
+   * \return
+   *    The deadline, which can be in the past (or \ref millis()) if there's
+   *    something to do right away
+   */
+  unsigned long nextDeadline();
+
+  /**
+   * Returns the time until \ref nextDeadline(), i.e. how long \ref loop()
+   * doesn't need to be called. Battery powered devices can sleep (e.g.
+   * light sleep or modem sleep) for this long between calls, instead of
+   * calling \ref loop() periodically. Use push mode (see
+   * \ref setPushMode()), as in poll mode a status poll is due whenever the
+   * last one was answered.
+   * 
+   * A message can arrive earlier, which is only a problem if the sleep
+   * blocks the radio, so a sleep longer than \ref PING_TIMEOUT is rarely
+   * a good idea anyway.
+   * \return
+   *    Time until the next work in ms, 0 if \ref loop() should be called
+   *    right away
+   */
+  uint32_t getSleepTime();
+
+  /**
+   * Returns the current position in the song, estimated from the last
+   * reported \ref currentTime, the time elapsed since it was reported and
+   * \ref playbackRate. Unlike \ref currentTime, this moves continuously
+   * during playback, so a progress display doesn't need frequent status
+   * updates.
+   * 
+   * \return
+   *    The estimated position in seconds, between 0 and \ref duration.
+   *    Same as \ref currentTime if not \ref PLAYING.
+   */
+  float getEstimatedTime();
+
+  /**
+   * Returns the fields changed since the last \ref clearDirty(). The
+   * fields are only marked dirty if their value actually changed.
+   * 
+   * \return
+   *    Bitmask of \ref statusField_t
+   */
+  uint16_t getDirty();
+
+  /**
+   * Clears the dirty mask, e.g. after the changed fields were displayed.
+   * \param[in] mask
+   *    Bitmask of \ref statusField_t to clear
+   */
+  void clearDirty(uint16_t mask = SF_ALL);
+
+  /**
+   * Registers a callback to be called at the end of \ref loop() if any of
+   * the fields in \ref mask changed during it. The dirty mask is not
+   * affected by the callbacks.
+   * 
+   * \param[in] mask
+   *    Bitmask of \ref statusField_t the callback is interested in
+   * \param[in] callback
+   *    The callback
+   * \param[in] arg
+   *    Passed to \ref callback
+   * \return
+   *    0 on success, -11 if there's no free slot (see
+   *    \ref CHANGE_CALLBACKS_SIZE)
+   */
+  int onChange(uint16_t mask, changeCallback_t callback, void *arg = NULL);
+
+  /**
+   * Removes a callback registered with \ref onChange()
+   */
+  void removeOnChange(changeCallback_t callback, void *arg = NULL);
+
+  /**
+   * Registers a handler for the messages on a namespace, e.g. the namespace
+   * of a custom receiver application. The payload is passed to the handler
+   * as it is in the receive buffer, without copying or decoding it.
+   * 
+   * Messages on the namespaces used by the library (e.g. \ref CC_NS_MEDIA)
+   * are processed by the library as well. Several handlers can be registered
+   * for the same namespace.
+   * 
+   * \param[in] nameSpace
+   *    The namespace, e.g. urn:x-cast:com.example.custom. Not copied, it must
+   *    be valid while the handler is registered.
+   * \param[in] handler
+   *    The handler
+   * \param[in] arg
+   *    Passed to \ref handler
+   * \return
+   *    0 on success, -11 if there's no free slot (see
+   *    \ref NAMESPACE_HANDLERS_SIZE and \ref NAMESPACE_TABLE_SIZE)
+   */
+  int onNamespace(const char *nameSpace, namespaceHandler_t handler, void *arg = NULL);
+
+  /**
+   * Same as \ref onNamespace(), but the handler is called with the binary
+   * payloads (payload_binary) of the messages, e.g. for compact telemetry
+   * from a custom receiver application. Text and binary handlers can be
+   * registered for the same namespace.
+   */
+  int onBinaryNamespace(const char *nameSpace, namespaceHandler_t handler, void *arg = NULL);
+
+  /**
+   * Removes a handler registered with \ref onNamespace() or
+   * \ref onBinaryNamespace()
+   */
+  void removeOnNamespace(const char *nameSpace, namespaceHandler_t handler, void *arg = NULL);
+
+  /**
+   * Writes a message on any namespace to the device or to the connected
+   * application, e.g. to talk to a custom receiver application. Can be
+   * called from a \ref namespaceHandler_t, e.g. to respond.
+   * \param[in] to
+   *    The channel to write to
+   * \param[in] nameSpace
+   *    The namespace
+   * \param[in] payload
+   *    The payload, the requestId (if any) is not managed by the library
+   * \return
+   *    0 on success, -1 if the channel is not connected, -2 if the message
+   *    doesn't fit in the TX ring, -3 if there's no room in the TX ring at the
+   *    moment (try again later)
+   */
+  int sendMessage(castSource_t to, const char *nameSpace, const char *payload);
+
+  /**
+   * Same as \ref sendMessage(), with a payload of \ref len bytes, which
+   * doesn't need to be terminated.
+   */
+  int sendMessage(castSource_t to, const char *nameSpace, const char *payload, uint32_t len);
+
+  /**
+   * Same as \ref sendMessage(), but the payload is sent as binary
+   * (payload_binary).
+   */
+  int sendBinaryMessage(castSource_t to, const char *nameSpace, const uint8_t *payload, uint32_t len);
+
   /**
    * Dumps the recorded status values to Serial in the following format:
    * "V:<volume><muted>"
@@ -401,13 +1820,22 @@ public:
   /**
    * Play command (e.g. to resume paused playback)
    * 
+   * Control commands are queued and written in order, they don't wait for
+   * the response of the previous one. The response is matched by the
+   * requestId of the command and reported through \ref callback.
+   * 
+   * \param[in] callback
+   *    Called when the command is finished, see \ref commandCallback_t.
+   *    Can be NULL.
+   * \param[in] callbackArg
+   *    Passed to \ref callback
    * \return 
-   *    0 on success, -1 if TCP channel is not open, -2 if protobuf encoding
-   *    failed, -3 if TCP channel didn't accept the whole message, -10 if
-   *    system is waiting for a response and -9 if the current media
-   *    can't be identified (e.g. media was changed)
+   *    0 on success (the command is written or queued), -1 if TCP channel
+   *    is not open, -2 if protobuf encoding failed,
+   *    -11 if the command queue is full and -9 if
+   *    the current media can't be identified (e.g. media was changed)
    */
-  int play();
+  int play(commandCallback_t callback = NULL, void *callbackArg = NULL);
 
   /**
    * Pause or resume playback.
@@ -415,51 +1843,68 @@ public:
    *    If false, the function will send a PAUSE command
    *    If true, the function checks the current \ref playerState and send
    *    PAUSE if playing or PLAY if paused.
+   * \param[in] callback
+   *    Called when the command is finished, see \ref commandCallback_t.
+   *    Can be NULL.
+   * \param[in] callbackArg
+   *    Passed to \ref callback
    * \return 
-   *    0 on success, -1 if TCP channel is not open, -2 if protobuf encoding
-   *    failed, -3 if TCP channel didn't accept the whole message, -10 if
-   *    system is waiting for a response and -9 if the current media
-   *    can't be identified (e.g. media was changed)
+   *    0 on success (the command is written or queued), -1 if TCP channel
+   *    is not open, -2 if protobuf encoding failed,
+   *    -11 if the command queue is full and -9 if
+   *    the current media can't be identified (e.g. media was changed)
    */
-  int pause(bool toggle);
+  int pause(bool toggle, commandCallback_t callback = NULL, void *callbackArg = NULL);
 
   /**
    * Previous command. Jumps to the beginning of track or previous track.
-   * 
+   * \param[in] callback
+   *    Called when the command is finished, see \ref commandCallback_t.
+   *    Can be NULL.
+   * \param[in] callbackArg
+   *    Passed to \ref callback
    * \return 
-   *    0 on success, -1 if TCP channel is not open, -2 if protobuf encoding
-   *    failed, -3 if TCP channel didn't accept the whole message, -10 if
-   *    system is waiting for a response and -9 if the current media
-   *    can't be identified (e.g. media was changed)
+   *    0 on success (the command is written or queued), -1 if TCP channel
+   *    is not open, -2 if protobuf encoding failed,
+   *    -11 if the command queue is full and -9 if
+   *    the current media can't be identified (e.g. media was changed)
    */
-  int prev();
+  int prev(commandCallback_t callback = NULL, void *callbackArg = NULL);
 
   /**
    * Next command. Jumps to the next track,
-   *
+   * \param[in] callback
+   *    Called when the command is finished, see \ref commandCallback_t.
+   *    Can be NULL.
+   * \param[in] callbackArg
+   *    Passed to \ref callback
    * \return 
-   *    0 on success, -1 if TCP channel is not open, -2 if protobuf encoding
-   *    failed, -3 if TCP channel didn't accept the whole message, -10 if
-   *    system is waiting for a response and -9 if the current media
-   *    can't be identified (e.g. media was changed)
+   *    0 on success (the command is written or queued), -1 if TCP channel
+   *    is not open, -2 if protobuf encoding failed,
+   *    -11 if the command queue is full and -9 if
+   *    the current media can't be identified (e.g. media was changed)
    */
-  int next();
+  int next(commandCallback_t callback = NULL, void *callbackArg = NULL);
 
   /**
    * Seek to the requested position in media
    * \param[in] relative
    *    If false, seeks to \ref seekTo, if true, seeks to
-   *    \ref seekTo + \ref currentTime
+   *    \ref seekTo + \ref getEstimatedTime()
    * \param[in] seekTo
    *    Position to seek to, either in relative or absolute
-   * 
+   * \param[in] callback
+   *    Called when the command is finished, see \ref commandCallback_t.
+   *    Can be NULL.
+   * \param[in] callbackArg
+   *    Passed to \ref callback
    * \return 
-   *    0 on success, -1 if TCP channel is not open, -2 if protobuf encoding
-   *    failed, -3 if TCP channel didn't accept the whole message, -10 if
-   *    system is waiting for a response and -9 if the current media
-   *    can't be identified (e.g. media was changed)
+   *    0 on success (the command is written or queued), -1 if TCP channel
+   *    is not open, -2 if protobuf encoding failed,
+   *    -11 if the command queue is full and -9 if
+   *    the current media can't be identified (e.g. media was changed)
    */
-  int seek(bool relative, float seekTo);
+  int seek(bool relative, float seekTo, commandCallback_t callback = NULL, void *callbackArg = NULL);
 
   /**
    * Sets the volume
@@ -468,13 +1913,17 @@ public:
    *    \ref volumeTo + \ref volume
    * \param[in] volumeTo
    *    Volume to set, either in relative or absolute
-   * 
+   * \param[in] callback
+   *    Called when the command is finished, see \ref commandCallback_t.
+   *    Can be NULL.
+   * \param[in] callbackArg
+   *    Passed to \ref callback
    * \return 
-   *    0 on success, -1 if TCP channel is not open, -2 if protobuf encoding
-   *    failed, -3 if TCP channel didn't accept the whole message, -10 if
-   *    system is waiting for a response.
+   *    0 on success (the command is written or queued), -1 if TCP channel
+   *    is not open, -2 if protobuf encoding failed,
+   *    -11 if the command queue is full.
    */
-  int setVolume(bool relative, float volumeTo);
+  int setVolume(bool relative, float volumeTo, commandCallback_t callback = NULL, void *callbackArg = NULL);
 
   /**
    * Sets mute/unmute
@@ -483,13 +1932,18 @@ public:
    *    Ignored if \ref toggle is set.
    * \param[in] toggle
    *    Unmute if currently muted, mute if currently unmuted
-   * 
+   * \param[in] callback
+   *    Called when the command is finished, see \ref commandCallback_t.
+   *    Can be NULL.
+   * \param[in] callbackArg
+   *    Passed to \ref callback
    * \return 
-   *    0 on success, -1 if TCP channel is not open, -2 if protobuf encoding
-   *    failed, -3 if TCP channel didn't accept the whole message, -10 if
-   *    system is waiting for a response.
+   *    0 on success (the command is written or queued), -1 if TCP channel
+   *    is not open, -2 if protobuf encoding failed,
+   *    -11 if the command queue is full.
    */
-  int setMute(bool newMute, bool toggle);
+  int setMute(bool newMute, bool toggle, commandCallback_t callback = NULL, void *callbackArg = NULL);
 
 };
 
+#endif
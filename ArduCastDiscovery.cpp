@@ -0,0 +1,351 @@
+#include "ArduCastDiscovery.h"
+
+#include "string.h"
+#include "strings.h"
+#include "ctype.h"
+
+#define MDNS_PORT 5353
+
+#define DNS_TYPE_A    1
+#define DNS_TYPE_PTR  12
+#define DNS_TYPE_TXT  16
+#define DNS_TYPE_SRV  33
+
+//size of a decoded name, longer names are truncated (so they don't match)
+#define DNS_NAME_SIZE 128
+
+static const char CC_SERVICE[] = "_googlecast._tcp.local";
+
+//query of the PTR records of the service, without the header
+static const uint8_t CC_QUERY[] = {
+  11, '_','g','o','o','g','l','e','c','a','s','t',
+  4, '_','t','c','p',
+  5, 'l','o','c','a','l',
+  0,
+  0, DNS_TYPE_PTR,  //type
+  0, 1,             //class IN
+};
+
+/**
+ * A resource record of a packet, see \ref ArduCastDiscovery::processPacket()
+ */
+typedef struct dnsRecord_t {
+  uint16_t name;      ///< Offset of the name
+  uint16_t type;
+  uint32_t ttl;
+  uint16_t data;      ///< Offset of the data
+  uint16_t dataLen;
+} dnsRecord_t;
+
+static uint16_t read16(const uint8_t *p){
+  return ((uint16_t)p[0]<<8) | p[1];
+}
+
+/**
+ * Reads a (possibly compressed) name at \ref offset of a packet as a dotted
+ * string, e.g. "_googlecast._tcp.local".
+ * \param[out] name
+ *    Buffer of the name, NULL to skip the name
+ * \return
+ *    Offset after the name, or 0 if the name is malformed
+ */
+static uint16_t readName(const uint8_t *packet, uint16_t len, uint16_t offset, char *name, uint16_t nameSize){
+  uint16_t end = 0;     //offset after the name, set at the first pointer
+  uint16_t nameLen = 0;
+  uint8_t jumps = 0;
+  while ( true ){
+    if ( offset >= len )
+      return 0;
+    uint8_t labelLen = packet[offset];
+    if ( labelLen == 0 ){
+      offset++;
+      break;
+    }
+    if ( (labelLen & 0xC0) == 0xC0 ){
+      //limit the jumps, so a pointer loop can't hang us
+      if ( offset + 1 >= len || ++jumps > 16 )
+        return 0;
+      if ( end == 0 )
+        end = offset + 2;
+      offset = ((labelLen & 0x3F) << 8) | packet[offset+1];
+      continue;
+    }
+    if ( (labelLen & 0xC0) != 0 || offset + 1 + labelLen > len )
+      return 0;
+    if ( name != NULL ){
+      if ( nameLen > 0 && nameLen + 1 < nameSize )
+        name[nameLen++] = '.';
+      for(uint8_t i = 0; i < labelLen && nameLen + 1 < nameSize; i++)
+        name[nameLen++] = packet[offset+1+i];
+    }
+    offset += 1 + labelLen;
+  }
+  if ( name != NULL )
+    name[nameLen] = '\0';
+  return end != 0 ? end : offset;
+}
+
+/**
+ * Copies the value of \ref key from a TXT record (a list of length prefixed
+ * key=value strings) to \ref value, truncated if needed.
+ */
+static void readTxt(const uint8_t *data, uint16_t len, const char *key, char *value, uint16_t valueSize){
+  uint16_t keyLen = strlen(key);
+  uint16_t offset = 0;
+  while ( offset < len ){
+    uint8_t strLen = data[offset++];
+    if ( offset + strLen > len )
+      return;
+    if ( strLen > keyLen && data[offset+keyLen] == '=' && strncasecmp((const char*)data+offset, key, keyLen) == 0 ){
+      uint16_t valueLen = strLen - keyLen - 1;
+      if ( valueLen >= valueSize )
+        valueLen = valueSize - 1;
+      memcpy(value, data+offset+keyLen+1, valueLen);
+      value[valueLen] = '\0';
+      return;
+    }
+    offset += strLen;
+  }
+}
+
+/**
+ * Hash of a DNS name, to match the SRV target with the address records.
+ * Names are case insensitive, and devices don't always use the same case in
+ * both, so the name is hashed in lower case.
+ */
+static uint32_t nameHash(const char *name){
+  uint8_t lower[DNS_NAME_SIZE];
+  uint16_t len = 0;
+  for(; name[len] != '\0' && len < sizeof(lower); len++)
+    lower[len] = tolower((uint8_t)name[len]);
+  return ArduCastStringTable::hash(lower, len);
+}
+
+int ArduCastDiscovery::begin(){
+  IPAddress group(224, 0, 0, 251);
+#if defined(ESP8266)
+  if ( !udp.beginMulticast(WiFi.localIP(), group, MDNS_PORT) )
+    return -1;
+#else
+  if ( !udp.beginMulticast(group, MDNS_PORT) )
+    return -1;
+#endif
+  started = true;
+  return query();
+}
+
+void ArduCastDiscovery::end(){
+  udp.stop();
+  started = false;
+}
+
+int ArduCastDiscovery::query(){
+  if ( !started )
+    return -1;
+  queryAt = millis() + DISCOVERY_QUERY_INTERVAL;
+  //ID 0, standard query, one question
+  uint8_t header[12] = { 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0 };
+  IPAddress group(224, 0, 0, 251);
+#if defined(ESP8266)
+  if ( !udp.beginPacketMulticast(group, MDNS_PORT, WiFi.localIP()) )
+    return -1;
+#else
+  if ( !udp.beginPacket(group, MDNS_PORT) )
+    return -1;
+#endif
+  udp.write(header, sizeof(header));
+  udp.write(CC_QUERY, sizeof(CC_QUERY));
+  return udp.endPacket() ? 0 : -1;
+}
+
+uint8_t ArduCastDiscovery::loop(){
+  if ( started ){
+    int len;
+    while ( (len = udp.parsePacket()) > 0 ){
+      if ( len > DISCOVERY_BUFFER_SIZE )
+        len = DISCOVERY_BUFFER_SIZE; //the rest is dropped with the packet
+      len = udp.read(buffer, len);
+      if ( len > 0 )
+        processPacket(buffer, len);
+    }
+    if ( (int32_t)(millis() - queryAt) >= 0 )
+      query();
+  }
+
+  for(uint8_t i = 0; i < DISCOVERY_MAX_DEVICES; i++){
+    if ( devices[i].valid && (int32_t)(millis() - devices[i].expiresAt) >= 0 )
+      devices[i].valid = false;
+  }
+  return getDeviceCount();
+}
+
+void ArduCastDiscovery::processPacket(const uint8_t *packet, uint16_t len){
+  //only responses
+  if ( len < 12 || (packet[2] & 0x80) == 0 )
+    return;
+  uint16_t questions = read16(packet+4);
+  uint16_t records = read16(packet+6) + read16(packet+8) + read16(packet+10);
+  uint16_t offset = 12;
+  for(uint16_t i = 0; i < questions; i++){
+    offset = readName(packet, len, offset, NULL, 0);
+    if ( offset == 0 )
+      return;
+    offset += 4;
+  }
+
+  //index the records, the ones which don't fit are ignored
+  dnsRecord_t index[DISCOVERY_MAX_RECORDS];
+  uint8_t count = 0;
+  for(uint16_t i = 0; i < records && count < DISCOVERY_MAX_RECORDS; i++){
+    dnsRecord_t &r = index[count];
+    r.name = offset;
+    offset = readName(packet, len, offset, NULL, 0);
+    if ( offset == 0 || offset + 10 > len )
+      break;
+    r.type = read16(packet+offset);
+    r.ttl = ((uint32_t)read16(packet+offset+4) << 16) | read16(packet+offset+6);
+    r.dataLen = read16(packet+offset+8);
+    r.data = offset + 10;
+    if ( r.data + r.dataLen > len )
+      break;
+    offset = r.data + r.dataLen;
+    count++;
+  }
+
+  char name[DNS_NAME_SIZE], instance[DNS_NAME_SIZE];
+  for(uint8_t i = 0; i < count; i++){
+    if ( index[i].type != DNS_TYPE_PTR )
+      continue;
+    readName(packet, len, index[i].name, name, sizeof(name));
+    if ( strcasecmp(name, CC_SERVICE) != 0 )
+      continue;
+    if ( readName(packet, len, index[i].data, instance, sizeof(instance)) == 0 )
+      continue;
+
+    //a chromecast, collect the records of the instance
+    castDevice_t found = {};
+    for(uint8_t j = 0; j < count; j++){
+      const dnsRecord_t &r = index[j];
+      if ( r.type != DNS_TYPE_TXT && r.type != DNS_TYPE_SRV )
+        continue;
+      readName(packet, len, r.name, name, sizeof(name));
+      if ( strcasecmp(name, instance) != 0 )
+        continue;
+      if ( r.type == DNS_TYPE_TXT ){
+        readTxt(packet+r.data, r.dataLen, "id", found.id, sizeof(found.id));
+        readTxt(packet+r.data, r.dataLen, "fn", found.name, sizeof(found.name));
+        readTxt(packet+r.data, r.dataLen, "md", found.model, sizeof(found.model));
+      } else if ( r.dataLen > 6 && readName(packet, len, r.data+6, name, sizeof(name)) != 0 ){
+        //priority, weight, port, target
+        found.port = read16(packet+r.data+4);
+        found.targetHash = nameHash(name);
+      }
+    }
+    //the id is the key of the cache
+    if ( found.id[0] == '\0' )
+      continue;
+    update(found, index[i].ttl);
+  }
+  //addresses, usually in the same packet as the SRV, but they can arrive
+  //separately too, matched by the SRV target
+  for(uint8_t i = 0; i < count; i++){
+    if ( index[i].type == DNS_TYPE_A && index[i].dataLen == 4 && index[i].ttl > 0 ){
+      readName(packet, len, index[i].name, name, sizeof(name));
+      updateAddress(nameHash(name), packet+index[i].data);
+    }
+  }
+}
+
+void ArduCastDiscovery::update(const castDevice_t &found, uint32_t ttl){
+  castDevice_t *entry = NULL;
+  for(uint8_t i = 0; i < DISCOVERY_MAX_DEVICES && entry == NULL; i++){
+    if ( strcmp(devices[i].id, found.id) == 0 )
+      entry = &devices[i];
+  }
+  if ( ttl == 0 ){ //goodbye
+    if ( entry != NULL )
+      entry->valid = false;
+    return;
+  }
+  if ( entry == NULL ){
+    //a free slot, or the one expiring first
+    for(uint8_t i = 0; i < DISCOVERY_MAX_DEVICES; i++){
+      castDevice_t &d = devices[i];
+      if ( !d.valid ){
+        entry = &d;
+        break;
+      }
+      if ( entry == NULL || (int32_t)(d.expiresAt - entry->expiresAt) < 0 )
+        entry = &d;
+    }
+    memset(entry, 0, sizeof(castDevice_t));
+    strcpy(entry->id, found.id);
+    entry->port = CAST_PORT;
+  }
+  if ( found.name[0] != '\0' )
+    strcpy(entry->name, found.name);
+  if ( found.model[0] != '\0' )
+    strcpy(entry->model, found.model);
+  if ( found.port != 0 )
+    entry->port = found.port;
+  if ( found.targetHash != 0 )
+    entry->targetHash = found.targetHash;
+  if ( ttl > DISCOVERY_MAX_TTL )
+    ttl = DISCOVERY_MAX_TTL; //ttl * 1000 would overflow
+  entry->expiresAt = millis() + ttl * 1000;
+  entry->valid = true;
+}
+
+void ArduCastDiscovery::updateAddress(uint32_t targetHash, const uint8_t *address){
+  for(uint8_t i = 0; i < DISCOVERY_MAX_DEVICES; i++){
+    castDevice_t &d = devices[i];
+    if ( d.targetHash != targetHash )
+      continue;
+    char host[sizeof(d.host)];
+    snprintf(host, sizeof(host), "%u.%u.%u.%u", address[0], address[1], address[2], address[3]);
+    if ( strcmp(host, d.host) != 0 )
+      strcpy(d.host, host);
+  }
+}
+
+uint8_t ArduCastDiscovery::getDeviceCount(){
+  uint8_t count = 0;
+  for(uint8_t i = 0; i < DISCOVERY_MAX_DEVICES; i++){
+    if ( devices[i].valid )
+      count++;
+  }
+  return count;
+}
+
+const castDevice_t* ArduCastDiscovery::getDevice(uint8_t index){
+  for(uint8_t i = 0; i < DISCOVERY_MAX_DEVICES; i++){
+    if ( devices[i].valid && index-- == 0 )
+      return &devices[i];
+  }
+  return NULL;
+}
+
+const castDevice_t* ArduCastDiscovery::find(const char *name){
+  for(uint8_t i = 0; i < DISCOVERY_MAX_DEVICES; i++){
+    if ( devices[i].valid && devices[i].host[0] != '\0' && strcasecmp(devices[i].name, name) == 0 )
+      return &devices[i];
+  }
+  return NULL;
+}
+
+int ArduCastDiscovery::connect(ArduCastControl &cc, const char *name){
+  const castDevice_t *device = find(name);
+  if ( device == NULL )
+    return -15;
+  return cc.connect(device->host, device->port);
+}
+
+uint32_t ArduCastDiscovery::getSleepTime(){
+  unsigned long now = millis();
+  int32_t sleep = started ? (int32_t)(queryAt - now) : INT32_MAX;
+  for(uint8_t i = 0; i < DISCOVERY_MAX_DEVICES; i++){
+    if ( devices[i].valid && (int32_t)(devices[i].expiresAt - now) < sleep )
+      sleep = devices[i].expiresAt - now;
+  }
+  return sleep > 0 ? sleep : 0;
+}
@@ -0,0 +1,222 @@
+/**
+ * ArduCastDiscovery.h - Finds chromecasts on the local network with mDNS
+ * https://github.com/andrasbiro/chromecastcontrol
+ */
+
+#ifndef ARDUCASTDISCOVERY_H
+#define ARDUCASTDISCOVERY_H
+
+#include "ArduCastControl.h"
+
+/**
+ * The UDP class used for mDNS. It must provide the WiFiUDP interface used by
+ * the library (beginMulticast, beginPacket or beginPacketMulticast on
+ * ESP8266, write, endPacket, parsePacket, read and stop). Override it, like
+ * \ref ARDUCAST_CLIENT, e.g. to run the discovery off-device. The header
+ * declaring the class must be included before this file in that case.
+ */
+#ifndef ARDUCAST_UDP
+#if defined(ESP8266)
+#include <ESP8266WiFi.h>
+#else
+#include <WiFi.h>
+#endif
+#include <WiFiUdp.h>
+#define ARDUCAST_UDP WiFiUDP
+#endif
+
+typedef ARDUCAST_UDP castUdp_t;
+
+/**
+ * Maximum number of devices kept by \ref ArduCastDiscovery. If more devices
+ * answer, the one expiring first is replaced.
+ */
+#ifndef DISCOVERY_MAX_DEVICES
+#define DISCOVERY_MAX_DEVICES 8
+#endif
+
+/**
+ * Size of the friendly name of a device, including the terminating zero.
+ * Longer names are truncated.
+ */
+#ifndef DISCOVERY_NAME_SIZE
+#define DISCOVERY_NAME_SIZE 64
+#endif
+
+/**
+ * Size of the model name of a device, including the terminating zero.
+ * Longer names are truncated.
+ */
+#ifndef DISCOVERY_MODEL_SIZE
+#define DISCOVERY_MODEL_SIZE 32
+#endif
+
+/**
+ * Size of the buffer receiving a single mDNS packet. The records which don't
+ * fit are ignored. An answer of a chromecast is about 400B.
+ */
+#ifndef DISCOVERY_BUFFER_SIZE
+#define DISCOVERY_BUFFER_SIZE 512
+#endif
+
+/**
+ * Maximum number of resource records processed from a single packet
+ */
+#ifndef DISCOVERY_MAX_RECORDS
+#define DISCOVERY_MAX_RECORDS 24
+#endif
+
+/**
+ * Interval of the queries sent by \ref ArduCastDiscovery::loop(). Chromecasts
+ * answer with a TTL of 2 minutes, so this keeps the devices in the cache, and
+ * finds new ones in a minute (devices usually announce themselves when they
+ * join the network anyway).
+ */
+#ifndef DISCOVERY_QUERY_INTERVAL
+#define DISCOVERY_QUERY_INTERVAL 60000
+#endif
+
+/**
+ * Longest TTL of a device in the cache in seconds, a record with a longer
+ * TTL is only kept for this long (the expiry must fit the
+ * \ref millis() arithmetic).
+ */
+#ifndef DISCOVERY_MAX_TTL
+#define DISCOVERY_MAX_TTL 86400
+#endif
+
+/**
+ * A chromecast found by \ref ArduCastDiscovery
+ */
+typedef struct castDevice_t {
+  char name[DISCOVERY_NAME_SIZE];   ///< Friendly name (fn), e.g. "Living Room"
+  char id[33];                      ///< Unique ID of the device (id)
+  char model[DISCOVERY_MODEL_SIZE]; ///< Model name (md), e.g. "Chromecast Audio"
+  char host[16];                    ///< IP address as string, "" if not yet known
+  uint16_t port;                    ///< TCP port, \ref CAST_PORT except for audio groups
+  uint32_t targetHash;              ///< Hash of the host name in the SRV record, to match address records
+  unsigned long expiresAt;          ///< Time when the record expires, as \ref millis()
+  bool valid;                       ///< False if the slot is free or the device expired
+} castDevice_t;
+
+/**
+ * Discovers chromecasts on the local network with mDNS/DNS-SD, by browsing
+ * the _googlecast._tcp service. The devices are kept in a cache (with the
+ * TTL of their records), so they can be connected by their friendly name,
+ * instead of a fixed IP address:
+ *
+ *     ArduCastDiscovery discovery;
+ *     ArduCastControl cc;
+ *     ...
+ *     discovery.begin();
+ *     ...
+ *     discovery.loop();
+ *     if ( cc.getConnection() == DISCONNECTED )
+ *       discovery.connect(cc, "Living Room");
+ *
+ * If the address of a device changes (e.g. DHCP), its cache entry is
+ * updated, and the next \ref connect() uses the new address.
+ * \ref ArduCastControl keeps a copy of the host, so its automatic
+ * reconnection stays on the old address; connect through the discovery
+ * when disconnected, as above, to follow the device.
+ */
+class ArduCastDiscovery {
+private:
+  castUdp_t udp;
+  bool started = false;
+  unsigned long queryAt = 0;              ///< Time of the next query
+  castDevice_t devices[DISCOVERY_MAX_DEVICES] = {};
+  uint8_t buffer[DISCOVERY_BUFFER_SIZE];
+
+  /**
+   * Updates the cache with a device parsed from a packet. Fields which are
+   * not set (empty string, 0 port, 0 hash) are kept from the cached entry.
+   * \param[in] ttl
+   *    TTL of the record in seconds, 0 if the device is leaving
+   */
+  void update(const castDevice_t &found, uint32_t ttl);
+
+  /**
+   * Updates the address of the cached devices with the SRV target
+   * \ref targetHash.
+   */
+  void updateAddress(uint32_t targetHash, const uint8_t *address);
+
+public:
+  /**
+   * Joins the mDNS multicast group and sends the first query. WiFi must be
+   * connected.
+   * \return
+   *    0 on success, -1 if the multicast group can't be joined
+   */
+  int begin();
+
+  /**
+   * Leaves the multicast group. The cache is kept.
+   */
+  void end();
+
+  /**
+   * Sends a query for chromecasts right away. Answers are processed by
+   * \ref loop().
+   * \return
+   *    0 on success, -1 if \ref begin() was not called or sending failed
+   */
+  int query();
+
+  /**
+   * Loop function, intended to be called periodically. Processes the
+   * received mDNS packets, expires the old devices and queries again every
+   * \ref DISCOVERY_QUERY_INTERVAL.
+   * \return
+   *    The number of devices known
+   */
+  uint8_t loop();
+
+  /**
+   * Processes an mDNS packet, e.g. one received by other means. Called by
+   * \ref loop(). Malformed packets are ignored.
+   * \param[in] packet
+   *    The packet, starting with the DNS header
+   * \param[in] len
+   *    Length of \ref packet
+   */
+  void processPacket(const uint8_t *packet, uint16_t len);
+
+  /**
+   * Returns the number of devices known
+   */
+  uint8_t getDeviceCount();
+
+  /**
+   * Returns the device at \ref index (0 to \ref getDeviceCount()-1). Adding
+   * or expiring a device changes the indexes.
+   */
+  const castDevice_t* getDevice(uint8_t index);
+
+  /**
+   * Finds a device by its friendly name, case insensitive.
+   * \return
+   *    The device or NULL if it's not known, or its address is not yet
+   *    known.
+   */
+  const castDevice_t* find(const char *name);
+
+  /**
+   * Connects to a device by its friendly name, see
+   * \ref ArduCastControl::connect().
+   * \return
+   *    Same as \ref ArduCastControl::connect(), or -15 if the device is not
+   *    known
+   */
+  int connect(ArduCastControl &cc, const char *name);
+
+  /**
+   * Returns how long \ref loop() doesn't need to be called, i.e. the time
+   * until the next query or expiry. Answers arriving in the meantime wait
+   * in the UDP stack (which may drop them if too many arrive).
+   */
+  uint32_t getSleepTime();
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "ArduCastHub.h"
+
+ArduCastHub::ArduCastHub(uint32_t bufferSize, uint32_t jsonBufferSize)
+#ifdef ARDUCAST_USE_ARDUINOJSON
+  : arena(ARENA_ALIGNED(bufferSize) + ARENA_ALIGNED(jsonBufferSize))
+#else
+  : arena(bufferSize)
+#endif
+{
+  shared.buffer = (uint8_t*)arena.allocate(bufferSize);
+  shared.size = shared.buffer != NULL ? bufferSize : 0;
+  shared.owner = NULL;
+#ifdef ARDUCAST_USE_ARDUINOJSON
+  //the rest of the arena is the JSON workspace, used by one device at a time
+  shared.jsonArena = &arena;
+  shared.jsonSize = jsonBufferSize;
+#else
+  (void)jsonBufferSize;
+  shared.jsonArena = NULL;
+  shared.jsonSize = 0;
+#endif
+}
+
+sharedBuffer_t& ArduCastHub::getBuffer(){
+  return shared;
+}
+
+int ArduCastHub::add(ArduCastControl &cc, const char *host){
+  if ( deviceCount >= HUB_MAX_DEVICES )
+    return -11;
+  if ( !cc.usesBuffer(shared) )
+    return -14;
+  devices[deviceCount].cc = &cc;
+  devices[deviceCount].host = host;
+  devices[deviceCount].connectAt = millis() - HUB_RECONNECT_INTERVAL; //connect right away
+  deviceCount++;
+  return 0;
+}
+
+void ArduCastHub::remove(ArduCastControl &cc){
+  for(uint8_t i = 0; i < deviceCount; i++){
+    if ( devices[i].cc == &cc ){
+      for(uint8_t j = i; j + 1 < deviceCount; j++)
+        devices[j] = devices[j+1];
+      deviceCount--;
+      if ( nextDevice >= deviceCount )
+        nextDevice = 0;
+      return;
+    }
+  }
+}
+
+uint8_t ArduCastHub::getDeviceCount(){
+  return deviceCount;
+}
+
+ArduCastControl* ArduCastHub::getDevice(uint8_t index){
+  if ( index >= deviceCount )
+    return NULL;
+  return devices[index].cc;
+}
+
+uint8_t ArduCastHub::loop(){
+  uint8_t connected = 0;
+  bool connecting = false;
+
+  //let the device receiving to the buffer finish first
+  ArduCastControl *first = shared.owner;
+  if ( first != NULL && first->loop() != DISCONNECTED )
+    connected++;
+
+  for(uint8_t i = 0; i < deviceCount; i++){
+    hubDevice_t &d = devices[(nextDevice + i) % deviceCount];
+    if ( d.cc == first )
+      continue;
+    if ( d.cc->getConnection() == DISCONNECTED ){
+      //connect blocks for the TLS handshake, so only one per loop
+      if ( !connecting && millis() - d.connectAt >= HUB_RECONNECT_INTERVAL ){
+        connecting = true;
+        d.connectAt = millis();
+        if ( d.cc->connect(d.host) == 0 )
+          connected++;
+      }
+      continue;
+    }
+    if ( d.cc->loop() != DISCONNECTED )
+      connected++;
+  }
+
+  if ( deviceCount > 0 )
+    nextDevice = (nextDevice + 1) % deviceCount;
+  return connected;
+}
+
+uint32_t ArduCastHub::getSleepTime(){
+  uint32_t sleep = UINT32_MAX;
+  for(uint8_t i = 0; i < deviceCount; i++){
+    hubDevice_t &d = devices[i];
+    uint32_t deviceSleep;
+    if ( d.cc->getConnection() == DISCONNECTED ){
+      uint32_t since = millis() - d.connectAt;
+      deviceSleep = since >= HUB_RECONNECT_INTERVAL ? 0 : HUB_RECONNECT_INTERVAL - since;
+    } else {
+      deviceSleep = d.cc->getSleepTime();
+    }
+    if ( deviceSleep < sleep )
+      sleep = deviceSleep;
+  }
+  return sleep;
+}
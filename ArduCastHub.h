@@ -0,0 +1,136 @@
+/**
+ * ArduCastHub.h - Controls multiple chromecasts from one loop
+ * https://github.com/andrasbiro/chromecastcontrol
+ */
+
+#ifndef ARDUCASTHUB_H
+#define ARDUCASTHUB_H
+
+#include "ArduCastControl.h"
+
+/**
+ * Maximum number of devices managed by a single \ref ArduCastHub
+ */
+#ifndef HUB_MAX_DEVICES
+#define HUB_MAX_DEVICES 8
+#endif
+
+/**
+ * Time between connection attempts to a disconnected device
+ */
+#ifndef HUB_RECONNECT_INTERVAL
+#define HUB_RECONNECT_INTERVAL 5000
+#endif
+
+/**
+ * Manages multiple chromecast devices from one loop, e.g. all the speakers
+ * of a house.
+ * 
+ * All the devices share a single message buffer owned by the hub, and with
+ * \ref ARDUCAST_USE_ARDUINOJSON a single JSON workspace, so the memory cost
+ * of a device is only its \ref ArduCastControl instance (status, command
+ * queue, TX ring and the TLS client).
+ * The devices must be constructed with the hub's buffer:
+ * 
+ *     ArduCastHub hub;
+ *     ArduCastControl kitchen(hub.getBuffer());
+ *     ArduCastControl livingRoom(hub.getBuffer());
+ *     ...
+ *     hub.add(kitchen, "192.168.1.12");
+ *     hub.add(livingRoom, "192.168.1.13");
+ * 
+ * Then \ref loop() should be called periodically, instead of
+ * \ref ArduCastControl::loop() of each device. Control methods (e.g.
+ * \ref ArduCastControl::pause()) can be called on the devices directly.
+ */
+class ArduCastHub {
+private:
+  ArduCastArena arena;
+  sharedBuffer_t shared;
+
+  typedef struct hubDevice_t {
+    ArduCastControl *cc;
+    const char *host;
+    unsigned long connectAt;    ///< Time of the last connection attempt
+  } hubDevice_t;
+
+  hubDevice_t devices[HUB_MAX_DEVICES] = {};
+  uint8_t deviceCount = 0;
+
+  /**
+   * Index of the device served first in the next \ref loop()
+   */
+  uint8_t nextDevice = 0;
+
+public:
+  /**
+   * Constructor. Allocates the shared buffer (and JSON workspace) from heap.
+   * \param[in] bufferSize
+   *    Size of the shared buffer, should fit the biggest message of all
+   *    devices (see \ref ArduCastControl::getMemoryStats()).
+   * \param[in] jsonBufferSize
+   *    Size of the shared JSON workspace, only used with
+   *    \ref ARDUCAST_USE_ARDUINOJSON
+   */
+  ArduCastHub(uint32_t bufferSize = CONNBUFFER_SIZE, uint32_t jsonBufferSize = JSONBUFFER_SIZE);
+
+  /**
+   * Returns the shared buffer, which should be passed to the constructor of
+   * the devices.
+   */
+  sharedBuffer_t& getBuffer();
+
+  /**
+   * Adds a device to the hub. The hub will connect to it (and reconnect if
+   * the connection is lost) in \ref loop().
+   * \param[in] cc
+   *    The device, constructed with \ref getBuffer(). Must outlive the hub
+   *    or be removed with \ref remove().
+   * \param[in] host
+   *    Host of the device. Not copied, must outlive the hub.
+   * \return
+   *    0 on success, -11 if \ref HUB_MAX_DEVICES devices are already added,
+   *    -14 if the device doesn't use the buffer of this hub.
+   */
+  int add(ArduCastControl &cc, const char *host);
+
+  /**
+   * Removes a device from the hub. It is not disconnected.
+   */
+  void remove(ArduCastControl &cc);
+
+  /**
+   * Returns the number of devices added
+   */
+  uint8_t getDeviceCount();
+
+  /**
+   * Returns the device at \ref index (0 to \ref getDeviceCount()-1)
+   */
+  ArduCastControl* getDevice(uint8_t index);
+
+  /**
+   * Loop function, intended to be called periodically.
+   * Calls \ref ArduCastControl::loop() of each connected device, starting
+   * with the one in the middle of receiving a message (so the shared buffer
+   * is released as soon as possible), then the rest in round robin order,
+   * so a busy device can't starve the others.
+   * At most one disconnected device is connected in each call, as
+   * connecting blocks for the TLS handshake.
+   * \return
+   *    The number of connected devices
+   */
+  uint8_t loop();
+
+  /**
+   * Returns how long \ref loop() doesn't need to be called: the shortest
+   * \ref ArduCastControl::getSleepTime() of the connected devices, or the
+   * time until the next connection attempt of a disconnected one.
+   * \return
+   *    Time until the next work in ms, 0 if \ref loop() should be called
+   *    right away
+   */
+  uint32_t getSleepTime();
+};
+
+#endif
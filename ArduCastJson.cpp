@@ -0,0 +1,378 @@
+#include "ArduCastJson.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "string.h"
+
+#define JSON_FIELD(path, field) { path, sizeof(path)-1, field }
+
+/**
+ * Paths of the fields to extract. Array indexes are part of the path, e.g.
+ * status[0].currentTime is "status.0.currentTime".
+ */
+static const struct {
+  const char *path;
+  uint8_t len;
+  uint32_t field;
+} jsonFields[] = {
+  JSON_FIELD("type", CS_TYPE),
+  JSON_FIELD("requestId", CS_REQUEST_ID),
+  JSON_FIELD("status", CS_STATUS),
+  JSON_FIELD("status.volume.level", CS_VOLUME_LEVEL),
+  JSON_FIELD("status.volume.muted", CS_VOLUME_MUTED),
+  JSON_FIELD("status.applications.0.sessionId", CS_SESSION_ID),
+  JSON_FIELD("status.applications.0.statusText", CS_STATUS_TEXT),
+  JSON_FIELD("status.applications.0.displayName", CS_DISPLAY_NAME),
+  JSON_FIELD("status.0.mediaSessionId", CS_MEDIA_SESSION_ID),
+  JSON_FIELD("status.0.currentTime", CS_CURRENT_TIME),
+  JSON_FIELD("status.0.playbackRate", CS_PLAYBACK_RATE),
+  JSON_FIELD("status.0.playerState", CS_PLAYER_STATE),
+  JSON_FIELD("status.0.media", CS_MEDIA),
+  JSON_FIELD("status.0.media.duration", CS_DURATION),
+  JSON_FIELD("status.0.media.metadata.title", CS_TITLE),
+  JSON_FIELD("status.0.media.metadata.artist", CS_ARTIST),
+};
+
+typedef enum jsonValue_t {
+  JV_CONTAINER,
+  JV_STRING,
+  JV_NUMBER,
+  JV_BOOL,
+  JV_NULL,
+} jsonValue_t;
+
+static uint32_t jsonMatchPath(const char *path, uint8_t pathLen){
+  for(uint8_t i = 0; i < sizeof(jsonFields)/sizeof(jsonFields[0]); i++){
+    if ( jsonFields[i].len == pathLen && 0 == memcmp(jsonFields[i].path, path, pathLen) )
+      return jsonFields[i].field;
+  }
+  return 0;
+}
+
+static void jsonStoreValue(castStatus_t *status, uint32_t field, jsonValue_t type, const jsonString_t &str, double number, bool boolean){
+  switch ( field ){
+    case CS_STATUS:
+    case CS_MEDIA:
+      if ( type != JV_CONTAINER )
+        return;
+      break;
+    case CS_TYPE:
+    case CS_SESSION_ID:
+    case CS_STATUS_TEXT:
+    case CS_DISPLAY_NAME:
+    case CS_PLAYER_STATE:
+    case CS_TITLE:
+    case CS_ARTIST:
+      if ( type != JV_STRING )
+        return;
+      if ( field == CS_TYPE ) status->type = str;
+      else if ( field == CS_SESSION_ID ) status->sessionId = str;
+      else if ( field == CS_STATUS_TEXT ) status->statusText = str;
+      else if ( field == CS_DISPLAY_NAME ) status->displayName = str;
+      else if ( field == CS_PLAYER_STATE ) status->playerState = str;
+      else if ( field == CS_TITLE ) status->title = str;
+      else status->artist = str;
+      break;
+    case CS_VOLUME_MUTED:
+      if ( type != JV_BOOL )
+        return;
+      status->muted = boolean;
+      break;
+    case CS_REQUEST_ID:
+    case CS_VOLUME_LEVEL:
+    case CS_MEDIA_SESSION_ID:
+    case CS_CURRENT_TIME:
+    case CS_PLAYBACK_RATE:
+    case CS_DURATION:
+      if ( type != JV_NUMBER )
+        return;
+      if ( field == CS_REQUEST_ID ) status->requestId = number;
+      else if ( field == CS_VOLUME_LEVEL ) status->volume = number;
+      else if ( field == CS_MEDIA_SESSION_ID ) status->mediaSessionId = number;
+      else if ( field == CS_CURRENT_TIME ) status->currentTime = number;
+      else if ( field == CS_PLAYBACK_RATE ) status->playbackRate = number;
+      else status->duration = number;
+      break;
+    default:
+      return;
+  }
+  status->found |= field;
+}
+
+/**
+ * Returns the position after the closing quote of the string starting at
+ * \ref pos (which should point after the opening quote), or 0 if the string
+ * is not terminated.
+ */
+static uint32_t jsonSkipString(const uint8_t *json, uint32_t len, uint32_t pos){
+  while ( pos < len ){
+    if ( json[pos] == '\\' )
+      pos += 2;
+    else if ( json[pos] == '"' )
+      return pos + 1;
+    else
+      pos++;
+  }
+  return 0;
+}
+
+bool jsonExtractStatus(const uint8_t *json, uint32_t len, castStatus_t *status){
+  memset(status, 0, sizeof(castStatus_t));
+
+  char path[JSON_PATH_SIZE];
+  uint8_t pathLen = 0;
+  uint8_t levelStart[JSON_MAX_DEPTH]; //path length when the container was opened
+  uint16_t index[JSON_MAX_DEPTH];     //current index for arrays
+  bool isArray[JSON_MAX_DEPTH];
+  int8_t depth = -1;
+  int8_t ignoreFrom = JSON_MAX_DEPTH; //the path didn't fit from this depth
+  bool expectKey = false;
+  bool afterValue = false;
+  uint32_t pos = 0;
+
+  while ( pos < len ){
+    uint8_t c = json[pos];
+    if ( c == ' ' || c == '\t' || c == '\n' || c == '\r' ){
+      pos++;
+      continue;
+    }
+
+    if ( afterValue ){
+      if ( depth < 0 )
+        return true; //trailing garbage after the root value is ignored
+      if ( c == ',' ){
+        pos++;
+        afterValue = false;
+        pathLen = levelStart[depth];
+        if ( ignoreFrom == depth )
+          ignoreFrom = JSON_MAX_DEPTH;
+        if ( isArray[depth] ){
+          index[depth]++;
+          int written = snprintf(path+pathLen, sizeof(path)-pathLen, pathLen > 0 ? ".%u" : "%u", index[depth]);
+          if ( written < 0 || pathLen + written >= (int)sizeof(path) ){
+            if ( ignoreFrom > depth )
+              ignoreFrom = depth;
+          } else {
+            pathLen += written;
+          }
+        } else {
+          expectKey = true;
+        }
+        continue;
+      }
+      if ( (c == '}' && !isArray[depth]) || (c == ']' && isArray[depth]) ){
+        pos++;
+        pathLen = levelStart[depth];
+        if ( ignoreFrom >= depth )
+          ignoreFrom = JSON_MAX_DEPTH;
+        depth--;
+        continue;
+      }
+      return false;
+    }
+
+    if ( expectKey ){
+      if ( c == '}' ){ //empty object
+        expectKey = false;
+        afterValue = true;
+        continue;
+      }
+      if ( c != '"' )
+        return false;
+      uint32_t end = jsonSkipString(json, len, pos+1);
+      if ( end == 0 )
+        return false;
+      uint32_t keyLen = end - pos - 2;
+      pathLen = levelStart[depth];
+      if ( ignoreFrom == depth )
+        ignoreFrom = JSON_MAX_DEPTH;
+      if ( ignoreFrom > depth ){
+        uint32_t needed = pathLen + (pathLen > 0 ? 1 : 0) + keyLen;
+        if ( needed >= sizeof(path) ){
+          ignoreFrom = depth;
+        } else {
+          if ( pathLen > 0 )
+            path[pathLen++] = '.';
+          memcpy(path+pathLen, json+pos+1, keyLen);
+          pathLen += keyLen;
+        }
+      }
+      pos = end;
+      while ( pos < len && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == '\n' || json[pos] == '\r') )
+        pos++;
+      if ( pos >= len || json[pos] != ':' )
+        return false;
+      pos++;
+      expectKey = false;
+      continue;
+    }
+
+    //value
+    uint32_t field = ignoreFrom > depth ? jsonMatchPath(path, pathLen) : 0;
+    jsonString_t str = { NULL, 0 };
+    if ( c == '{' || c == '[' ){
+      if ( field )
+        jsonStoreValue(status, field, JV_CONTAINER, str, 0, false);
+      if ( depth+1 >= JSON_MAX_DEPTH )
+        return false;
+      depth++;
+      pos++;
+      levelStart[depth] = pathLen;
+      isArray[depth] = c == '[';
+      index[depth] = 0;
+      if ( c == '{' ){
+        expectKey = true;
+        continue;
+      }
+      //array: the path of the first element, unless the array is empty
+      while ( pos < len && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == '\n' || json[pos] == '\r') )
+        pos++;
+      if ( pos < len && json[pos] == ']' ){
+        afterValue = true;
+        continue;
+      }
+      if ( ignoreFrom > depth ){
+        if ( (size_t)pathLen + 2 >= sizeof(path) ){
+          ignoreFrom = depth;
+        } else {
+          if ( pathLen > 0 )
+            path[pathLen++] = '.';
+          path[pathLen++] = '0';
+        }
+      }
+      continue;
+    }
+    if ( c == '"' ){
+      uint32_t end = jsonSkipString(json, len, pos+1);
+      if ( end == 0 )
+        return false;
+      str.str = (const char*)json + pos + 1;
+      str.len = end - pos - 2;
+      if ( field )
+        jsonStoreValue(status, field, JV_STRING, str, 0, false);
+      pos = end;
+    } else if ( c == 't' && pos+4 <= len && 0 == memcmp(json+pos, "true", 4) ){
+      if ( field )
+        jsonStoreValue(status, field, JV_BOOL, str, 0, true);
+      pos += 4;
+    } else if ( c == 'f' && pos+5 <= len && 0 == memcmp(json+pos, "false", 5) ){
+      if ( field )
+        jsonStoreValue(status, field, JV_BOOL, str, 0, false);
+      pos += 5;
+    } else if ( c == 'n' && pos+4 <= len && 0 == memcmp(json+pos, "null", 4) ){
+      pos += 4;
+    } else if ( c == '-' || (c >= '0' && c <= '9') ){
+      char number[32];
+      uint8_t numberLen = 0;
+      while ( pos < len && numberLen < sizeof(number)-1 &&
+              (json[pos] == '-' || json[pos] == '+' || json[pos] == '.' ||
+               json[pos] == 'e' || json[pos] == 'E' || (json[pos] >= '0' && json[pos] <= '9')) ){
+        number[numberLen++] = json[pos++];
+      }
+      number[numberLen] = '\0';
+      if ( field )
+        jsonStoreValue(status, field, JV_NUMBER, str, strtod(number, NULL), false);
+    } else {
+      return false;
+    }
+    afterValue = true;
+  }
+  return depth < 0 && afterValue;
+}
+
+static uint8_t jsonHexDigit(char c){
+  if ( c >= '0' && c <= '9' )
+    return c - '0';
+  if ( c >= 'a' && c <= 'f' )
+    return c - 'a' + 10;
+  if ( c >= 'A' && c <= 'F' )
+    return c - 'A' + 10;
+  return 0;
+}
+
+static uint32_t jsonDecodeHex4(const char *str){
+  return (jsonHexDigit(str[0])<<12) | (jsonHexDigit(str[1])<<8) | (jsonHexDigit(str[2])<<4) | jsonHexDigit(str[3]);
+}
+
+bool jsonCopyString(char *dst, size_t dstSize, const jsonString_t &src, bool escaped){
+  if ( dstSize == 0 )
+    return false;
+  bool changed = false;
+  size_t out = 0;
+  uint16_t in = 0;
+  while ( in < src.len ){
+    char encoded[4];
+    uint8_t encodedLen = 1;
+    if ( !escaped || src.str[in] != '\\' || in+1 >= src.len ){
+      encoded[0] = src.str[in++];
+      //keep multibyte UTF8 characters together
+      if ( ((uint8_t)encoded[0] & 0xC0) == 0xC0 ){
+        while ( in < src.len && encodedLen < sizeof(encoded) && ((uint8_t)src.str[in] & 0xC0) == 0x80 )
+          encoded[encodedLen++] = src.str[in++];
+      }
+    } else {
+      char e = src.str[in+1];
+      in += 2;
+      switch ( e ){
+        case 'b': encoded[0] = '\b'; break;
+        case 'f': encoded[0] = '\f'; break;
+        case 'n': encoded[0] = '\n'; break;
+        case 'r': encoded[0] = '\r'; break;
+        case 't': encoded[0] = '\t'; break;
+        case 'u': {
+          if ( in+4 > src.len ){
+            in = src.len;
+            continue;
+          }
+          uint32_t cp = jsonDecodeHex4(src.str+in);
+          in += 4;
+          //surrogate pair
+          if ( cp >= 0xD800 && cp <= 0xDBFF && in+6 <= src.len && src.str[in] == '\\' && src.str[in+1] == 'u' ){
+            uint32_t low = jsonDecodeHex4(src.str+in+2);
+            if ( low >= 0xDC00 && low <= 0xDFFF ){
+              cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+              in += 6;
+            }
+          }
+          if ( cp < 0x80 ){
+            encoded[0] = cp;
+          } else if ( cp < 0x800 ){
+            encoded[0] = 0xC0 | (cp >> 6);
+            encoded[1] = 0x80 | (cp & 0x3F);
+            encodedLen = 2;
+          } else if ( cp < 0x10000 ){
+            encoded[0] = 0xE0 | (cp >> 12);
+            encoded[1] = 0x80 | ((cp >> 6) & 0x3F);
+            encoded[2] = 0x80 | (cp & 0x3F);
+            encodedLen = 3;
+          } else {
+            encoded[0] = 0xF0 | (cp >> 18);
+            encoded[1] = 0x80 | ((cp >> 12) & 0x3F);
+            encoded[2] = 0x80 | ((cp >> 6) & 0x3F);
+            encoded[3] = 0x80 | (cp & 0x3F);
+            encodedLen = 4;
+          }
+          break;
+        }
+        default: encoded[0] = e; break; // \" \\ \/
+      }
+    }
+    if ( out + encodedLen >= dstSize )
+      break;
+    //a shorter old string differs at its terminator, so this is enough
+    if ( memcmp(dst+out, encoded, encodedLen) != 0 ){
+      memcpy(dst+out, encoded, encodedLen);
+      changed = true;
+    }
+    out += encodedLen;
+  }
+  if ( dst[out] != '\0' ){
+    dst[out] = '\0';
+    changed = true;
+  }
+  return changed;
+}
+
+bool jsonStringEquals(const jsonString_t &str, const char *to){
+  return strlen(to) == str.len && 0 == memcmp(str.str, to, str.len);
+}
@@ -0,0 +1,126 @@
+/**
+ * ArduCastJson.h - Allocation free JSON field extractor for ArduCastControl
+ * https://github.com/andrasbiro/chromecastcontrol
+ */
+
+#ifndef ARDUCASTJSON_H
+#define ARDUCASTJSON_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Maximum nesting depth of a JSON payload. Deeper payloads are rejected.
+ */
+#ifndef JSON_MAX_DEPTH
+#define JSON_MAX_DEPTH 24
+#endif
+
+/**
+ * Size of the buffer holding the path (e.g. "status.0.media.duration") of the
+ * value being parsed. Values with longer paths are parsed, but not extracted.
+ */
+#ifndef JSON_PATH_SIZE
+#define JSON_PATH_SIZE 64
+#endif
+
+/**
+ * A string value in a JSON payload. Points directly into the payload,
+ * so it is not terminated and may contain escape sequences, unless
+ * \ref castStatus_t::unescaped is set.
+ */
+typedef struct jsonString_t {
+  const char *str;
+  uint16_t len;
+} jsonString_t;
+
+/**
+ * Bits of \ref castStatus_t::found, one for each field found in the payload
+ */
+typedef enum castStatusField_t {
+  CS_TYPE             = 1UL << 0,   ///< type
+  CS_STATUS           = 1UL << 1,   ///< status (object or array)
+  CS_VOLUME_LEVEL     = 1UL << 2,   ///< status.volume.level
+  CS_VOLUME_MUTED     = 1UL << 3,   ///< status.volume.muted
+  CS_SESSION_ID       = 1UL << 4,   ///< status.applications[0].sessionId
+  CS_STATUS_TEXT      = 1UL << 5,   ///< status.applications[0].statusText
+  CS_DISPLAY_NAME     = 1UL << 6,   ///< status.applications[0].displayName
+  CS_MEDIA_SESSION_ID = 1UL << 7,   ///< status[0].mediaSessionId
+  CS_CURRENT_TIME     = 1UL << 8,   ///< status[0].currentTime
+  CS_PLAYER_STATE     = 1UL << 9,   ///< status[0].playerState
+  CS_MEDIA            = 1UL << 10,  ///< status[0].media (object)
+  CS_DURATION         = 1UL << 11,  ///< status[0].media.duration
+  CS_TITLE            = 1UL << 12,  ///< status[0].media.metadata.title
+  CS_ARTIST           = 1UL << 13,  ///< status[0].media.metadata.artist
+  CS_REQUEST_ID       = 1UL << 14,  ///< requestId
+  CS_PLAYBACK_RATE    = 1UL << 15,  ///< status[0].playbackRate
+} castStatusField_t;
+
+/**
+ * The fields of RECEIVER_STATUS and MEDIA_STATUS messages used by
+ * ArduCastControl. A field is only valid if its bit is set in \ref found.
+ */
+typedef struct castStatus_t {
+  uint32_t found;             ///< Bitmask of \ref castStatusField_t
+  bool unescaped;             ///< True if the strings are already unescaped and terminated
+  jsonString_t type;
+  uint32_t requestId;
+  float volume;
+  bool muted;
+  jsonString_t sessionId;
+  jsonString_t statusText;
+  jsonString_t displayName;
+  int32_t mediaSessionId;
+  float currentTime;
+  float playbackRate;
+  jsonString_t playerState;
+  float duration;
+  jsonString_t title;
+  jsonString_t artist;
+} castStatus_t;
+
+/**
+ * Extracts the fields of \ref castStatus_t from a JSON payload in a single
+ * pass, without any allocation. Strings are not copied, they point into
+ * \ref json.
+ *
+ * \param[in] json
+ *    The payload. Doesn't need to be terminated.
+ * \param[in] len
+ *    Length of the payload in bytes.
+ * \param[out] status
+ *    The extracted fields.
+ * \return
+ *    True on success, false if the payload is not valid JSON (the fields
+ *    found up to the error are still set in \ref status).
+ */
+bool jsonExtractStatus(const uint8_t *json, uint32_t len, castStatus_t *status);
+
+/**
+ * Copies a JSON string to a terminated buffer, decoding the escape sequences
+ * (including \\u, which is converted to UTF8). The string is truncated if it
+ * doesn't fit, but multibyte UTF8 characters are never cut in half.
+ *
+ * \param[out] dst
+ *    Buffer to copy to.
+ * \param[in] dstSize
+ *    Size of \ref dst, including the terminating zero.
+ * \param[in] src
+ *    The string to copy.
+ * \param[in] escaped
+ *    If false, \ref src is copied as is.
+ * \return
+ *    True if the content of \ref dst changed.
+ */
+bool jsonCopyString(char *dst, size_t dstSize, const jsonString_t &src, bool escaped);
+
+/**
+ * Compares a JSON string with a terminated string. Escape sequences are not
+ * decoded, so this should only be used for plain ASCII values like enums.
+ *
+ * \return
+ *    True if the strings are equal.
+ */
+bool jsonStringEquals(const jsonString_t &str, const char *to);
+
+#endif
@@ -0,0 +1,208 @@
+#include "ArduCastReplay.h"
+
+#include "string.h"
+
+static uint32_t get32(const uint8_t *p){
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+int ArduCastReplayClient::nextByte(){
+  if ( stream != NULL )
+    return stream->read();
+  if ( dataPos >= dataLen )
+    return -1;
+  return data[dataPos++];
+}
+
+bool ArduCastReplayClient::nextBytes(uint8_t *buffer, uint32_t len){
+  if ( stream != NULL )
+    return stream->readBytes(buffer, len) == len;
+  if ( dataLen - dataPos < len )
+    return false;
+  memcpy(buffer, data + dataPos, len);
+  dataPos += len;
+  return true;
+}
+
+void ArduCastReplayClient::reset(uint16_t speed){
+  this->speed = speed;
+  connectedFlag = false;
+  hasRecord = false;
+  first = true;
+  frames = 0;
+  written = 0;
+  capturedTx = 0;
+  txFrames = 0;
+  txLeft = 0;
+  txHeaderPos = 0;
+}
+
+bool ArduCastReplayClient::begin(Stream &capture, uint16_t speed){
+  stream = &capture;
+  data = NULL;
+  reset(speed);
+  uint8_t header[CAPTURE_HEADER_SIZE];
+  return nextBytes(header, sizeof(header)) && memcmp(header, "ACAP", 4) == 0 && header[4] == 1;
+}
+
+bool ArduCastReplayClient::begin(const uint8_t *capture, uint32_t len, uint16_t speed){
+  stream = NULL;
+  data = capture;
+  dataLen = len;
+  dataPos = 0;
+  reset(speed);
+  uint8_t header[CAPTURE_HEADER_SIZE];
+  return nextBytes(header, sizeof(header)) && memcmp(header, "ACAP", 4) == 0 && header[4] == 1;
+}
+
+void ArduCastReplayClient::nextRecord(){
+  while ( !hasRecord ){
+    uint8_t header[CAPTURE_RECORD_HEADER_SIZE];
+    if ( !nextBytes(header, sizeof(header)) ){
+      connectedFlag = false; //end of the capture
+      return;
+    }
+    recordAt = get32(header);
+    if ( first ){
+      firstAt = recordAt;
+      first = false;
+    }
+    uint32_t len = get32(header + 5);
+    if ( header[4] != CAPTURE_RX || len < 4 ){
+      //sent by the library when captured, it sends its own now
+      for(uint32_t i = 0; i < len; i++){
+        if ( nextByte() < 0 ){
+          connectedFlag = false;
+          return;
+        }
+      }
+      if ( header[4] == CAPTURE_TX )
+        capturedTx++;
+      continue;
+    }
+    if ( !nextBytes(lengthField, 4) ){
+      connectedFlag = false;
+      return;
+    }
+    //truncated when captured, deliver what was captured as a whole frame
+    if ( get32(lengthField) != len - 4 ){
+      lengthField[0] = (len - 4) >> 24;
+      lengthField[1] = (len - 4) >> 16;
+      lengthField[2] = (len - 4) >> 8;
+      lengthField[3] = len - 4;
+    }
+    lengthPos = 0;
+    remaining = len - 4;
+    hasRecord = true;
+    waiting = false;
+  }
+}
+
+bool ArduCastReplayClient::due(){
+  if ( speed != 0 && millis() - startedAt < (recordAt - firstAt) / speed )
+    return false;
+  if ( txFrames >= capturedTx )
+    return true;
+  //the library doesn't send the same as when captured, don't wait forever
+  if ( !waiting ){
+    waiting = true;
+    waitingSince = millis();
+  }
+  return millis() - waitingSince >= REPLAY_WAIT;
+}
+
+uint32_t ArduCastReplayClient::getFrames(){
+  return frames;
+}
+
+uint32_t ArduCastReplayClient::getWritten(){
+  return written;
+}
+
+int ArduCastReplayClient::connect(const char*, uint16_t){
+  if ( stream == NULL && data == NULL )
+    return 0;
+  //a capture is a single connection, nothing to replay after its end
+  if ( !first && !hasRecord )
+    return 0;
+  connectedFlag = true;
+  started = false;
+  return 1;
+}
+
+uint8_t ArduCastReplayClient::connected(){
+  return connectedFlag;
+}
+
+int ArduCastReplayClient::available(){
+  //chromecast doesn't send anything before the CONNECT message
+  if ( !connectedFlag || !started )
+    return 0;
+  nextRecord();
+  if ( !hasRecord || !due() )
+    return 0;
+  uint32_t left = (4 - lengthPos) + remaining;
+  return left > INT16_MAX ? INT16_MAX : left;
+}
+
+int ArduCastReplayClient::read(){
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+int ArduCastReplayClient::read(uint8_t *buffer, size_t len){
+  if ( available() <= 0 )
+    return -1;
+  size_t got = 0;
+  while ( got < len && lengthPos < 4 )
+    buffer[got++] = lengthField[lengthPos++];
+  if ( got < len && remaining > 0 ){
+    uint32_t toRead = len - got;
+    if ( toRead > remaining )
+      toRead = remaining;
+    if ( !nextBytes(buffer + got, toRead) ){
+      connectedFlag = false;
+      return got > 0 ? got : -1;
+    }
+    got += toRead;
+    remaining -= toRead;
+  }
+  if ( lengthPos == 4 && remaining == 0 ){
+    hasRecord = false;
+    frames++;
+  }
+  return got;
+}
+
+size_t ArduCastReplayClient::write(const uint8_t *buffer, size_t len){
+  if ( !connectedFlag )
+    return 0;
+  if ( !started ){
+    started = true;
+    startedAt = millis();
+  }
+  written += len;
+  //count the messages, by their length field
+  for(size_t i = 0; i < len; ){
+    if ( txLeft > 0 ){
+      uint32_t skip = len - i < txLeft ? len - i : txLeft;
+      txLeft -= skip;
+      i += skip;
+      if ( txLeft == 0 )
+        txFrames++;
+      continue;
+    }
+    txHeader = (txHeader << 8) | buffer[i++];
+    if ( ++txHeaderPos == 4 ){
+      txHeaderPos = 0;
+      txLeft = txHeader;
+      if ( txLeft == 0 )
+        txFrames++;
+    }
+  }
+  return len;
+}
+
+void ArduCastReplayClient::stop(){
+  connectedFlag = false;
+}
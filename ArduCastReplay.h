@@ -0,0 +1,150 @@
+/**
+ * ArduCastReplay.h - Replays captured CastMessage traffic to ArduCastControl
+ * https://github.com/andrasbiro/chromecastcontrol
+ */
+
+#ifndef ARDUCASTREPLAY_H
+#define ARDUCASTREPLAY_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "ArduCastCapture.h"
+
+/**
+ * Longest time a received frame waits for the library to send as many
+ * messages as were sent before it in the capture, see
+ * \ref ArduCastReplayClient. The library may not send exactly the same
+ * messages as when the capture was recorded (e.g. fewer PINGs in an
+ * accelerated replay), so it's not waited for forever.
+ */
+#ifndef REPLAY_WAIT
+#define REPLAY_WAIT 1000
+#endif
+
+/**
+ * Stand-in TLS client, which plays back a capture recorded by
+ * \ref ArduCastCapture: the received frames of the capture are returned
+ * by \ref available() and \ref read() at their original time (or faster),
+ * everything written is accepted and discarded. A received frame is also
+ * held back until the library sent as many messages as were sent before it
+ * in the capture (at most for \ref REPLAY_WAIT), so e.g. the status of an
+ * application doesn't arrive before the library connected to it. Once the
+ * capture is over, the connection is closed.
+ *
+ * It's used as \ref ARDUCAST_CLIENT when building with ARDUCAST_REPLAY
+ * defined (e.g. -DARDUCAST_REPLAY), so the whole library, from
+ * \ref ArduCastControl::loop() down, runs on the captured traffic:
+ *
+ *     ArduCastControl cc;
+ *     ...
+ *     cc.client.begin(file, 10);  //10x speed
+ *     cc.connect("replay");
+ *     while ( cc.loop() != DISCONNECTED )
+ *       ;
+ *     cc.dumpMetrics();
+ *
+ * Only the delivery of the frames is accelerated, the timeouts of the
+ * library run on the real clock, so e.g. a response which arrived late in
+ * the capture may not time out in an accelerated replay.
+ */
+class ArduCastReplayClient {
+private:
+  Stream *stream = NULL;
+  const uint8_t *data = NULL;
+  uint32_t dataLen = 0;
+  uint32_t dataPos = 0;
+  uint16_t speed = 1;
+
+  bool connectedFlag = false;
+  bool started = false;       ///< The library wrote its first message, the capture is played from then
+  bool hasRecord = false;     ///< A received frame is being delivered
+  bool first = true;
+  uint32_t firstAt = 0;       ///< Time of the first record of the capture
+  unsigned long startedAt = 0; ///< Time of the first write, matching the first record
+  uint32_t recordAt = 0;      ///< Time of the current record
+  uint32_t remaining = 0;     ///< Bytes of the current frame not yet read
+  uint8_t lengthField[4];     ///< Length field of the current frame, corrected for truncated frames
+  uint8_t lengthPos = 4;
+  uint32_t written = 0;
+  uint32_t frames = 0;
+  uint32_t capturedTx = 0;    ///< Messages sent before the current record in the capture
+  uint32_t txFrames = 0;      ///< Messages written by the library
+  uint32_t txLeft = 0;        ///< Bytes of the message being written
+  uint32_t txHeader = 0;      ///< Length field of the message being written
+  uint8_t txHeaderPos = 0;
+  bool waiting = false;       ///< The current record waits for the library to send
+  unsigned long waitingSince = 0;
+
+  /**
+   * Reads a byte of the capture
+   * \return
+   *    The byte or -1 at the end of the capture
+   */
+  int nextByte();
+
+  /**
+   * Reads \ref len bytes of the capture
+   * \return
+   *    True if all of them could be read
+   */
+  bool nextBytes(uint8_t *buffer, uint32_t len);
+
+  /**
+   * Skips to the next received frame of the capture, if the current one is
+   * fully read. Closes the connection at the end of the capture.
+   */
+  void nextRecord();
+
+  /**
+   * Returns true if the current record is due, at the replay speed and
+   * after the messages sent before it
+   */
+  bool due();
+
+  /**
+   * Resets the state of the replay, see \ref begin()
+   */
+  void reset(uint16_t speed);
+
+public:
+  /**
+   * Starts replaying a capture from a stream, e.g. a file
+   * \param[in] capture
+   *    The capture, starting with its header
+   * \param[in] speed
+   *    1 to replay at the original speed, more to accelerate, 0 to deliver
+   *    the frames as fast as they are read
+   * \return
+   *    True if the header of the capture is valid
+   */
+  bool begin(Stream &capture, uint16_t speed = 1);
+
+  /**
+   * Starts replaying a capture from memory, e.g. one dumped from a ring by
+   * \ref ArduCastCapture::dump(). See \ref begin(Stream&,uint16_t).
+   */
+  bool begin(const uint8_t *capture, uint32_t len, uint16_t speed = 1);
+
+  /**
+   * Returns the number of received frames delivered so far
+   */
+  uint32_t getFrames();
+
+  /**
+   * Returns the bytes written by the library
+   */
+  uint32_t getWritten();
+
+  //client interface used by ArduCastControl
+  int connect(const char *host, uint16_t port);
+  uint8_t connected();
+  int available();
+  int read();
+  int read(uint8_t *buffer, size_t len);
+  size_t write(const uint8_t *buffer, size_t len);
+  void stop();
+  void setInsecure() {}
+  void allowSelfSignedCerts() {}
+};
+
+#endif
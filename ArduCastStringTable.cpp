@@ -0,0 +1,93 @@
+#include "ArduCastStringTable.h"
+
+#include <string.h>
+
+ArduCastStringTable::ArduCastStringTable(stringTableEntry_t *_entries, uint8_t _size)
+  : entries(_entries), size(_size)
+{
+  clear();
+}
+
+uint32_t ArduCastStringTable::hash(const uint8_t *data, uint32_t len){
+  uint32_t h = 2166136261UL;
+  for(uint32_t i = 0; i < len; i++){
+    h ^= data[i];
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+int ArduCastStringTable::add(const char *str, uint8_t id){
+  stringTableEntry_t entry;
+  entry.len = strlen(str);
+  entry.hash = hash((const uint8_t*)str, entry.len);
+  entry.str = str;
+  entry.id = id;
+
+  //already in the table?
+  uint8_t i = entry.hash & (size - 1);
+  while ( entries[i].str != NULL ){
+    if ( entries[i].hash == entry.hash && entries[i].len == entry.len && memcmp(entries[i].str, str, entry.len) == 0 ){
+      entries[i] = entry;
+      return 0;
+    }
+    i = (i + 1) & (size - 1);
+  }
+  //keep a free entry, so lookups always terminate
+  if ( count + 1 >= size )
+    return -11;
+  entries[i] = entry;
+  count++;
+  return 0;
+}
+
+void ArduCastStringTable::removeAt(uint8_t i){
+  //backward shift: move the following entries of the cluster to the free
+  //slot if it's between them and their home slot, so lookups still find them
+  entries[i].str = NULL;
+  count--;
+  uint8_t j = i;
+  while ( true ){
+    j = (j + 1) & (size - 1);
+    if ( entries[j].str == NULL )
+      return;
+    uint8_t home = entries[j].hash & (size - 1);
+    bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+    if ( stays )
+      continue;
+    entries[i] = entries[j];
+    entries[j].str = NULL;
+    i = j;
+  }
+}
+
+void ArduCastStringTable::remove(uint8_t id){
+  //entries are moved by removeAt(), possibly before the current one
+  bool removed;
+  do {
+    removed = false;
+    for(uint8_t i = 0; i < size; i++){
+      if ( entries[i].str != NULL && entries[i].id == id ){
+        removeAt(i);
+        removed = true;
+      }
+    }
+  } while ( removed );
+}
+
+void ArduCastStringTable::clear(){
+  for(uint8_t i = 0; i < size; i++)
+    entries[i].str = NULL;
+  count = 0;
+}
+
+uint8_t ArduCastStringTable::lookup(const uint8_t *data, uint32_t len){
+  uint32_t h = hash(data, len);
+  uint8_t i = h & (size - 1);
+  while ( entries[i].str != NULL ){
+    if ( entries[i].hash == h && entries[i].len == len && memcmp(entries[i].str, data, len) == 0 )
+      return entries[i].id;
+    i = (i + 1) & (size - 1);
+  }
+  return 0;
+}
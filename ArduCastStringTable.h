@@ -0,0 +1,87 @@
+/**
+ * ArduCastStringTable.h - Hash table of strings for message dispatch
+ * https://github.com/andrasbiro/chromecastcontrol
+ */
+
+#ifndef ARDUCASTSTRINGTABLE_H
+#define ARDUCASTSTRINGTABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * An entry of \ref ArduCastStringTable
+ */
+typedef struct stringTableEntry_t {
+  uint32_t hash;
+  const char *str;      ///< NULL if the entry is free
+  uint16_t len;
+  uint8_t id;
+} stringTableEntry_t;
+
+/**
+ * Maps strings (e.g. namespaces or source IDs) to small, nonzero IDs. Used to
+ * dispatch the received messages: a string found in a message is hashed once
+ * (FNV-1a), and found in a single probe in most cases, independently of the
+ * number of strings in the table. Only exact matches are found, i.e. a prefix
+ * of a string in the table doesn't match.
+ * 
+ * Strings are not copied, they must outlive the table (or be removed).
+ */
+class ArduCastStringTable {
+private:
+  stringTableEntry_t *const entries;
+  const uint8_t size;
+  uint8_t count = 0;
+
+  /**
+   * Frees the entry at index \ref i
+   */
+  void removeAt(uint8_t i);
+
+public:
+  /**
+   * Constructor
+   * \param[in] _entries
+   *    Storage of the table
+   * \param[in] _size
+   *    Number of entries in \ref _entries, must be a power of 2. One entry
+   *    is always kept free, so the table can hold \ref _size - 1 strings.
+   */
+  ArduCastStringTable(stringTableEntry_t *_entries, uint8_t _size);
+
+  /**
+   * FNV-1a hash of \ref data
+   */
+  static uint32_t hash(const uint8_t *data, uint32_t len);
+
+  /**
+   * Adds a string to the table, or updates its ID if it's already there.
+   * \param[in] str
+   *    The string, not copied
+   * \param[in] id
+   *    The ID, must not be 0
+   * \return
+   *    0 on success, -11 if the table is full
+   */
+  int add(const char *str, uint8_t id);
+
+  /**
+   * Removes all the strings with \ref id from the table
+   */
+  void remove(uint8_t id);
+
+  /**
+   * Removes all the strings from the table
+   */
+  void clear();
+
+  /**
+   * Looks up a (not terminated) string, e.g. a field of a received message.
+   * \return
+   *    The ID of the string or 0 if it's not in the table
+   */
+  uint8_t lookup(const uint8_t *data, uint32_t len);
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "ArduCastTrace.h"
+
+#if ARDUCAST_TRACE
+
+static const char* const TRACE_NAMES[] = {
+  "?", "READ", "HEADER", "DISPATCH", "DISPATCHED", "JSON", "JSON_DONE", "DONE", "WRITE", "FLUSH",
+};
+
+traceRecord_t ArduCastTrace::records[TRACE_BUFFER_SIZE];
+uint16_t ArduCastTrace::head = 0;
+uint16_t ArduCastTrace::count = 0;
+bool ArduCastTrace::enabled = true;
+
+void ArduCastTrace::record(traceEvent_t event, uint8_t arg, uint32_t value){
+  if ( !enabled )
+    return;
+  traceRecord_t &r = records[head];
+  r.at = micros();
+  r.value = value;
+  r.event = event;
+  r.arg = arg;
+  if ( ++head == TRACE_BUFFER_SIZE )
+    head = 0;
+  if ( count < TRACE_BUFFER_SIZE )
+    count++;
+}
+
+void ArduCastTrace::setEnabled(bool enable){
+  enabled = enable;
+}
+
+void ArduCastTrace::clear(){
+  head = 0;
+  count = 0;
+}
+
+uint16_t ArduCastTrace::getCount(){
+  return count;
+}
+
+const traceRecord_t* ArduCastTrace::get(uint16_t index){
+  if ( index >= count )
+    return NULL;
+  uint16_t i = head + TRACE_BUFFER_SIZE - count + index;
+  if ( i >= TRACE_BUFFER_SIZE )
+    i -= TRACE_BUFFER_SIZE;
+  return &records[i];
+}
+
+void ArduCastTrace::dump(Print &out){
+  //a consistent snapshot, events recorded while printing are dropped
+  bool wasEnabled = enabled;
+  enabled = false;
+  uint32_t prev = count > 0 ? get(0)->at : 0;
+  for(uint16_t i = 0; i < count; i++){
+    const traceRecord_t *r = get(i);
+    const char *name = r->event < sizeof(TRACE_NAMES)/sizeof(TRACE_NAMES[0]) ? TRACE_NAMES[r->event] : TRACE_NAMES[0];
+    out.printf("%lu +%lu %s %u %lu\n", (unsigned long)r->at, (unsigned long)(r->at - prev), name, r->arg, (unsigned long)r->value);
+    prev = r->at;
+  }
+  enabled = wasEnabled;
+}
+
+#endif
@@ -0,0 +1,136 @@
+/**
+ * ArduCastTrace.h - Compile time trace of the hot paths of ArduCastControl
+ * https://github.com/andrasbiro/chromecastcontrol
+ */
+
+#ifndef ARDUCASTTRACE_H
+#define ARDUCASTTRACE_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+/**
+ * Set to 1 (e.g. with -DARDUCAST_TRACE=1) to record the trace events of
+ * \ref ArduCastTrace. When 0, \ref CC_TRACE() compiles to nothing, and
+ * \ref ArduCastTrace has no storage.
+ */
+#ifndef ARDUCAST_TRACE
+#define ARDUCAST_TRACE 0
+#endif
+
+/**
+ * Number of events kept by \ref ArduCastTrace, the oldest ones are
+ * overwritten. A received status message is about 10 events.
+ */
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE 128
+#endif
+
+/**
+ * Events recorded by \ref CC_TRACE()
+ */
+typedef enum traceEvent_t {
+  TRACE_FRAME_READ = 1,   ///< A frame is received, value is its length
+  TRACE_HEADER,           ///< The fields of the frame are decoded, arg is the bit mask of the fields found, value is the length
+  TRACE_DISPATCH,         ///< A payload is passed to the namespace handlers, arg is the namespace ID, value is its length
+  TRACE_DISPATCH_DONE,    ///< The namespace handlers returned
+  TRACE_JSON_PARSE,       ///< A status payload is parsed, arg is the channel (1 device, 2 application), value is its length
+  TRACE_JSON_DONE,        ///< The status is parsed and applied
+  TRACE_FRAME_DONE,       ///< The frame is processed
+  TRACE_WRITE,            ///< A message is added to the TX ring, arg is the namespace ID, value is its length
+  TRACE_FLUSH,            ///< The TX ring is written to the TCP channel, value is the bytes accepted
+} traceEvent_t;
+
+/**
+ * An event recorded by \ref ArduCastTrace
+ */
+typedef struct traceRecord_t {
+  uint32_t at;        ///< Time of the event, as \ref micros()
+  uint32_t value;
+  uint8_t event;      ///< \ref traceEvent_t
+  uint8_t arg;
+} traceRecord_t;
+
+#if ARDUCAST_TRACE
+
+/**
+ * Records an event of the library, see \ref traceEvent_t
+ */
+#define CC_TRACE(event, arg, value) ArduCastTrace::record(event, arg, value)
+
+/**
+ * Trace of the hot paths (frame read, header decode, dispatch, JSON parse,
+ * write), for profiling on the device. Events are recorded with a timestamp
+ * into a fixed size ring buffer, without heap allocation or printing, so
+ * tracing doesn't change the timing much. The ring can be dumped later,
+ * e.g. when something slow happened:
+ *
+ *     cc.loop();
+ *     if ( cc.getMetrics().parseTime.max > 10000 ){
+ *       ArduCastTrace::dump(Serial);
+ *       ...
+ *
+ * The trace is shared by all the \ref ArduCastControl instances.
+ */
+class ArduCastTrace {
+private:
+  static traceRecord_t records[TRACE_BUFFER_SIZE];
+  static uint16_t head;       ///< Next record to write
+  static uint16_t count;
+  static bool enabled;
+
+public:
+  /**
+   * Records an event, overwriting the oldest one if the ring is full
+   */
+  static void record(traceEvent_t event, uint8_t arg, uint32_t value);
+
+  /**
+   * Pauses or resumes recording, e.g. to keep the events before a problem
+   */
+  static void setEnabled(bool enable);
+
+  /**
+   * Drops all the events
+   */
+  static void clear();
+
+  /**
+   * Returns the number of events in the ring
+   */
+  static uint16_t getCount();
+
+  /**
+   * Returns an event, 0 is the oldest
+   * \return
+   *    The event or NULL if \ref index is out of range
+   */
+  static const traceRecord_t* get(uint16_t index);
+
+  /**
+   * Prints the events from the oldest, one per line:
+   * <time us> +<time since the previous event> <event> <arg> <value>
+   */
+  static void dump(Print &out);
+};
+
+#else
+
+#define CC_TRACE(event, arg, value) do {} while (0)
+
+/**
+ * Empty trace, ARDUCAST_TRACE is 0
+ */
+class ArduCastTrace {
+public:
+  static void record(traceEvent_t, uint8_t, uint32_t) {}
+  static void setEnabled(bool) {}
+  static void clear() {}
+  static uint16_t getCount() { return 0; }
+  static const traceRecord_t* get(uint16_t) { return NULL; }
+  static void dump(Print&) {}
+};
+
+#endif
+
+#endif
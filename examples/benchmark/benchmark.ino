@@ -0,0 +1,259 @@
+/**
+ * Micro-benchmark of the hot paths of ArduCastControl: protobuf decoding
+ * (the bounds checked decoder against the original unchecked one), message encoding (direct and nanopb) and JSON status decoding (both the built-in
+ * extractor and ArduinoJson).
+ * It doesn't need a chromecast or even WiFi: the messages are built from
+ * payloads recorded from a chromecast, and processed in memory.
+ * Results are printed on serial, as time per message, bytes allocated from
+ * heap per message and stack used.
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "ArduCastControl.h"
+
+#ifndef ITERATIONS
+#define ITERATIONS 200
+#endif
+
+//recorded payloads, source/destination IDs are replaced by the encoder
+static const char PONG_JSON[] PROGMEM = R"json({"type":"PONG"})json";
+
+static const char RECEIVER_STATUS_JSON[] PROGMEM = R"json({"requestId":1,"status":{"applications":[{"appId":"CC32E753","displayName":"Spotify","iconUrl":"https://lh3.googleusercontent.com/HOX9yqNu6y87Chb1lHYqhKjTQW43oFAFFe2ojx94yCLh2yMzgA0_KwcUaZhUAWzMcQOjCtyMIm_FHQsB3eS2F8ufj2UeR74Cbj3ag2o","isIdleScreen":false,"launchedFromCloud":false,"namespaces":[{"name":"urn:x-cast:com.google.cast.debugoverlay"},{"name":"urn:x-cast:com.google.cast.cac"},{"name":"urn:x-cast:com.spotify.chromecast.secure.v1"},{"name":"urn:x-cast:com.google.cast.test"},{"name":"urn:x-cast:com.google.cast.broadcast"},{"name":"urn:x-cast:com.google.cast.media"}],"sessionId":"7d5e8a5c-3f2a-4b8e-9d1c-0e6b5f4a3c2d","statusText":"Casting: Whole Lotta Love - 1990 Remaster","transportId":"7d5e8a5c-3f2a-4b8e-9d1c-0e6b5f4a3c2d","universalAppId":"CC32E753"}],"userEq":{"high_shelf":{"frequency":4500.0,"gain_db":0.0,"quality":0.707},"low_shelf":{"frequency":150.0,"gain_db":0.0,"quality":0.707},"max_peaking_eqs":0,"peaking_eqs":[]},"volume":{"controlType":"master","level":0.4000000059604645,"muted":false,"stepInterval":0.019999999552965164}},"type":"RECEIVER_STATUS"})json";
+
+static const char MEDIA_STATUS_JSON[] PROGMEM = R"json({"type":"MEDIA_STATUS","status":[{"mediaSessionId":1,"playbackRate":1,"playerState":"PLAYING","currentTime":52.713,"supportedMediaCommands":514511,"volume":{"level":1,"muted":false},"activeTrackIds":[],"media":{"contentId":"spotify:track:0hCB0YR03f6AmQaHbwWDe8","streamType":"BUFFERED","mediaCategory":"AUDIO","contentType":"application/x-spotify.track","metadata":{"metadataType":3,"title":"Whole Lotta Love - 1990 Remaster","songName":"Whole Lotta Love - 1990 Remaster","artist":"Led Zeppelin","albumName":"Led Zeppelin II (1994 Remaster)","images":[{"url":"https://i.scdn.co/image/ab67616d0000b273fc4f17340773c6c3579fea0d","height":640,"width":640},{"url":"https://i.scdn.co/image/ab67616d00001e02fc4f17340773c6c3579fea0d","height":300,"width":300},{"url":"https://i.scdn.co/image/ab67616d00004851fc4f17340773c6c3579fea0d","height":64,"width":64}]},"duration":333.893},"queueData":{"items":[{"itemId":1,"media":{"contentId":"spotify:track:0hCB0YR03f6AmQaHbwWDe8","streamType":"BUFFERED","contentType":"application/x-spotify.track","metadata":{"metadataType":3,"title":"Whole Lotta Love - 1990 Remaster","artist":"Led Zeppelin","albumName":"Led Zeppelin II (1994 Remaster)"},"duration":333.893},"autoplay":true,"startTime":0,"orderId":0},{"itemId":2,"media":{"contentId":"spotify:track:5V9lrTOR5PTVqrzTMLfFCx","streamType":"BUFFERED","contentType":"application/x-spotify.track","metadata":{"metadataType":3,"title":"What Is and What Should Never Be - 1990 Remaster","artist":"Led Zeppelin","albumName":"Led Zeppelin II (1994 Remaster)"},"duration":284.426},"autoplay":true,"startTime":0,"orderId":1},{"itemId":3,"media":{"contentId":"spotify:track:6Vjk8MNXpQpi0F4BefdTyM","streamType":"BUFFERED","contentType":"application/x-spotify.track","metadata":{"metadataType":3,"title":"The Lemon Song - 1990 Remaster","artist":"Led Zeppelin","albumName":"Led Zeppelin II (1994 Remaster)"},"duration":379.306},"autoplay":true,"startTime":0,"orderId":2},{"itemId":4,"media":{"contentId":"spotify:track:3MODES4TNtygekLl146Dxd","streamType":"BUFFERED","contentType":"application/x-spotify.track","metadata":{"metadataType":3,"title":"Thank You - 1990 Remaster","artist":"Led Zeppelin","albumName":"Led Zeppelin II (1994 Remaster)"},"duration":289.293},"autoplay":true,"startTime":0,"orderId":3}],"repeatMode":"REPEAT_OFF","shuffle":false},"currentItemId":1,"repeatMode":"REPEAT_OFF"}],"requestId":0})json";
+
+typedef struct corpus_t {
+  const char *name;
+  const char *nameSpace;
+  const char *json;       //in flash
+  char *payload;          //copied to RAM
+  uint8_t *frame;         //encoded message, including the length field
+  int frameLen;
+} corpus_t;
+
+static corpus_t corpus[] = {
+  { "PONG", "urn:x-cast:com.google.cast.tp.heartbeat", PONG_JSON, NULL, NULL, 0 },
+  { "RECEIVER_STATUS", "urn:x-cast:com.google.cast.receiver", RECEIVER_STATUS_JSON, NULL, NULL, 0 },
+  { "MEDIA_STATUS", "urn:x-cast:com.google.cast.media", MEDIA_STATUS_JSON, NULL, NULL, 0 },
+};
+
+/**
+ * Allocator for ArduinoJson, which counts the allocated bytes
+ */
+static uint32_t allocatedBytes = 0;
+struct CountingAllocator {
+  void* allocate(size_t size) {
+    allocatedBytes += size;
+    return malloc(size);
+  }
+  void deallocate(void* ptr) {
+    free(ptr);
+  }
+  void* reallocate(void* ptr, size_t size) {
+    allocatedBytes += size;
+    return realloc(ptr, size);
+  }
+};
+typedef BasicJsonDocument<CountingAllocator> CountingJsonDocument;
+
+WiFiClientSecure client; //never connected, only needed by ArduCastConnection
+uint8_t txBuffer[TXBUFFER_SIZE];
+ArduCastTxRing txRing(client, txBuffer, sizeof(txBuffer));
+ArduCastConnection connection(client, PING_TIMEOUT, txRing);
+uint8_t writeBuffer[CONNBUFFER_SIZE];
+
+/**
+ * Returns the free stack. On ESP8266, the lowest free stack since the last
+ * call to \ref stackStart()
+ */
+static uint32_t stackFree(){
+#if defined(ESP8266)
+  return ESP.getFreeContStack();
+#elif defined(ESP32)
+  return uxTaskGetStackHighWaterMark(NULL);
+#else
+  return 0;
+#endif
+}
+
+static uint32_t stackStart(){
+#if defined(ESP8266)
+  ESP.resetFreeContStack();
+#endif
+  return stackFree();
+}
+
+static void report(const char *path, const char *msg, uint32_t elapsedUs, uint32_t allocated, uint32_t stackBefore){
+  uint32_t stackAfter = stackFree();
+  Serial.printf("%-16s %-16s %8lu ns/msg %6lu B/msg %6lu B stack\n", path, msg,
+    (unsigned long)((uint64_t)elapsedUs * 1000 / ITERATIONS),
+    (unsigned long)(allocated / ITERATIONS),
+    (unsigned long)(stackBefore > stackAfter ? stackBefore - stackAfter : 0));
+}
+
+/**
+ * The original, unchecked header decoder of the library (varints up to 32
+ * bits, single byte keys), kept as the baseline of the decoder
+ */
+static uint8_t legacyDecodeVarint(const uint8_t *bufferStart, uint32_t *decodedInt){
+  *decodedInt = 0;
+  int8_t decoded = -1;
+  do {
+    decoded++;
+    *decodedInt |= (bufferStart[decoded] & 0x7f) << (decoded * 7);
+  } while ( bufferStart[decoded] & 0x80 );
+  return decoded+1;
+}
+
+static uint8_t legacyDecodeHeader(const uint8_t *bufferStart, uint8_t *tag, uint8_t *wire, uint32_t *lengthOrValue){
+  *wire = bufferStart[0] & 0x07;
+  *tag = bufferStart[0] >> 3;
+  return 1 + legacyDecodeVarint(bufferStart+1, lengthOrValue);
+}
+
+static void benchDecodeLegacy(corpus_t &c){
+  volatile uint32_t sink = 0;
+  castMsgIndex_t index;
+  uint32_t stackBefore = stackStart();
+  uint32_t heapBefore = ESP.getFreeHeap();
+  unsigned long start = micros();
+  for(int i = 0; i < ITERATIONS; i++){
+    //collect the same as pbIndexMessage(), which the original loop() used right away
+    uint32_t offset = 4;
+    index.found = 0;
+    do {
+      uint8_t tag, wire;
+      uint32_t lengthOrValue;
+      offset += legacyDecodeHeader(c.frame+offset, &tag, &wire, &lengthOrValue);
+      if ( tag < CAST_MSG_FIELDS ){
+        index.fields[tag].offset = offset;
+        index.fields[tag].len = lengthOrValue;
+        index.found |= 1 << tag;
+      }
+      if ( wire == 2 )
+        offset += lengthOrValue;
+    } while ( offset < (uint32_t)c.frameLen );
+    sink += index.found;
+  }
+  unsigned long elapsed = micros() - start;
+  uint32_t heapAfter = ESP.getFreeHeap();
+  report("legacyDecode", c.name, elapsed, heapBefore > heapAfter ? heapBefore - heapAfter : 0, stackBefore);
+}
+
+static void benchIndexMessage(corpus_t &c){
+  volatile uint32_t sink = 0;
+  castMsgIndex_t index;
+  uint32_t stackBefore = stackStart();
+  uint32_t heapBefore = ESP.getFreeHeap();
+  unsigned long start = micros();
+  for(int i = 0; i < ITERATIONS; i++){
+    if ( ArduCastControl::pbIndexMessage(c.frame+4, c.frameLen-4, false, &index) == 0 )
+      sink += index.found;
+  }
+  unsigned long elapsed = micros() - start;
+  uint32_t heapAfter = ESP.getFreeHeap();
+  report("pbIndexMessage", c.name, elapsed, heapBefore > heapAfter ? heapBefore - heapAfter : 0, stackBefore);
+}
+
+static void benchEncode(corpus_t &c){
+  uint32_t stackBefore = stackStart();
+  uint32_t heapBefore = ESP.getFreeHeap();
+  unsigned long start = micros();
+  for(int i = 0; i < ITERATIONS; i++){
+    connection.encodeMsg(writeBuffer, sizeof(writeBuffer), c.nameSpace, c.payload);
+  }
+  unsigned long elapsed = micros() - start;
+  uint32_t heapAfter = ESP.getFreeHeap();
+  report("encodeMsg", c.name, elapsed, heapBefore > heapAfter ? heapBefore - heapAfter : 0, stackBefore);
+}
+
+static void benchEncodePb(corpus_t &c){
+  uint32_t stackBefore = stackStart();
+  uint32_t heapBefore = ESP.getFreeHeap();
+  unsigned long start = micros();
+  for(int i = 0; i < ITERATIONS; i++){
+    connection.encodeMsgPb(writeBuffer, sizeof(writeBuffer), c.nameSpace, c.payload);
+  }
+  unsigned long elapsed = micros() - start;
+  uint32_t heapAfter = ESP.getFreeHeap();
+  report("encodeMsgPb", c.name, elapsed, heapBefore > heapAfter ? heapBefore - heapAfter : 0, stackBefore);
+}
+
+static void benchExtractor(corpus_t &c){
+  castStatus_t status;
+  uint32_t stackBefore = stackStart();
+  uint32_t heapBefore = ESP.getFreeHeap();
+  unsigned long start = micros();
+  for(int i = 0; i < ITERATIONS; i++){
+    jsonExtractStatus((const uint8_t*)c.payload, strlen(c.payload), &status);
+  }
+  unsigned long elapsed = micros() - start;
+  uint32_t heapAfter = ESP.getFreeHeap();
+  report("jsonExtract", c.name, elapsed, heapBefore > heapAfter ? heapBefore - heapAfter : 0, stackBefore);
+}
+
+static void benchArduinoJson(corpus_t &c){
+  volatile float sink = 0;
+  uint32_t stackBefore = stackStart();
+  allocatedBytes = 0;
+  unsigned long start = micros();
+  for(int i = 0; i < ITERATIONS; i++){
+    CountingJsonDocument doc(JSONBUFFER_SIZE);
+    if ( deserializeJson(doc, c.payload, strlen(c.payload)) )
+      continue;
+    //the same lookups the library used to do
+    sink += doc["status"]["volume"]["level"].as<float>();
+    sink += doc["status"][0]["currentTime"].as<float>();
+    sink += doc["status"][0]["media"]["duration"].as<float>();
+  }
+  unsigned long elapsed = micros() - start;
+  report("ArduinoJson", c.name, elapsed, allocatedBytes, stackBefore);
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println();
+  Serial.println("booted");
+
+  //destination is only stored, CONNECT fails as the client is not connected
+  connection.connect("receiver-0");
+
+  for(uint8_t i = 0; i < sizeof(corpus)/sizeof(corpus[0]); i++){
+    corpus_t &c = corpus[i];
+    c.payload = (char*)malloc(strlen_P(c.json) + 1);
+    strcpy_P(c.payload, c.json);
+    c.frameLen = connection.encodeMsg(writeBuffer, sizeof(writeBuffer), c.nameSpace, c.payload);
+    c.frame = (uint8_t*)malloc(c.frameLen);
+    memcpy(c.frame, writeBuffer, c.frameLen);
+    Serial.printf("%s: %d B message\n", c.name, c.frameLen);
+    //the new decoder must find the same fields
+    castMsgIndex_t index;
+    if ( ArduCastControl::pbIndexMessage(c.frame+4, c.frameLen-4, false, &index) != 0 || index.found != 0x7E )
+      Serial.printf("%s: pbIndexMessage failed!\n", c.name);
+    //the direct encoder must produce the same bytes as nanopb
+    if ( connection.encodeMsgPb(writeBuffer, sizeof(writeBuffer), c.nameSpace, c.payload) != c.frameLen || memcmp(c.frame, writeBuffer, c.frameLen) != 0 )
+      Serial.printf("%s: encodeMsg and encodeMsgPb mismatch!\n", c.name);
+  }
+
+  for(uint8_t i = 0; i < sizeof(corpus)/sizeof(corpus[0]); i++){
+    benchDecodeLegacy(corpus[i]);
+    yield();
+    benchIndexMessage(corpus[i]);
+    yield();
+    benchEncode(corpus[i]);
+    yield();
+    benchEncodePb(corpus[i]);
+    yield();
+    if ( i > 0 ){ //no status in PONG
+      benchExtractor(corpus[i]);
+      yield();
+      benchArduinoJson(corpus[i]);
+      yield();
+    }
+  }
+  Serial.println("done");
+}
+
+void loop() {
+}
@@ -0,0 +1,84 @@
+/**
+ * Capture and replay of the chromecast traffic, e.g. to reproduce a field
+ * problem or to benchmark the library against real traffic.
+ * Built normally, it connects to the chromecast and records the traffic of
+ * the first minute to /capture.bin on LittleFS. Built with ARDUCAST_REPLAY
+ * defined (e.g. build_flags = -DARDUCAST_REPLAY in platformio.ini), it
+ * replays /capture.bin to the library at 10x speed, without WiFi, and
+ * prints the metrics.
+ */
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "ArduCastControl.h"
+
+#define CHROMECASTIP "192.168.1.12"
+#define CAPTURE_FILE "/capture.bin"
+#define CAPTURE_TIME 60000
+#define REPLAY_SPEED 10
+
+ArduCastControl cc = ArduCastControl();
+File file;
+
+#ifndef ARDUCAST_REPLAY
+#include <ESP8266WiFi.h>
+
+ArduCastCapture *capture = NULL;
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("booted");
+  LittleFS.begin();
+  file = LittleFS.open(CAPTURE_FILE, "w");
+  capture = new ArduCastCapture(file);
+  cc.setCapture(capture);
+}
+
+void loop() {
+  if ( millis() > CAPTURE_TIME ){
+    if ( file ){
+      cc.setCapture(NULL);
+      file.close();
+      Serial.println("Capture done");
+    }
+    return;
+  }
+  if ( WiFi.status() != WL_CONNECTED )
+    return;
+  if ( cc.getConnection() == DISCONNECTED ){
+    Serial.print("Connecting...");
+    Serial.println(cc.connect(CHROMECASTIP));
+  }
+  cc.loop();
+  delay(50);
+}
+
+#else
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("booted");
+  LittleFS.begin();
+  file = LittleFS.open(CAPTURE_FILE, "r");
+  if ( !cc.getClient().begin(file, REPLAY_SPEED) ){
+    Serial.println("No capture");
+    return;
+  }
+  cc.connect("replay");
+  unsigned long start = millis();
+  while ( cc.loop() != DISCONNECTED ){
+    if ( cc.getDirty() ){
+      cc.dumpStatus();
+      cc.clearDirty();
+    }
+    yield();
+  }
+  Serial.printf("Replayed %u frames in %lums\n", cc.getClient().getFrames(), millis() - start);
+  cc.dumpMetrics();
+  file.close();
+}
+
+void loop() {
+}
+
+#endif
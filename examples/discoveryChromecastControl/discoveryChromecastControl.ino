@@ -0,0 +1,67 @@
+/**
+ * This example finds the chromecasts on the network with mDNS, lists them on
+ * serial, and connects to one by its friendly name instead of a fixed IP
+ * address. Tested on ESP8266, should work on ESP32 too.
+ * Current status gathered from chromecast will be printed on serial.
+ */
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <ArduinoOTA.h>
+#include "ArduCastControl.h"
+#include "ArduCastDiscovery.h"
+
+#define CHROMECASTNAME "Living Room"
+
+ArduCastDiscovery discovery = ArduCastDiscovery();
+ArduCastControl cc = ArduCastControl();
+bool discoveryStarted = false;
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("booted");
+
+  ArduinoOTA.setHostname ("chromecastremote");
+  ArduinoOTA.begin();
+
+  //back-off between the connection attempts, the address is taken from the
+  //cache on each attempt below, so it's followed even if it changes
+  cc.setAutoReconnect(true);
+}
+
+uint8_t lastCount = 0;
+
+void loop() {
+  ArduinoOTA.handle();
+  //wait for 5s to boot - this is useful in case of a bootloop to keep OTA running
+  if ( millis() < 10000 )
+    return;
+
+  if ( !discoveryStarted ){
+    discoveryStarted = discovery.begin() == 0;
+    return;
+  }
+
+  uint8_t count = discovery.loop();
+  if ( count != lastCount ){
+    Serial.printf("%d chromecast(s) found\n", count);
+    for(uint8_t i = 0; i < count; i++){
+      const castDevice_t *d = discovery.getDevice(i);
+      Serial.printf("  %s (%s) at %s:%d\n", d->name, d->model, d->host, d->port);
+    }
+    lastCount = count;
+  }
+
+  if ( cc.getConnection() == DISCONNECTED && cc.getSleepTime() == 0 ){
+    //connect when the back-off of the automatic reconnection allows it, with
+    //the address from the cache
+    if ( discovery.connect(cc, CHROMECASTNAME) == 0 )
+      Serial.println("Connected to " CHROMECASTNAME);
+  }
+  cc.loop();
+  if ( cc.getDirty() ){
+    cc.dumpStatus();
+    cc.clearDirty();
+  }
+  delay(10);
+}
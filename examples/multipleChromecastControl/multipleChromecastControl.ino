@@ -0,0 +1,56 @@
+/**
+ * This example controls multiple chromecasts with one ArduCastHub.
+ * Status of each device will be printed on serial, and the button on D5
+ * pauses/resumes all of them.
+ */
+
+#include <Arduino.h>
+#include "ArduCastHub.h"
+
+#define B_SELECT D5
+
+const char* hosts[] = {"192.168.1.12", "192.168.1.13", "192.168.1.14"};
+#define DEVICES (sizeof(hosts)/sizeof(hosts[0]))
+
+ArduCastHub hub;
+ArduCastControl kitchen(hub.getBuffer());
+ArduCastControl livingRoom(hub.getBuffer());
+ArduCastControl bedroom(hub.getBuffer());
+
+bool bSelectPressed = false;
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("booted");
+
+  pinMode(D8, OUTPUT); //common pin for keys, used for pulldown - should have a pulldown anyway
+  pinMode(B_SELECT, INPUT_PULLUP);
+
+  hub.add(kitchen, hosts[0]);
+  hub.add(livingRoom, hosts[1]);
+  hub.add(bedroom, hosts[2]);
+}
+
+uint32_t lastDump = 0;
+
+void loop() {
+  uint8_t connected = hub.loop();
+
+  if ( millis() - lastDump > 5000 ){
+    Serial.printf("%d/%d connected\n", connected, hub.getDeviceCount());
+    for(uint8_t i = 0; i < hub.getDeviceCount(); i++){
+      hub.getDevice(i)->dumpStatus();
+    }
+    lastDump = millis();
+  }
+
+  bool prevSelect = bSelectPressed;
+  bSelectPressed = digitalRead(B_SELECT) == LOW;
+  if ( !bSelectPressed && prevSelect ){ //select released
+    for(uint8_t i = 0; i < hub.getDeviceCount(); i++){
+      if ( hub.getDevice(i)->getConnection() == APPLICATION_RUNNING )
+        hub.getDevice(i)->pause(true);
+    }
+  }
+  delay(10);
+}
@@ -3,9 +3,12 @@
  * but should work on any ESP8266 (and probably ESP32)
  * Current status gathered from chromecast will be printed on serial.
  * Buttons on D5/D6/D7 will act as pause/prev/next respectively
+ * cc.loop() is only called when the library has something to do (see
+ * getSleepTime()), and the ESP sleeps in between.
  */
 
 #include <Arduino.h>
+#include <ESP8266WiFi.h>
 #include <ArduinoOTA.h>
 #include "ArduCastControl.h"
 
@@ -30,10 +33,16 @@ void setup() {
   pinMode(B_SELECT, INPUT_PULLUP);
   pinMode(B_LEFT, INPUT_PULLUP);
   pinMode(B_RIGHT, INPUT_PULLUP);
+
+  //let the modem sleep in delay()
+  WiFi.setSleepMode(WIFI_LIGHT_SLEEP);
+  //rely on the status pushed by chromecast, so loop() has nothing to do
+  //most of the time
+  cc.setPushMode(true);
 }
 
-uint32_t lastUpdated = 0;
-uint32_t updatePeriod = 5000;
+uint32_t lastConnect = 0;
+uint32_t connectPeriod = 5000;
 
 uint32_t bLastUpdated = 0;
 uint32_t bUpdatePeriod = 25;
@@ -45,30 +54,22 @@ void loop() {
     return;
     
 
-  if ( millis() - lastUpdated > updatePeriod ) {
-    if ( cc.getConnection() != WAIT_FOR_RESPONSE ){
-      cc.dumpStatus();
-    }
-    int st;
-
-    if ( cc.getConnection() == DISCONNECTED ){
+  if ( cc.getConnection() == DISCONNECTED ){
+    if ( millis() - lastConnect >= connectPeriod ){
       Serial.print("Connecting...");
-      st = cc.connect(CHROMECASTIP);
+      int st = cc.connect(CHROMECASTIP);
       Serial.println(st);
-    } else {
-      //at this point, cc.volume and cc.isMuted should be valid 
-      connection_t c = cc.loop();
-      if ( c == WAIT_FOR_RESPONSE || c == CONNECT_TO_APPLICATION ){
-        updatePeriod = 50; 
-      } else if ( c == APPLICATION_RUNNING ){
-        updatePeriod = 500;
-        //at this point, all public fields describing the casting
-        //(e.g. cc.artist, cc.title) should be valid
-      } else {
-        updatePeriod = 5000;
-      }
+      lastConnect = millis();
+    }
+  } else if ( cc.getSleepTime() == 0 ){ //something to do, or a message arrived
+    //at this point, cc.volume and cc.isMuted should be valid 
+    //and if an application is running, all public fields describing the
+    //casting (e.g. cc.artist, cc.title) should be valid
+    cc.loop();
+    if ( cc.getDirty() ){
+      cc.dumpStatus();
+      cc.clearDirty();
     }
-    lastUpdated = millis();
   }
   if ( millis() - bLastUpdated > bUpdatePeriod && cc.getConnection() == APPLICATION_RUNNING ){
     bool prevSelect = bSelectPressed;
@@ -92,4 +93,14 @@ void loop() {
 
     bLastUpdated = millis();
   }
+
+  //sleep until the library has something to do. Messages arriving in the
+  //meantime are only noticed after the sleep, so wake up for the buttons
+  //(and the responses of the commands) if something is casting
+  uint32_t sleep = cc.getSleepTime();
+  if ( cc.getConnection() == DISCONNECTED )
+    sleep = connectPeriod;
+  if ( cc.getConnection() == APPLICATION_RUNNING && sleep > bUpdatePeriod )
+    sleep = bUpdatePeriod;
+  delay(sleep);
 }
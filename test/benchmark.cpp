@@ -0,0 +1,270 @@
+/**
+ * Time, heap and stack used by the hot paths of the library for each
+ * recorded CastMessage of a corpus, off-device:
+ *  - the field index of the protobuf decoder (pbIndexMessage)
+ *  - loop() processing the whole frame (framing, decoding, JSON, dispatch)
+ *  - the encoders, direct and nanopb, sending the same message back
+ *  - the JSON status extractor on the payload
+ *
+ * Heap: malloc() and friends are wrapped at link time (--wrap) and the
+ * global operator new is replaced to go through them, so every allocation
+ * of the process is counted. Stack: a large area below the caller is
+ * painted with a pattern before the path runs once, the deepest byte
+ * overwritten gives its peak usage.
+ *
+ * Only relative numbers (before and after a change) are meaningful, the host
+ * CPU is not the ESP.
+ *
+ *   benchmark [corpus] [iterations]
+ */
+
+#include "cast_test.h"
+
+#include <dirent.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+
+//------------------------------------------------------------------- heap
+
+static uint64_t heapBytes = 0;
+
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size){
+  heapBytes += size;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size){
+  heapBytes += count * size;
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size){
+  heapBytes += size;
+  return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr){
+  __real_free(ptr);
+}
+}
+
+//operator new of libstdc++ calls malloc() from the shared library, which
+//isn't wrapped, so it's replaced by one calling the wrapped malloc()
+void* operator new(size_t size){
+  void *ptr = malloc(size ? size : 1);
+  if ( ptr == NULL )
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new[](size_t size){
+  return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+  free(ptr);
+}
+
+//------------------------------------------------------------------ stack
+
+static const size_t STACK_PAINTED = 64 * 1024;
+static const uint8_t STACK_PATTERN = 0xA5;
+static uintptr_t paintedLow = 0;   //lowest address of the painted area
+
+/**
+ * Fills \ref STACK_PAINTED bytes below the caller's frame with
+ * \ref STACK_PATTERN
+ */
+__attribute__((noinline)) static void paintStack(){
+  uint8_t area[STACK_PAINTED];
+  memset(area, STACK_PATTERN, sizeof(area));
+  paintedLow = (uintptr_t)area;
+  __asm__ volatile("" : : "r"(area) : "memory");
+}
+
+/**
+ * Returns the bytes used below \ref top since \ref paintStack()
+ */
+__attribute__((noinline)) static uint32_t stackUsedBelow(uintptr_t top){
+  const volatile uint8_t *area = (const volatile uint8_t*)paintedLow;
+  size_t untouched = 0;
+  while ( untouched < STACK_PAINTED && area[untouched] == STACK_PATTERN )
+    untouched++;
+  return top - (paintedLow + untouched);
+}
+
+//------------------------------------------------------------------ paths
+
+typedef struct benchFrame_t {
+  std::string name;
+  std::vector<uint8_t> frame;   ///< Including the length field
+  castFrame_t msg;              ///< Decoded by the test helper, for the encoders
+} benchFrame_t;
+
+typedef void (*benchPath_t)(const benchFrame_t &f);
+
+static ArduCastControl cc;
+static WiFiClientSecure client; //never connected, only needed by the encoders
+static uint8_t txBuffer[TXBUFFER_SIZE];
+static ArduCastTxRing txRing(client, txBuffer, sizeof(txBuffer));
+static ArduCastConnection connection(client, PING_TIMEOUT, txRing);
+static uint8_t writeBuffer[CONNBUFFER_SIZE];
+static volatile uint32_t sink;  //keeps the results of the paths alive
+
+static void pathNone(const benchFrame_t &){
+}
+
+static void pathIndex(const benchFrame_t &f){
+  castMsgIndex_t index;
+  sink = ArduCastControl::pbIndexMessage(f.frame.data() + 4, f.frame.size() - 4, false, &index);
+  sink = index.found;
+}
+
+static void pathLoop(const benchFrame_t &f){
+  //into the capacity left by the previous frames, the shim doesn't allocate
+  cc.client.rx.assign(f.frame.begin(), f.frame.end());
+  cc.client.rxPos = 0;
+  cc.client.rxReleased = 0;
+  cc.client.tx.clear();
+  cc.loop();
+}
+
+static void pathEncode(const benchFrame_t &f){
+  sink = connection.encodeMsg(writeBuffer, sizeof(writeBuffer), f.msg.nameSpace.c_str(), f.msg.payload.c_str());
+}
+
+static void pathEncodePb(const benchFrame_t &f){
+  sink = connection.encodeMsgPb(writeBuffer, sizeof(writeBuffer), f.msg.nameSpace.c_str(), f.msg.payload.c_str());
+}
+
+static void pathJson(const benchFrame_t &f){
+  castStatus_t status;
+  sink = jsonExtractStatus((const uint8_t*)f.msg.payload.data(), f.msg.payload.size(), &status);
+  sink = status.found;
+}
+
+/**
+ * Returns the peak stack usage of \ref path, including the frame of
+ * \ref peakStack() below the call
+ */
+__attribute__((noinline)) static uint32_t peakStack(benchPath_t path, const benchFrame_t &f){
+  uintptr_t top = (uintptr_t)__builtin_frame_address(0);
+  paintStack();
+  path(f);
+  return stackUsedBelow(top);
+}
+
+/**
+ * Runs \ref path \ref iterations times on \ref f, prints the time, the heap
+ * allocated per frame and the peak stack
+ * \return
+ *    The bytes allocated
+ */
+static uint64_t measure(const char *pathName, benchPath_t path, const benchFrame_t &f, uint32_t iterations, uint32_t stackBase){
+  path(f); //warm up, e.g. the first use of a message prefix
+
+  uint64_t heapBefore = heapBytes;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(uint32_t i = 0; i < iterations; i++)
+    path(f);
+  std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+  uint64_t allocated = heapBytes - heapBefore;
+  uint32_t stack = peakStack(path, f) - stackBase;
+
+  printf("%-16s %-18s %9.1f ns/frame %8.1f B/frame %6u B stack\n", f.name.c_str(), pathName,
+    (double)elapsed.count() / iterations, (double)allocated / iterations, stack);
+  return allocated;
+}
+
+static std::vector<benchFrame_t> readCorpus(const char *dir){
+  std::vector<std::string> names;
+  DIR *d = opendir(dir);
+  CHECK(d != NULL);
+  struct dirent *entry;
+  while ( (entry = readdir(d)) != NULL ){
+    if ( entry->d_name[0] != '.' )
+      names.push_back(entry->d_name);
+  }
+  closedir(d);
+  std::sort(names.begin(), names.end());
+
+  std::vector<benchFrame_t> corpus;
+  for(size_t i = 0; i < names.size(); i++){
+    FILE *file = fopen((std::string(dir) + "/" + names[i]).c_str(), "rb");
+    CHECK(file != NULL);
+    benchFrame_t f;
+    f.name = names[i].substr(0, names[i].rfind('.'));
+    f.frame.resize(4);
+    int c;
+    while ( (c = fgetc(file)) != EOF )
+      f.frame.push_back(c);
+    fclose(file);
+    uint32_t len = f.frame.size() - 4;
+    f.frame[0] = len >> 24;
+    f.frame[1] = len >> 16;
+    f.frame[2] = len >> 8;
+    f.frame[3] = len;
+    CHECK(decodeFrame(f.frame.data() + 4, len, &f.msg));
+    corpus.push_back(f);
+  }
+  return corpus;
+}
+
+int main(int argc, char **argv){
+  const char *dir = argc > 1 ? argv[1] : "corpus/bench";
+  uint32_t iterations = argc > 2 ? atoi(argv[2]) : 20000;
+  std::vector<benchFrame_t> corpus = readCorpus(dir);
+  CHECK(corpus.size() > 0 && iterations > 0);
+
+  //the recorded RECEIVER_STATUS starts the application, so loop() processes
+  //its MEDIA_STATUS as a connected sender would
+  CHECK(cc.connect("192.168.1.12") == 0);
+  for(int pass = 0; pass < 2; pass++){
+    for(size_t i = 0; i < corpus.size(); i++){
+      pathLoop(corpus[i]);
+      for(int k = 0; k < 3; k++)
+        cc.loop();
+    }
+  }
+  connection.connect("receiver-0");
+
+  uint32_t stackBase = peakStack(pathNone, corpus[0]);
+  uint64_t allocated = 0;
+  for(size_t i = 0; i < corpus.size(); i++){
+    const benchFrame_t &f = corpus[i];
+    castMsgIndex_t index;
+    CHECK(ArduCastControl::pbIndexMessage(f.frame.data() + 4, f.frame.size() - 4, false, &index) == 0);
+    allocated += measure("pbIndexMessage", pathIndex, f, iterations, stackBase);
+    allocated += measure("loop", pathLoop, f, iterations, stackBase);
+    allocated += measure("encodeMsg", pathEncode, f, iterations, stackBase);
+    allocated += measure("encodeMsgPb", pathEncodePb, f, iterations, stackBase);
+    allocated += measure("jsonExtractStatus", pathJson, f, iterations, stackBase);
+  }
+
+  const castMetrics_t &metrics = cc.getMetrics();
+  CHECK(metrics.framesMalformed == 0 && metrics.framesTruncated == 0 && metrics.parseErrors == 0);
+  CHECK(cc.getConnection() == APPLICATION_RUNNING);
+  //the hot paths work in the buffers and the arena, never on the heap
+  CHECK(allocated == 0);
+  return 0;
+}
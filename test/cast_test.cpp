@@ -0,0 +1,45 @@
+#include "cast_test.h"
+
+const char SESSION_ID[] = "7d5e8a5c-1234-4a3b-9f00-aabbccddeeff";
+
+const char RECEIVER_STATUS[] = "{\"requestId\":1,\"status\":{\"applications\":[{\"appId\":\"CC32E753\","
+  "\"displayName\":\"Spotify\",\"iconUrl\":\"https://x\",\"isIdleScreen\":false,\"launchedFromCloud\":false,"
+  "\"namespaces\":[{\"name\":\"urn:x-cast:com.google.cast.media\"},{\"name\":\"urn:x-cast:com.spotify.chromecast.secure.v1\"}],"
+  "\"sessionId\":\"7d5e8a5c-1234-4a3b-9f00-aabbccddeeff\",\"statusText\":\"Casting: Whole \\\"Lotta\\\" Love \\u00e9\\ud83d\\ude00\","
+  "\"transportId\":\"7d5e8a5c\",\"universalAppId\":\"CC32E753\"}],\"userEq\":{},"
+  "\"volume\":{\"controlType\":\"master\",\"level\":0.4000000059604645,\"muted\":false,\"stepInterval\":0.05}},\"type\":\"RECEIVER_STATUS\"}";
+
+std::string mediaStatus(int requestId, const char *playerState, float currentTime){
+  char buffer[600];
+  snprintf(buffer, sizeof(buffer), "{\"type\":\"MEDIA_STATUS\",\"status\":[{\"mediaSessionId\":3,\"playbackRate\":1,"
+    "\"playerState\":\"%s\",\"currentTime\":%f,\"media\":{\"metadata\":{\"title\":\"T\",\"artist\":\"A\"},"
+    "\"duration\":333.89}}],\"requestId\":%d}", playerState, currentTime, requestId);
+  return buffer;
+}
+
+void feed(ArduCastControl &cc, const std::vector<uint8_t> &frame){
+  cc.client.rx.insert(cc.client.rx.end(), frame.begin(), frame.end());
+}
+
+std::vector<std::string> sentPayloads(ArduCastControl &cc){
+  std::vector<std::string> payloads;
+  std::vector<castFrame_t> frames = decodeFrames(cc.client.tx);
+  for(size_t i = 0; i < frames.size(); i++)
+    payloads.push_back(frames[i].payload);
+  return payloads;
+}
+
+void joinApplication(ArduCastControl &cc){
+  CHECK(cc.connect("1.2.3.4") == 0);
+  feed(cc, castFrame("receiver-0", CC_NS_RECEIVER, RECEIVER_STATUS));
+  for(int i = 0; i < 5; i++){
+    cc.loop();
+    hostAdvance(600);
+  }
+  feed(cc, castFrame(SESSION_ID, CC_NS_MEDIA, mediaStatus(1)));
+  for(int i = 0; i < 3; i++){
+    cc.loop();
+    hostAdvance(600);
+  }
+  CHECK(cc.mediaSessionId == 3);
+}
@@ -0,0 +1,65 @@
+/**
+ * cast_test.h - Helpers of the host tests
+ * https://github.com/andrasbiro/chromecastcontrol
+ */
+
+#ifndef CAST_TEST_H
+#define CAST_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <string>
+#include <vector>
+
+//the tests check the internal state of the library too
+#define private public
+#include "ArduCastControl.h"
+#undef private
+
+#include "CastFrame.h"
+#include "FakeReceiver.h"
+
+/**
+ * Fails the test if \ref cond is false, also in release builds
+ */
+#define CHECK(cond) do { \
+    if ( !(cond) ){ \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      exit(1); \
+    } \
+  } while (0)
+
+/**
+ * Session ID of the application in \ref RECEIVER_STATUS
+ */
+extern const char SESSION_ID[];
+
+/**
+ * RECEIVER_STATUS with Spotify running, recorded from a chromecast
+ */
+extern const char RECEIVER_STATUS[];
+
+/**
+ * Returns a MEDIA_STATUS of the application of \ref RECEIVER_STATUS, title
+ * "T", artist "A", media session 3
+ */
+std::string mediaStatus(int requestId, const char *playerState = "PLAYING", float currentTime = 12.5);
+
+/**
+ * Queues a frame to be read by the library
+ */
+void feed(ArduCastControl &cc, const std::vector<uint8_t> &frame);
+
+/**
+ * Returns the payloads written by the library, in order
+ */
+std::vector<std::string> sentPayloads(ArduCastControl &cc);
+
+/**
+ * Connects \ref cc, and feeds the status messages, until the application
+ * of \ref RECEIVER_STATUS is joined and its media status is known
+ */
+void joinApplication(ArduCastControl &cc);
+
+#endif
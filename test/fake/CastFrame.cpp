@@ -0,0 +1,154 @@
+#include "CastFrame.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void frameVarint(std::vector<uint8_t> &out, uint64_t value){
+  do {
+    uint8_t b = value & 0x7f;
+    value >>= 7;
+    if ( value )
+      b |= 0x80;
+    out.push_back(b);
+  } while ( value );
+}
+
+void frameString(std::vector<uint8_t> &out, uint32_t tag, const std::string &value){
+  frameVarint(out, (tag << 3) | 2);
+  frameVarint(out, value.size());
+  out.insert(out.end(), value.begin(), value.end());
+}
+
+std::vector<uint8_t> encodeFrame(const castFrame_t &frame){
+  std::vector<uint8_t> body;
+  frameVarint(body, (1 << 3) | 0);
+  frameVarint(body, 0); //CASTV2_1_0
+  frameString(body, 2, frame.source);
+  frameString(body, 3, frame.destination);
+  frameString(body, 4, frame.nameSpace);
+  frameVarint(body, (5 << 3) | 0);
+  frameVarint(body, frame.binary ? 1 : 0);
+  frameString(body, frame.binary ? 7 : 6, frame.payload);
+
+  std::vector<uint8_t> out;
+  uint32_t len = body.size();
+  out.push_back(len >> 24);
+  out.push_back(len >> 16);
+  out.push_back(len >> 8);
+  out.push_back(len);
+  out.insert(out.end(), body.begin(), body.end());
+  return out;
+}
+
+std::vector<uint8_t> castFrame(const std::string &source, const std::string &nameSpace,
+  const std::string &payload, const std::string &destination){
+  castFrame_t frame;
+  frame.source = source;
+  frame.destination = destination;
+  frame.nameSpace = nameSpace;
+  frame.payload = payload;
+  return encodeFrame(frame);
+}
+
+static bool readVarint(const uint8_t *&p, const uint8_t *end, uint64_t *value){
+  *value = 0;
+  for(int shift = 0; shift < 64 && p < end; shift += 7){
+    uint8_t b = *p++;
+    *value |= (uint64_t)(b & 0x7f) << shift;
+    if ( (b & 0x80) == 0 )
+      return true;
+  }
+  return false;
+}
+
+bool decodeFrame(const uint8_t *buffer, size_t len, castFrame_t *frame){
+  const uint8_t *p = buffer;
+  const uint8_t *end = buffer + len;
+  *frame = castFrame_t();
+  while ( p < end ){
+    uint64_t key, value;
+    if ( !readVarint(p, end, &key) )
+      return false;
+    switch ( key & 7 ){
+      case 0:
+        if ( !readVarint(p, end, &value) )
+          return false;
+        if ( (key >> 3) == 5 )
+          frame->binary = value == 1;
+        break;
+      case 2: {
+        if ( !readVarint(p, end, &value) || value > (uint64_t)(end - p) )
+          return false;
+        std::string s((const char*)p, value);
+        p += value;
+        switch ( key >> 3 ){
+          case 2: frame->source = s; break;
+          case 3: frame->destination = s; break;
+          case 4: frame->nameSpace = s; break;
+          case 6: case 7: frame->payload = s; break;
+        }
+        break;
+      }
+      case 1:
+        if ( end - p < 8 )
+          return false;
+        p += 8;
+        break;
+      case 5:
+        if ( end - p < 4 )
+          return false;
+        p += 4;
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+std::vector<castFrame_t> decodeFrames(const std::vector<uint8_t> &stream){
+  std::vector<castFrame_t> frames;
+  size_t pos = 0;
+  while ( pos + 4 <= stream.size() ){
+    uint32_t len = ((uint32_t)stream[pos] << 24) | ((uint32_t)stream[pos+1] << 16) | ((uint32_t)stream[pos+2] << 8) | stream[pos+3];
+    if ( stream.size() - pos - 4 < len )
+      break;
+    castFrame_t frame;
+    if ( decodeFrame(&stream[pos+4], len, &frame) )
+      frames.push_back(frame);
+    pos += 4 + len;
+  }
+  return frames;
+}
+
+/**
+ * Returns the position of the value of \ref key, after the colon and spaces
+ */
+static size_t findValue(const std::string &json, const char *key){
+  std::string quoted = std::string("\"") + key + "\"";
+  size_t at = json.find(quoted);
+  if ( at == std::string::npos )
+    return at;
+  at += quoted.size();
+  while ( at < json.size() && (json[at] == ' ' || json[at] == ':') )
+    at++;
+  return at < json.size() ? at : std::string::npos;
+}
+
+std::string jsonField(const std::string &json, const char *key){
+  size_t at = findValue(json, key);
+  if ( at == std::string::npos || json[at] != '"' )
+    return "";
+  size_t end = json.find('"', at + 1);
+  return end == std::string::npos ? "" : json.substr(at + 1, end - at - 1);
+}
+
+double jsonNumber(const std::string &json, const char *key, double missing){
+  size_t at = findValue(json, key);
+  if ( at == std::string::npos )
+    return missing;
+  const char *start = json.c_str() + at;
+  char *end;
+  double value = strtod(start, &end);
+  return end == start ? missing : value;
+}
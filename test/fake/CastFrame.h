@@ -0,0 +1,72 @@
+/**
+ * CastFrame.h - Builds and parses CASTV2 frames for the host tests
+ * https://github.com/andrasbiro/chromecastcontrol
+ *
+ * Written independently of the library's encoder and decoder, so the tests
+ * don't check the library against itself.
+ */
+
+#ifndef CASTFRAME_H
+#define CASTFRAME_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * A CastMessage
+ */
+typedef struct castFrame_t {
+  std::string source;
+  std::string destination;
+  std::string nameSpace;
+  std::string payload;
+  bool binary = false;        ///< payload_binary instead of payload_utf8
+} castFrame_t;
+
+/**
+ * Appends a varint to \ref out
+ */
+void frameVarint(std::vector<uint8_t> &out, uint64_t value);
+
+/**
+ * Appends a length delimited field to \ref out
+ */
+void frameString(std::vector<uint8_t> &out, uint32_t tag, const std::string &value);
+
+/**
+ * Encodes a frame, including the 4 byte length field
+ */
+std::vector<uint8_t> encodeFrame(const castFrame_t &frame);
+
+/**
+ * Shortcut of \ref encodeFrame() for a text message
+ */
+std::vector<uint8_t> castFrame(const std::string &source, const std::string &nameSpace,
+  const std::string &payload, const std::string &destination = "sender-0");
+
+/**
+ * Decodes a CastMessage, without the length field
+ * \return
+ *    False if it's malformed
+ */
+bool decodeFrame(const uint8_t *buffer, size_t len, castFrame_t *frame);
+
+/**
+ * Splits a stream of frames (e.g. everything written by the library) into
+ * messages. A partial frame at the end is ignored.
+ */
+std::vector<castFrame_t> decodeFrames(const std::vector<uint8_t> &stream);
+
+/**
+ * Returns the value of a string field of a JSON payload, e.g. "type", or ""
+ * if it's not found. Only for the flat messages written by the library.
+ */
+std::string jsonField(const std::string &json, const char *key);
+
+/**
+ * Returns the value of a number field of a JSON payload, or \ref missing
+ */
+double jsonNumber(const std::string &json, const char *key, double missing = -1);
+
+#endif
@@ -0,0 +1,199 @@
+#include "FakeReceiver.h"
+
+#include <stdio.h>
+
+static const char NS_CONNECTION[] = "urn:x-cast:com.google.cast.tp.connection";
+static const char NS_HEARTBEAT[] = "urn:x-cast:com.google.cast.tp.heartbeat";
+static const char NS_RECEIVER[] = "urn:x-cast:com.google.cast.receiver";
+static const char NS_MEDIA[] = "urn:x-cast:com.google.cast.media";
+static const char DEVICE_ID[] = "receiver-0";
+
+void FakeReceiver::launch(const char *appId, const char *displayName, const char *sessionId){
+  this->appId = appId;
+  this->displayName = displayName;
+  this->sessionId = sessionId;
+  statusText = std::string("Casting: ") + title;
+  appConnected = false;
+}
+
+void FakeReceiver::stopApp(){
+  appId = "";
+  displayName = "";
+  sessionId = "";
+  statusText = "";
+  appConnected = false;
+}
+
+void FakeReceiver::enqueue(unsigned long at, const std::vector<uint8_t> &frame){
+  pending_t pending;
+  pending.at = at;
+  pending.frame = frame;
+  //after everything due at the same time, so the order is kept
+  std::vector<pending_t>::iterator i = queue.begin();
+  while ( i != queue.end() && (long)(i->at - at) <= 0 )
+    ++i;
+  queue.insert(i, pending);
+}
+
+void FakeReceiver::push(unsigned long at, const std::string &source, const char *nameSpace, const std::string &payload){
+  enqueue(at, castFrame(source, nameSpace, payload));
+}
+
+std::string FakeReceiver::receiverStatus(uint32_t requestId){
+  char buffer[1024];
+  char apps[512] = "";
+  if ( !appId.empty() ){
+    snprintf(apps, sizeof(apps),
+      "\"applications\":[{\"appId\":\"%s\",\"displayName\":\"%s\",\"isIdleScreen\":false,"
+      "\"namespaces\":[{\"name\":\"%s\"}],\"sessionId\":\"%s\",\"statusText\":\"%s\",\"transportId\":\"%s\"}],",
+      appId.c_str(), displayName.c_str(), NS_MEDIA, sessionId.c_str(), statusText.c_str(), sessionId.c_str());
+  }
+  snprintf(buffer, sizeof(buffer),
+    "{\"requestId\":%u,\"status\":{%s\"volume\":{\"controlType\":\"master\",\"level\":%f,\"muted\":%s,\"stepInterval\":0.05}},\"type\":\"RECEIVER_STATUS\"}",
+    (unsigned)requestId, apps, volume, muted ? "true" : "false");
+  return buffer;
+}
+
+std::string FakeReceiver::mediaStatus(uint32_t requestId){
+  char buffer[1024];
+  snprintf(buffer, sizeof(buffer),
+    "{\"type\":\"MEDIA_STATUS\",\"status\":[{\"mediaSessionId\":%d,\"playbackRate\":1,\"playerState\":\"%s\","
+    "\"currentTime\":%f,\"supportedMediaCommands\":514511,\"volume\":{\"level\":1,\"muted\":false},"
+    "\"media\":{\"streamType\":\"BUFFERED\",\"metadata\":{\"metadataType\":3,\"title\":\"%s\",\"artist\":\"%s\"},"
+    "\"duration\":%f}}],\"requestId\":%u}",
+    mediaSessionId, playerState.c_str(), currentTime, title.c_str(), artist.c_str(), duration, (unsigned)requestId);
+  return buffer;
+}
+
+uint32_t FakeReceiver::count(const char *type){
+  uint32_t found = 0;
+  for(size_t i = 0; i < received.size(); i++){
+    if ( jsonField(received[i].payload, "type") == type )
+      found++;
+  }
+  return found;
+}
+
+bool FakeReceiver::accept(WiFiClientSecure &, const char *host, uint16_t, BearSSL::Session *session){
+  std::map<std::string, uint32_t>::iterator known = sessions.find(host);
+  if ( session != NULL && session->id != 0 && known != sessions.end() && known->second == session->id ){
+    resumedHandshakes++;
+    hostAdvance(resumeTime);
+  } else {
+    if ( session != NULL && session->id != 0 )
+      foreignSessions++;
+    fullHandshakes++;
+    hostAdvance(handshakeTime);
+    if ( session != NULL ){
+      session->id = nextSession++;
+      sessions[host] = session->id;
+    }
+  }
+  //new TCP connection, nothing is left from the previous one
+  deviceConnected = false;
+  appConnected = false;
+  inBuffer.clear();
+  queue.clear();
+  return true;
+}
+
+void FakeReceiver::receive(WiFiClientSecure &, const uint8_t *data, size_t len){
+  inBuffer.insert(inBuffer.end(), data, data + len);
+  while ( inBuffer.size() >= 4 ){
+    uint32_t frameLen = ((uint32_t)inBuffer[0] << 24) | ((uint32_t)inBuffer[1] << 16) | ((uint32_t)inBuffer[2] << 8) | inBuffer[3];
+    if ( inBuffer.size() - 4 < frameLen )
+      break;
+    castFrame_t frame;
+    bool valid = decodeFrame(&inBuffer[4], frameLen, &frame);
+    inBuffer.erase(inBuffer.begin(), inBuffer.begin() + 4 + frameLen);
+    framesIn++;
+    if ( valid ){
+      received.push_back(frame);
+      handle(frame);
+    }
+  }
+}
+
+void FakeReceiver::poll(WiFiClientSecure &client){
+  size_t due = 0;
+  while ( due < queue.size() && (long)(millis() - queue[due].at) >= 0 ){
+    client.rx.insert(client.rx.end(), queue[due].frame.begin(), queue[due].frame.end());
+    framesOut++;
+    due++;
+  }
+  queue.erase(queue.begin(), queue.begin() + due);
+}
+
+void FakeReceiver::reply(const castFrame_t &request, const char *nameSpace, const std::string &payload){
+  enqueue(millis() + replyDelay, castFrame(request.destination, nameSpace, payload, request.source));
+}
+
+void FakeReceiver::handle(const castFrame_t &frame){
+  std::string type = jsonField(frame.payload, "type");
+  uint32_t requestId = jsonNumber(frame.payload, "requestId", 0);
+  bool toDevice = frame.destination == DEVICE_ID;
+  bool toApp = !sessionId.empty() && frame.destination == sessionId;
+  if ( !responding )
+    return;
+
+  if ( frame.nameSpace == NS_CONNECTION ){
+    if ( type == "CONNECT" ){
+      if ( toDevice ){
+        deviceConnected = true;
+      } else if ( toApp ){
+        appConnected = true;
+      } else {
+        //no such application (any more)
+        reply(frame, NS_CONNECTION, "{\"type\":\"CLOSE\"}");
+      }
+    } else if ( type == "CLOSE" ){
+      if ( toDevice )
+        deviceConnected = false;
+      else if ( toApp )
+        appConnected = false;
+    }
+    return;
+  }
+
+  if ( frame.nameSpace == NS_HEARTBEAT ){
+    if ( type == "PING" && (toDevice || toApp) )
+      reply(frame, NS_HEARTBEAT, "{\"type\":\"PONG\"}");
+    return;
+  }
+
+  if ( frame.nameSpace == NS_RECEIVER && toDevice ){
+    if ( type == "SET_VOLUME" ){
+      double level = jsonNumber(frame.payload, "level");
+      if ( level >= 0 )
+        volume = level;
+      if ( frame.payload.find("\"muted\": true") != std::string::npos )
+        muted = true;
+      else if ( frame.payload.find("\"muted\": false") != std::string::npos )
+        muted = false;
+    } else if ( type == "STOP" ){
+      stopApp();
+    } else if ( type != "GET_STATUS" ){
+      reply(frame, NS_RECEIVER, "{\"type\":\"INVALID_REQUEST\",\"requestId\":" + std::to_string(requestId) + ",\"reason\":\"INVALID_COMMAND\"}");
+      return;
+    }
+    reply(frame, NS_RECEIVER, receiverStatus(requestId));
+    return;
+  }
+
+  if ( frame.nameSpace == NS_MEDIA && toApp && appConnected ){
+    if ( type == "PLAY" ){
+      playerState = "PLAYING";
+    } else if ( type == "PAUSE" ){
+      playerState = "PAUSED";
+    } else if ( type == "SEEK" ){
+      currentTime = jsonNumber(frame.payload, "currentTime", currentTime);
+    } else if ( type == "QUEUE_NEXT" || type == "QUEUE_PREV" ){
+      title = type == "QUEUE_NEXT" ? "Next title" : "Previous title";
+      currentTime = 0;
+    } else if ( type != "GET_STATUS" ){
+      reply(frame, NS_MEDIA, "{\"type\":\"INVALID_REQUEST\",\"requestId\":" + std::to_string(requestId) + ",\"reason\":\"INVALID_COMMAND\"}");
+      return;
+    }
+    reply(frame, NS_MEDIA, mediaStatus(requestId));
+  }
+}
@@ -0,0 +1,135 @@
+/**
+ * FakeReceiver.h - Stand-in chromecast for the host tests
+ * https://github.com/andrasbiro/chromecastcontrol
+ */
+
+#ifndef FAKERECEIVER_H
+#define FAKERECEIVER_H
+
+#include <WiFiClientSecure.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "CastFrame.h"
+
+/**
+ * Stand-in chromecast, speaking CASTV2 on the connection, heartbeat,
+ * receiver and media namespaces. Attach it to the client of an
+ * ArduCastControl (client.peer), and it answers the messages written by
+ * the library like a device would: PONG to PING, RECEIVER_STATUS and
+ * MEDIA_STATUS to GET_STATUS and to the commands, with the requestId of
+ * the request.
+ *
+ * Beside the answers, messages can be scheduled at a given time with
+ * \ref push(), so scripted sessions (e.g. a track change pushed by the
+ * device) can be replayed against the library. The answers can be delayed
+ * with \ref replyDelay, to simulate the network.
+ *
+ * The TLS handshake is simulated too: it moves the simulated clock by
+ * \ref handshakeTime, or by \ref resumeTime if the client offers a session
+ * the receiver gave it before, so the effect of session resumption shows in
+ * the connection time measured by the library.
+ *
+ * Everything runs in the same process on the simulated clock, so the tests
+ * are deterministic and measure only the processing of the library. To
+ * exercise the TCP/TLS path as well, serve it with a TlsReceiver.
+ */
+class FakeReceiver : public HostPeer {
+public:
+  //TLS
+  uint32_t handshakeTime = 0;         ///< Simulated duration of a full handshake, ms
+  uint32_t resumeTime = 0;            ///< Simulated duration of a resumed handshake, ms
+  uint32_t fullHandshakes = 0;
+  uint32_t resumedHandshakes = 0;
+  uint32_t foreignSessions = 0;       ///< Sessions offered which were given to another host
+
+  //device state, reported in the status messages
+  float volume = 0.4;
+  bool muted = false;
+  std::string appId;                  ///< Empty if no application is running
+  std::string displayName;
+  std::string sessionId;
+  std::string statusText;
+  int mediaSessionId = 1;
+  std::string playerState = "PLAYING";
+  double currentTime = 0;
+  double duration = 300;
+  std::string title = "Title";
+  std::string artist = "Artist";
+
+  //behaviour
+  uint32_t replyDelay = 0;            ///< Time before the answers are delivered, ms
+  bool responding = true;             ///< Answer the messages, clear it to simulate a hung device
+
+  //observed
+  bool deviceConnected = false;       ///< CONNECT received on receiver-0
+  bool appConnected = false;          ///< CONNECT received on the application
+  std::vector<castFrame_t> received;  ///< Every message written by the library
+  uint32_t framesIn = 0;
+  uint32_t framesOut = 0;
+
+  /**
+   * Starts an application, as if another sender launched it
+   */
+  void launch(const char *appId, const char *displayName, const char *sessionId);
+
+  /**
+   * Stops the application
+   */
+  void stopApp();
+
+  /**
+   * Sends a message to the library at \ref at (simulated ms), or right away
+   * if it's in the past
+   */
+  void push(unsigned long at, const std::string &source, const char *nameSpace, const std::string &payload);
+
+  /**
+   * Returns the RECEIVER_STATUS payload of the current state
+   */
+  std::string receiverStatus(uint32_t requestId);
+
+  /**
+   * Returns the MEDIA_STATUS payload of the current state
+   */
+  std::string mediaStatus(uint32_t requestId);
+
+  /**
+   * Returns the number of messages received of a type, e.g. "PING"
+   */
+  uint32_t count(const char *type);
+
+  //HostPeer
+  bool accept(WiFiClientSecure &client, const char *host, uint16_t port, BearSSL::Session *session);
+  void receive(WiFiClientSecure &client, const uint8_t *data, size_t len);
+  void poll(WiFiClientSecure &client);
+
+private:
+  typedef struct pending_t {
+    unsigned long at;
+    std::vector<uint8_t> frame;
+  } pending_t;
+
+  std::vector<uint8_t> inBuffer;              ///< Partial frame written by the library
+  std::vector<pending_t> queue;               ///< Messages not yet delivered, in time order
+  std::map<std::string, uint32_t> sessions;   ///< TLS session given to each host
+  uint32_t nextSession = 1;
+
+  /**
+   * Queues a frame for the library, to be delivered at \ref at
+   */
+  void enqueue(unsigned long at, const std::vector<uint8_t> &frame);
+
+  /**
+   * Queues an answer to \ref request, after \ref replyDelay
+   */
+  void reply(const castFrame_t &request, const char *nameSpace, const std::string &payload);
+
+  /**
+   * Handles a complete message of the library
+   */
+  void handle(const castFrame_t &frame);
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include "FakeResponder.h"
+
+static const uint16_t TYPE_A = 1;
+static const uint16_t TYPE_PTR = 12;
+static const uint16_t TYPE_TXT = 16;
+static const uint16_t TYPE_SRV = 33;
+static const uint16_t CLASS_IN = 1;
+static const uint16_t CACHE_FLUSH = 0x8000;
+
+/**
+ * Writer of DNS packets, names are compressed against the names written
+ * before by the caller, with \ref pointer()
+ */
+class DnsWriter {
+public:
+  std::vector<uint8_t> b;
+
+  void u16(uint16_t v){
+    b.push_back(v >> 8);
+    b.push_back(v);
+  }
+
+  void u32(uint32_t v){
+    u16(v >> 16);
+    u16(v & 0xFFFF);
+  }
+
+  /**
+   * Writes the labels, followed by a pointer to \ref suffix, or the root if
+   * \ref suffix is 0
+   */
+  void name(const std::vector<std::string> &labels, uint16_t suffix = 0){
+    for(size_t i = 0; i < labels.size(); i++){
+      b.push_back(labels[i].size());
+      b.insert(b.end(), labels[i].begin(), labels[i].end());
+    }
+    if ( suffix != 0 )
+      u16(0xC000 | suffix);
+    else
+      b.push_back(0);
+  }
+
+  /**
+   * Writes the type, class and TTL of a record, and a placeholder for its
+   * data length, returns the position of the placeholder
+   */
+  size_t record(uint16_t type, uint16_t recordClass, uint32_t ttl){
+    u16(type);
+    u16(recordClass);
+    u32(ttl);
+    size_t at = b.size();
+    u16(0);
+    return at;
+  }
+
+  void endRecord(size_t at){
+    uint16_t len = b.size() - at - 2;
+    b[at] = len >> 8;
+    b[at + 1] = len;
+  }
+};
+
+fakeDevice_t& FakeResponder::add(const char *name, const char *id, const uint8_t address[4]){
+  fakeDevice_t device;
+  device.name = name;
+  device.id = id;
+  device.model = "Chromecast Audio";
+  device.target = std::string(id) + "-host";
+  for(int i = 0; i < 4; i++)
+    device.address[i] = address[i];
+  device.port = 8009;
+  device.ttl = 120;
+  devices.push_back(device);
+  return devices.back();
+}
+
+std::vector<uint8_t> FakeResponder::answer(const fakeDevice_t &device, uint32_t ttl, bool withAddress){
+  DnsWriter p;
+  //response, authoritative, no questions
+  p.u16(0);
+  p.u16(0x8400);
+  p.u16(0);
+  p.u16(withAddress ? 4 : 3);
+  p.u16(0);
+  p.u16(0);
+
+  size_t service = p.b.size();
+  p.name({"_googlecast", "_tcp", "local"});
+  size_t at = p.record(TYPE_PTR, CLASS_IN, ttl);
+  size_t instance = p.b.size();
+  p.name({"Chromecast-" + device.id}, service);
+  p.endRecord(at);
+
+  p.u16(0xC000 | instance);
+  at = p.record(TYPE_TXT, CLASS_IN | CACHE_FLUSH, ttl);
+  std::vector<std::string> txt = {"id=" + device.id, "cd=0123", "md=" + device.model, "fn=" + device.name};
+  for(size_t i = 0; i < txt.size(); i++){
+    p.b.push_back(txt[i].size());
+    p.b.insert(p.b.end(), txt[i].begin(), txt[i].end());
+  }
+  p.endRecord(at);
+
+  p.u16(0xC000 | instance);
+  at = p.record(TYPE_SRV, CLASS_IN | CACHE_FLUSH, ttl);
+  p.u16(0);
+  p.u16(0);
+  p.u16(device.port);
+  size_t target = p.b.size();
+  p.name({device.target, "local"});
+  p.endRecord(at);
+
+  if ( withAddress ){
+    if ( device.addressName.empty() )
+      p.u16(0xC000 | target);
+    else
+      p.name({device.addressName, "local"});
+    at = p.record(TYPE_A, CLASS_IN | CACHE_FLUSH, ttl);
+    p.b.insert(p.b.end(), device.address, device.address + 4);
+    p.endRecord(at);
+  }
+  return p.b;
+}
+
+std::vector<uint8_t> FakeResponder::address(const fakeDevice_t &device, uint32_t ttl){
+  DnsWriter p;
+  p.u16(0);
+  p.u16(0x8400);
+  p.u16(0);
+  p.u16(1);
+  p.u16(0);
+  p.u16(0);
+  p.name({device.addressName.empty() ? device.target : device.addressName, "local"});
+  size_t at = p.record(TYPE_A, CLASS_IN | CACHE_FLUSH, ttl);
+  p.b.insert(p.b.end(), device.address, device.address + 4);
+  p.endRecord(at);
+  return p.b;
+}
+
+void FakeResponder::announce(WiFiUDP &udp, const fakeDevice_t &device, uint32_t ttl){
+  udp.in.push_back(answer(device, ttl, !separateAddress));
+  if ( separateAddress )
+    udp.in.push_back(address(device, ttl));
+}
+
+void FakeResponder::receive(WiFiUDP &udp, const std::vector<uint8_t> &packet){
+  //a query (QR clear) with a question
+  if ( packet.size() < 12 || (packet[2] & 0x80) != 0 || (packet[4] << 8 | packet[5]) == 0 )
+    return;
+  static const uint8_t SERVICE[] = "\x0b_googlecast\x04_tcp\x05local";
+  if ( packet.size() < 12 + sizeof(SERVICE) || memcmp(&packet[12], SERVICE, sizeof(SERVICE)) != 0 )
+    return;
+  queries++;
+  for(size_t i = 0; i < devices.size(); i++)
+    announce(udp, devices[i], devices[i].ttl);
+}
@@ -0,0 +1,65 @@
+/**
+ * FakeResponder.h - Stand-in mDNS responder for the host tests
+ * https://github.com/andrasbiro/chromecastcontrol
+ */
+
+#ifndef FAKERESPONDER_H
+#define FAKERESPONDER_H
+
+#include <WiFiUdp.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * A chromecast announced by \ref FakeResponder
+ */
+typedef struct fakeDevice_t {
+  std::string name;           ///< Friendly name, "fn" in the TXT record
+  std::string id;             ///< "id" in the TXT record, the instance is "Chromecast-<id>"
+  std::string model;          ///< "md" in the TXT record
+  std::string target;         ///< Host name in the SRV record, without .local
+  std::string addressName;    ///< Host name of the address record, \ref target if empty
+  uint8_t address[4];
+  uint16_t port;
+  uint32_t ttl;
+} fakeDevice_t;
+
+/**
+ * Stand-in mDNS responder for the _googlecast._tcp service, answering the
+ * queries sent on a WiFiUDP (udp.peer) like the devices on the network do:
+ * a PTR, TXT, SRV and A record for each device. Attach it to the socket of
+ * an ArduCastDiscovery.
+ */
+class FakeResponder : public UdpPeer {
+public:
+  std::vector<fakeDevice_t> devices;
+  bool separateAddress = false;       ///< Send the address records in a separate packet
+  uint32_t queries = 0;               ///< Queries answered
+
+  /**
+   * Adds a device, returns it to change the defaults
+   */
+  fakeDevice_t& add(const char *name, const char *id, const uint8_t address[4]);
+
+  /**
+   * Queues an unsolicited announcement of \ref device, as sent when it
+   * boots or its address changes. A TTL of 0 is a goodbye.
+   */
+  void announce(WiFiUDP &udp, const fakeDevice_t &device, uint32_t ttl);
+
+  /**
+   * Returns the answer with the records of \ref device
+   */
+  std::vector<uint8_t> answer(const fakeDevice_t &device, uint32_t ttl, bool withAddress);
+
+  /**
+   * Returns a packet with the address record of \ref device only
+   */
+  std::vector<uint8_t> address(const fakeDevice_t &device, uint32_t ttl);
+
+  //UdpPeer
+  void receive(WiFiUDP &udp, const std::vector<uint8_t> &packet);
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include "TlsReceiver.h"
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+/**
+ * Returns a server context with a new self-signed certificate
+ */
+static SSL_CTX* serverContext(){
+  EVP_PKEY *key = NULL;
+  EVP_PKEY_CTX *keyCtx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+  if ( keyCtx == NULL || EVP_PKEY_keygen_init(keyCtx) <= 0 ||
+       EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keyCtx, NID_X9_62_prime256v1) <= 0 ||
+       EVP_PKEY_keygen(keyCtx, &key) <= 0 ){
+    EVP_PKEY_CTX_free(keyCtx);
+    return NULL;
+  }
+  EVP_PKEY_CTX_free(keyCtx);
+
+  X509 *cert = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+  X509_set_pubkey(cert, key);
+  X509_NAME *name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"FakeReceiver", -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+  X509_sign(cert, key, EVP_sha256());
+
+  SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+  if ( ctx != NULL && (SSL_CTX_use_certificate(ctx, cert) != 1 || SSL_CTX_use_PrivateKey(ctx, key) != 1) ){
+    SSL_CTX_free(ctx);
+    ctx = NULL;
+  }
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  return ctx;
+}
+
+TlsReceiver::~TlsReceiver(){
+  stop();
+}
+
+uint16_t TlsReceiver::start(){
+  ctx = serverContext();
+  if ( ctx == NULL )
+    return 0;
+  listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(address);
+  if ( listenFd < 0 || bind(listenFd, (struct sockaddr*)&address, len) != 0 ||
+       listen(listenFd, 1) != 0 || getsockname(listenFd, (struct sockaddr*)&address, &len) != 0 ){
+    stop();
+    return 0;
+  }
+  running = true;
+  thread = std::thread(&TlsReceiver::serve, this);
+  return ntohs(address.sin_port);
+}
+
+void TlsReceiver::stop(){
+  running = false;
+  if ( thread.joinable() )
+    thread.join();
+  if ( listenFd >= 0 )
+    close(listenFd);
+  listenFd = -1;
+  SSL_CTX_free((SSL_CTX*)ctx);
+  ctx = NULL;
+}
+
+void TlsReceiver::serve(){
+  //the receiver's side of the connection: it reads what the library sent
+  //from receive(), and queues its messages to rx in poll()
+  WiFiClientSecure side;
+  while ( running ){
+    struct pollfd listening = { listenFd, POLLIN, 0 };
+    if ( poll(&listening, 1, 10) <= 0 )
+      continue;
+    int fd = accept(listenFd, NULL, NULL);
+    if ( fd < 0 )
+      continue;
+    SSL *ssl = SSL_new((SSL_CTX*)ctx);
+    SSL_set_fd(ssl, fd);
+    if ( SSL_accept(ssl) == 1 && receiver.accept(side, "127.0.0.1", 8009, NULL) ){
+      connections++;
+      side.clearRx();
+      side.open = true;
+      while ( running && side.open ){
+        struct pollfd fds = { fd, POLLIN, 0 };
+        if ( SSL_pending(ssl) > 0 || poll(&fds, 1, 1) > 0 ){
+          uint8_t buffer[1024];
+          int got = SSL_read(ssl, buffer, sizeof(buffer));
+          if ( got <= 0 )
+            break;
+          receiver.receive(side, buffer, got);
+        }
+        receiver.poll(side);
+        if ( side.rx.size() > 0 ){
+          if ( SSL_write(ssl, side.rx.data(), side.rx.size()) <= 0 )
+            break;
+          side.clearRx();
+        }
+      }
+      side.open = false;
+    }
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    close(fd);
+  }
+}
@@ -0,0 +1,57 @@
+/**
+ * TlsReceiver.h - Serves a FakeReceiver over TCP and TLS
+ * https://github.com/andrasbiro/chromecastcontrol
+ */
+
+#ifndef TLSRECEIVER_H
+#define TLSRECEIVER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include "FakeReceiver.h"
+
+/**
+ * TLS server on the loopback interface, with a self-signed certificate
+ * like a chromecast, in front of a \ref FakeReceiver. A client in tls mode
+ * (WiFiClientSecure::tls) connecting to \ref start()'s port talks to the
+ * receiver over a real socket, so the library is exercised with the
+ * TLS records split and delayed like on the network.
+ *
+ * The receiver is served on its own thread: don't touch it between
+ * \ref start() and \ref stop(). It still uses the simulated clock for
+ * \ref FakeReceiver::replyDelay and \ref FakeReceiver::push().
+ */
+class TlsReceiver {
+public:
+  TlsReceiver(FakeReceiver &receiver) : receiver(receiver) {}
+  ~TlsReceiver();
+
+  /**
+   * Starts listening on 127.0.0.1
+   * \return
+   *    The port, 0 on error
+   */
+  uint16_t start();
+
+  /**
+   * Closes the connection and waits for the thread to finish
+   */
+  void stop();
+
+  std::atomic<uint32_t> connections{0};   ///< TLS connections accepted
+
+private:
+  FakeReceiver &receiver;
+  std::thread thread;
+  std::atomic<bool> running{false};
+  int listenFd = -1;
+  void *ctx = NULL;                       ///< SSL_CTX, keeps OpenSSL out of the header
+
+  /**
+   * Accepts connections and serves them one by one, until \ref stop()
+   */
+  void serve();
+};
+
+#endif
@@ -0,0 +1,148 @@
+/**
+ * Fuzzing of the CastMessage decoder: pbIndexMessage() on the message, and
+ * loop() on the whole frame, under AddressSanitizer.
+ *
+ * As a test, it runs the seeds of corpus/decoder (CastMessages without the
+ * length field), their truncations and deterministic random mutations of
+ * them. Built with -DARDUCAST_LIBFUZZER=ON (clang), it's a libFuzzer target
+ * instead, to be run on the same seeds:
+ *
+ *     fuzz_decoder -max_len=4096 corpus/decoder
+ */
+
+#include "cast_test.h"
+#include "cast_channel.pb.h"
+#include <dirent.h>
+#include <algorithm>
+
+//payload_type and protocol_version are varints, the rest is length-delimited
+static const uint8_t VARINT_FIELDS = (1 << extensions_api_cast_channel_CastMessage_protocol_version_tag) |
+                                     (1 << extensions_api_cast_channel_CastMessage_payload_type_tag);
+
+static ArduCastControl *cc = NULL;
+
+/**
+ * Decodes one message, fails if an indexed field is out of the message
+ */
+static void fuzzOne(const uint8_t *data, size_t size){
+  //an exact size copy, so reading past the end is caught
+  uint8_t *message = (uint8_t*)malloc(size > 0 ? size : 1);
+  memcpy(message, data, size);
+  for(int truncated = 0; truncated < 2; truncated++){
+    castMsgIndex_t index;
+    if ( ArduCastControl::pbIndexMessage(message, size, truncated, &index) != 0 )
+      continue;
+    for(uint8_t tag = 1; tag < CAST_MSG_FIELDS; tag++){
+      if ( (index.found & (1 << tag)) == 0 || (VARINT_FIELDS & (1 << tag)) != 0 )
+        continue;
+      CHECK(index.fields[tag].offset <= size && index.fields[tag].len <= size - index.fields[tag].offset);
+    }
+  }
+  free(message);
+
+  if ( cc == NULL )
+    cc = new ArduCastControl();
+  if ( cc->getConnection() == DISCONNECTED )
+    CHECK(cc->connect("192.168.1.12") == 0);
+  std::vector<uint8_t> frame(4);
+  frame[0] = size >> 24;
+  frame[1] = size >> 16;
+  frame[2] = size >> 8;
+  frame[3] = size;
+  frame.insert(frame.end(), data, data + size);
+  feed(*cc, frame);
+  cc->loop();
+  hostAdvance(10);
+}
+
+#ifdef ARDUCAST_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size){
+  fuzzOne(data, size);
+  return 0;
+}
+
+#else
+
+static const int MUTATIONS = 20000;   ///< Per seed
+
+/**
+ * Reads the seeds of \ref dir, in name order
+ */
+static std::vector<std::vector<uint8_t> > readSeeds(const char *dir){
+  std::vector<std::string> names;
+  DIR *d = opendir(dir);
+  CHECK(d != NULL);
+  struct dirent *entry;
+  while ( (entry = readdir(d)) != NULL ){
+    if ( entry->d_name[0] != '.' )
+      names.push_back(entry->d_name);
+  }
+  closedir(d);
+  std::sort(names.begin(), names.end());
+
+  std::vector<std::vector<uint8_t> > seeds;
+  for(size_t i = 0; i < names.size(); i++){
+    FILE *f = fopen((std::string(dir) + "/" + names[i]).c_str(), "rb");
+    CHECK(f != NULL);
+    std::vector<uint8_t> seed;
+    int c;
+    while ( (c = fgetc(f)) != EOF )
+      seed.push_back(c);
+    fclose(f);
+    seeds.push_back(seed);
+  }
+  return seeds;
+}
+
+int main(int argc, char **argv){
+  CHECK(argc == 2);
+  std::vector<std::vector<uint8_t> > seeds = readSeeds(argv[1]);
+  CHECK(seeds.size() > 0);
+
+  srand(1);
+  for(size_t s = 0; s < seeds.size(); s++){
+    const std::vector<uint8_t> &seed = seeds[s];
+    for(size_t len = 0; len <= seed.size(); len++)
+      fuzzOne(seed.data(), len);
+    for(int i = 0; i < MUTATIONS; i++){
+      std::vector<uint8_t> mutated = seed;
+      int changes = 1 + rand() % 8;
+      for(int k = 0; k < changes && !mutated.empty(); k++){
+        size_t at = rand() % mutated.size();
+        switch ( rand() % 4 ){
+          case 0:   //a byte inserted
+            mutated.insert(mutated.begin() + at, rand());
+            break;
+          case 1:   //a byte removed
+            mutated.erase(mutated.begin() + at);
+            break;
+          default:  //a byte changed
+            mutated[at] = rand();
+            break;
+        }
+      }
+      //sometimes the end of another seed
+      if ( rand() % 8 == 0 ){
+        const std::vector<uint8_t> &other = seeds[rand() % seeds.size()];
+        mutated.resize(rand() % (mutated.size() + 1));
+        mutated.insert(mutated.end(), other.begin() + rand() % (other.size() + 1), other.end());
+      }
+      fuzzOne(mutated.data(), mutated.size());
+    }
+  }
+
+  //still in sync, a valid status is decoded after all that
+  CHECK(cc->getMetrics().framesMalformed > 0);
+  while ( cc->rxInProgress() )
+    fuzzOne(NULL, 0);
+  cc->volume = 0;
+  feed(*cc, castFrame("receiver-0", CC_NS_RECEIVER, RECEIVER_STATUS));
+  cc->loop();
+  CHECK(cc->volume == 0.4f);
+  delete cc;
+  printf("fuzz_decoder ok\n");
+  return 0;
+}
+
+#endif
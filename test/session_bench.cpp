@@ -0,0 +1,66 @@
+/**
+ * Throughput and latency of the protocol engine against the stand-in
+ * receiver, off-device. The network is simulated, so the times reported are
+ * the processing of the library on the host CPU; only relative numbers
+ * (before and after a change) are meaningful.
+ *
+ *   session_bench [frames]
+ */
+
+#include "cast_test.h"
+
+static const char APP_SESSION[] = "0b8c8f0e-5d3a-4c1e-9a0b-6f2d7e1c3a55";
+
+static bool answered = false;
+
+static void onCommand(uint32_t, int, void*){
+  answered = true;
+}
+
+int main(int argc, char **argv){
+  uint32_t frames = argc > 1 ? atoi(argv[1]) : 20000;
+
+  FakeReceiver receiver;
+  receiver.launch("CC32E753", "Spotify", APP_SESSION);
+  ArduCastControl cc;
+  cc.client.peer = &receiver;
+  cc.setPushMode(true);
+  CHECK(cc.connect("192.168.1.12") == 0);
+  for(int i = 0; i < 100 && cc.getConnection() != APPLICATION_RUNNING; i++){
+    cc.loop();
+    hostAdvance(10);
+  }
+  CHECK(cc.getConnection() == APPLICATION_RUNNING);
+
+  //throughput: MEDIA_STATUS pushed by the device, one per loop
+  std::string status = receiver.mediaStatus(0);
+  unsigned long start = micros();
+  for(uint32_t i = 0; i < frames; i++){
+    receiver.push(millis(), APP_SESSION, CC_NS_MEDIA, status);
+    cc.loop();
+    hostAdvance(1);
+  }
+  unsigned long elapsed = micros() - start;
+  printf("status frames: %u in %lu us, %.0f frames/s, %.2f us/frame\n",
+    frames, elapsed, frames * 1e6 / elapsed, (double)elapsed / frames);
+
+  //latency: command to callback, loop() calls and processing time
+  uint32_t commands = frames / 10;
+  unsigned long busy = 0;
+  uint32_t loops = 0;
+  for(uint32_t i = 0; i < commands; i++){
+    answered = false;
+    start = micros();
+    CHECK(cc.pause(true, onCommand) == 0);
+    while ( !answered ){
+      cc.loop();
+      loops++;
+    }
+    busy += micros() - start;
+  }
+  printf("commands: %u, %.2f loop() calls and %.2f us per round trip\n",
+    commands, (double)loops / commands, (double)busy / commands);
+
+  cc.dumpMetrics();
+  return 0;
+}
@@ -0,0 +1,75 @@
+#include "Arduino.h"
+
+#include <atomic>
+#include <chrono>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+//starts late, so "long ago" timestamps of the library don't wrap; atomic,
+//as the stand-in TLS receiver reads it on its own thread
+static std::atomic<unsigned long> simulatedMillis(100000);
+
+unsigned long millis(){
+  return simulatedMillis;
+}
+
+unsigned long micros(){
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void delay(unsigned long ms){
+  simulatedMillis += ms;
+}
+
+void hostAdvance(unsigned long ms){
+  simulatedMillis += ms;
+}
+
+void yield(){
+}
+
+long random(long max){
+  return max > 0 ? rand() % max : 0;
+}
+
+long random(long min, long max){
+  return max > min ? min + rand() % (max - min) : min;
+}
+
+void randomSeed(unsigned long seed){
+  srand(seed);
+}
+
+size_t Print::printf(const char *format, ...){
+  char buffer[512];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if ( len < 0 )
+    return 0;
+  if ( (size_t)len >= sizeof(buffer) )
+    len = sizeof(buffer) - 1;
+  return write((const uint8_t*)buffer, len);
+}
+
+size_t Stream::readBytes(uint8_t *buffer, size_t len){
+  size_t got = 0;
+  while ( got < len ){
+    int c = read();
+    if ( c < 0 )
+      break;
+    buffer[got++] = c;
+  }
+  return got;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t len){
+  return fwrite(buffer, 1, len, stdout);
+}
+
+uint32_t EspClass::getFreeHeap(){
+  return 40000;
+}
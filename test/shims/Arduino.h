@@ -0,0 +1,102 @@
+/**
+ * Arduino.h - Host stand-in of the Arduino core, only what the library uses
+ * https://github.com/andrasbiro/chromecastcontrol
+ *
+ * millis() runs on a simulated clock, which only moves with delay() and
+ * hostAdvance(), so the timeouts of the library are deterministic in tests.
+ * micros() is the real clock, for measuring the processing time.
+ */
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#define PROGMEM
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define memcpy_P memcpy
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+/**
+ * Moves the simulated clock of millis() forward, host only
+ */
+void hostAdvance(unsigned long ms);
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(const uint8_t *buffer, size_t len) = 0;
+  virtual size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const char *str) { return write((const uint8_t*)str, strlen(str)); }
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+  size_t print(const char *str) { return write(str); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int value) { return printf("%d", value); }
+  size_t print(unsigned int value) { return printf("%u", value); }
+  size_t print(long value) { return printf("%ld", value); }
+  size_t print(unsigned long value) { return printf("%lu", value); }
+  size_t print(double value) { return printf("%.2f", value); }
+  size_t println() { return write("\r\n"); }
+  template<typename T> size_t println(T value) { return print(value) + println(); }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  size_t readBytes(uint8_t *buffer, size_t len);
+};
+
+/**
+ * Serial, written to stdout
+ */
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  size_t write(const uint8_t *buffer, size_t len);
+  int available() { return 0; }
+  int read() { return -1; }
+  int peek() { return -1; }
+};
+
+extern HardwareSerial Serial;
+
+class IPAddress {
+private:
+  uint8_t bytes[4];
+
+public:
+  IPAddress() { memset(bytes, 0, sizeof(bytes)); }
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) { bytes[0] = a; bytes[1] = b; bytes[2] = c; bytes[3] = d; }
+  uint8_t operator[](int index) const { return bytes[index]; }
+  uint8_t& operator[](int index) { return bytes[index]; }
+  bool operator==(const IPAddress &other) const { return memcmp(bytes, other.bytes, sizeof(bytes)) == 0; }
+};
+
+/**
+ * ESP, only the heap statistics. The heap isn't measured on the host, it
+ * always reports the same free heap.
+ */
+class EspClass {
+public:
+  uint32_t getFreeHeap();
+};
+
+extern EspClass ESP;
+
+#endif
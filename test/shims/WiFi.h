@@ -0,0 +1,18 @@
+/**
+ * WiFi.h - Host stand-in of the WiFi interface, only its address
+ * https://github.com/andrasbiro/chromecastcontrol
+ */
+
+#ifndef WIFI_H
+#define WIFI_H
+
+#include <Arduino.h>
+
+class WiFiClass {
+public:
+  IPAddress localIP() { return IPAddress(192, 168, 1, 2); }
+};
+
+extern WiFiClass WiFi;
+
+#endif
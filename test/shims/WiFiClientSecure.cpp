@@ -0,0 +1,211 @@
+#include "WiFiClientSecure.h"
+
+#ifdef ARDUCAST_HOST_TLS
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+
+WiFiClientSecure::~WiFiClientSecure(){
+  tlsClose();
+}
+
+void WiFiClientSecure::clearRx(){
+  rx.clear();
+  rxPos = 0;
+  rxReleased = 0;
+}
+
+int WiFiClientSecure::connect(const char *host, uint16_t port){
+  connects++;
+  if ( refuse )
+    return 0;
+  tlsClose();
+  if ( tls ){
+    if ( !tlsConnect(host, tlsPort != 0 ? tlsPort : port) )
+      return 0;
+  } else if ( peer != NULL && !peer->accept(*this, host, port, session) ){
+    return 0;
+  }
+  //new stream, nothing left from the previous connection
+  clearRx();
+  open = true;
+  return 1;
+}
+
+uint8_t WiFiClientSecure::connected(){
+  return open;
+}
+
+int WiFiClientSecure::available(){
+  if ( open && hostTls != NULL )
+    tlsReceive();
+  else if ( open && peer != NULL )
+    peer->poll(*this);
+  if ( rxReleased < rx.size() )
+    rxReleased = rx.size() - rxReleased > dribble ? rxReleased + dribble : rx.size();
+  return rxReleased - rxPos;
+}
+
+int WiFiClientSecure::read(){
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClientSecure::read(uint8_t *buffer, size_t len){
+  if ( rxPos >= rxReleased )
+    return -1;
+  if ( len > rxReleased - rxPos )
+    len = rxReleased - rxPos;
+  memcpy(buffer, &rx[rxPos], len);
+  rxPos += len;
+  return len;
+}
+
+int WiFiClientSecure::peek(){
+  return rxPos < rxReleased ? rx[rxPos] : -1;
+}
+
+size_t WiFiClientSecure::write(const uint8_t *buffer, size_t len){
+  if ( !open )
+    return 0;
+  if ( len > writeLimit )
+    len = writeLimit;
+  if ( hostTls != NULL && !tlsSend(buffer, len) ){
+    open = false;
+    return 0;
+  }
+  tx.insert(tx.end(), buffer, buffer + len);
+  if ( hostTls == NULL && peer != NULL && len > 0 )
+    peer->receive(*this, buffer, len);
+  return len;
+}
+
+void WiFiClientSecure::stop(){
+  tlsClose();
+  open = false;
+}
+
+void WiFiClientSecure::setSession(BearSSL::Session *session){
+  this->session = session;
+}
+
+#ifdef ARDUCAST_HOST_TLS
+
+struct WiFiClientSecure::HostTls {
+  SSL_CTX *ctx;
+  SSL *ssl;
+  int fd;
+};
+
+bool WiFiClientSecure::tlsConnect(const char *host, uint16_t port){
+  char service[8];
+  snprintf(service, sizeof(service), "%u", (unsigned)port);
+  struct addrinfo hints = {}, *addresses;
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if ( getaddrinfo(host, service, &hints, &addresses) != 0 )
+    return false;
+  int fd = -1;
+  for(struct addrinfo *a = addresses; a != NULL && fd < 0; a = a->ai_next){
+    fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if ( fd >= 0 && ::connect(fd, a->ai_addr, a->ai_addrlen) != 0 ){
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if ( fd < 0 )
+    return false;
+
+  //setInsecure(): chromecast uses a self signed certificate
+  SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+  SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, NULL);
+  SSL *ssl = SSL_new(ctx);
+  SSL_set_fd(ssl, fd);
+  SSL_set_tlsext_host_name(ssl, host);
+  if ( SSL_connect(ssl) != 1 ){
+    SSL_free(ssl);
+    SSL_CTX_free(ctx);
+    close(fd);
+    return false;
+  }
+  //the handshake is blocking, reading is not, like on the device
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  hostTls = new HostTls;
+  hostTls->ctx = ctx;
+  hostTls->ssl = ssl;
+  hostTls->fd = fd;
+  return true;
+}
+
+void WiFiClientSecure::tlsReceive(){
+  uint8_t buffer[1024];
+  while ( true ){
+    int got = SSL_read(hostTls->ssl, buffer, sizeof(buffer));
+    if ( got > 0 ){
+      rx.insert(rx.end(), buffer, buffer + got);
+      continue;
+    }
+    if ( SSL_get_error(hostTls->ssl, got) != SSL_ERROR_WANT_READ ){
+      //closed by the other end, what was received can still be read
+      tlsClose();
+      open = false;
+    }
+    return;
+  }
+}
+
+bool WiFiClientSecure::tlsSend(const uint8_t *buffer, size_t len){
+  while ( len > 0 ){
+    int sent = SSL_write(hostTls->ssl, buffer, len);
+    if ( sent > 0 ){
+      buffer += sent;
+      len -= sent;
+      continue;
+    }
+    int err = SSL_get_error(hostTls->ssl, sent);
+    if ( err != SSL_ERROR_WANT_WRITE && err != SSL_ERROR_WANT_READ )
+      return false;
+    struct pollfd fds = { hostTls->fd, (short)(err == SSL_ERROR_WANT_WRITE ? POLLOUT : POLLIN), 0 };
+    poll(&fds, 1, 100);
+  }
+  return true;
+}
+
+void WiFiClientSecure::tlsClose(){
+  if ( hostTls == NULL )
+    return;
+  SSL_shutdown(hostTls->ssl);
+  SSL_free(hostTls->ssl);
+  SSL_CTX_free(hostTls->ctx);
+  close(hostTls->fd);
+  delete hostTls;
+  hostTls = NULL;
+}
+
+#else
+
+//built without OpenSSL, tls mode refuses to connect
+struct WiFiClientSecure::HostTls {};
+
+bool WiFiClientSecure::tlsConnect(const char *, uint16_t){
+  return false;
+}
+
+void WiFiClientSecure::tlsReceive(){
+}
+
+bool WiFiClientSecure::tlsSend(const uint8_t *, size_t){
+  return false;
+}
+
+void WiFiClientSecure::tlsClose(){
+}
+
+#endif
@@ -0,0 +1,115 @@
+/**
+ * WiFiClientSecure.h - Host stand-in of the TLS client used by the library
+ * https://github.com/andrasbiro/chromecastcontrol
+ */
+
+#ifndef WIFICLIENTSECURE_H
+#define WIFICLIENTSECURE_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <vector>
+
+namespace BearSSL {
+
+/**
+ * TLS session, kept by the application to resume it. On the host it's only
+ * the ID given by the peer (see \ref HostPeer::accept()), 0 if there's no
+ * session to resume.
+ */
+class Session {
+public:
+  uint32_t id = 0;
+};
+
+}
+
+class WiFiClientSecure;
+
+/**
+ * The other end of a \ref WiFiClientSecure, e.g. a stand-in chromecast
+ */
+class HostPeer {
+public:
+  virtual ~HostPeer() {}
+
+  /**
+   * Called on connect(), does the "TLS handshake"
+   * \param[in] session
+   *    Session set with setSession() or NULL. Resumed if the peer knows it,
+   *    otherwise updated to the new session.
+   * \return
+   *    False to refuse the connection
+   */
+  virtual bool accept(WiFiClientSecure &client, const char *host, uint16_t port, BearSSL::Session *session) = 0;
+
+  /**
+   * Called with the bytes written by the library
+   */
+  virtual void receive(WiFiClientSecure &client, const uint8_t *data, size_t len) = 0;
+
+  /**
+   * Called before the received bytes are checked, to deliver the messages
+   * which are due
+   */
+  virtual void poll(WiFiClientSecure &) {}
+};
+
+/**
+ * Scripted TLS client. The bytes to be read by the library are appended to
+ * \ref rx, either by the test or by a \ref HostPeer; everything written by the
+ * library is appended to \ref tx and passed to the peer. Reading is
+ * throttled with \ref dribble, to exercise the reassembly of frames arriving
+ * in pieces, and writing with \ref writeLimit.
+ *
+ * With \ref tls set, it connects over TCP and TLS instead (OpenSSL, built
+ * with ARDUCAST_HOST_TLS), e.g. to a TlsReceiver. The received bytes are
+ * still appended to \ref rx and the written ones to \ref tx. The session
+ * set with setSession() is only resumed by an in-process peer.
+ */
+class WiFiClientSecure : public Stream {
+public:
+  std::vector<uint8_t> rx;            ///< Bytes sent to the library
+  size_t rxPos = 0;                   ///< Next byte of \ref rx to read
+  size_t rxReleased = 0;              ///< Bytes of \ref rx readable so far
+  size_t dribble = SIZE_MAX;          ///< Bytes of \ref rx released by each available() call
+  std::vector<uint8_t> tx;            ///< Bytes written by the library
+  size_t writeLimit = SIZE_MAX;       ///< Bytes accepted by each write() call
+  bool open = false;                  ///< Connected, clear it to simulate a lost connection
+  bool refuse = false;                ///< Fail the next connect() calls
+  uint32_t connects = 0;              ///< Number of connect() calls
+  BearSSL::Session *session = NULL;   ///< Set with setSession()
+  HostPeer *peer = NULL;              ///< The other end, if any
+  bool tls = false;                   ///< Connect over TCP/TLS instead of \ref peer
+  uint16_t tlsPort = 0;               ///< Port used instead of the one asked by the library, if not 0
+
+  ~WiFiClientSecure();
+
+  /**
+   * Drops the bytes not yet read
+   */
+  void clearRx();
+
+  int connect(const char *host, uint16_t port);
+  uint8_t connected();
+  int available();
+  int read();
+  int read(uint8_t *buffer, size_t len);
+  int peek();
+  size_t write(const uint8_t *buffer, size_t len);
+  void stop();
+  void setInsecure() {}
+  void allowSelfSignedCerts() {}
+  void setSession(BearSSL::Session *session);
+
+private:
+  struct HostTls;
+  HostTls *hostTls = NULL;            ///< The TLS connection in \ref tls mode
+
+  bool tlsConnect(const char *host, uint16_t port);
+  void tlsReceive();
+  bool tlsSend(const uint8_t *buffer, size_t len);
+  void tlsClose();
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include "WiFiUdp.h"
+#include "WiFi.h"
+
+WiFiClass WiFi;
+
+int WiFiUDP::beginMulticast(IPAddress, uint16_t){
+  joined = true;
+  return 1;
+}
+
+int WiFiUDP::beginPacket(IPAddress, uint16_t){
+  packet.clear();
+  return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t len){
+  packet.insert(packet.end(), buffer, buffer + len);
+  return len;
+}
+
+int WiFiUDP::endPacket(){
+  out.push_back(packet);
+  packet.clear();
+  if ( peer != NULL )
+    peer->receive(*this, out.back());
+  return 1;
+}
+
+int WiFiUDP::parsePacket(){
+  //the rest of the previous packet is dropped, like on the device
+  if ( current )
+    next++;
+  current = next < in.size();
+  if ( !current ){
+    in.clear();
+    next = 0;
+    return 0;
+  }
+  return in[next].size();
+}
+
+int WiFiUDP::read(uint8_t *buffer, size_t len){
+  if ( !current )
+    return 0;
+  std::vector<uint8_t> &p = in[next];
+  if ( len > p.size() )
+    len = p.size();
+  memcpy(buffer, p.data(), len);
+  return len;
+}
+
+void WiFiUDP::stop(){
+  joined = false;
+}
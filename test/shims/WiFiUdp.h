@@ -0,0 +1,53 @@
+/**
+ * WiFiUdp.h - Host stand-in of the UDP socket used by the discovery
+ * https://github.com/andrasbiro/chromecastcontrol
+ */
+
+#ifndef WIFIUDP_H
+#define WIFIUDP_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <vector>
+
+class WiFiUDP;
+
+/**
+ * Other end of a \ref WiFiUDP, e.g. a stand-in mDNS responder
+ */
+class UdpPeer {
+public:
+  virtual ~UdpPeer() {}
+
+  /**
+   * Called with each packet sent, the answers can be queued in udp.in
+   */
+  virtual void receive(WiFiUDP &udp, const std::vector<uint8_t> &packet) = 0;
+};
+
+/**
+ * Scripted UDP socket: the packets to be received are queued in \ref in,
+ * the packets sent are collected in \ref out, and passed to \ref peer.
+ */
+class WiFiUDP {
+public:
+  std::vector<std::vector<uint8_t> > in;    ///< Packets to receive, in order
+  std::vector<std::vector<uint8_t> > out;   ///< Packets sent
+  bool joined = false;                      ///< The multicast group is joined
+  UdpPeer *peer = NULL;                     ///< Answers the packets sent, if set
+
+  int beginMulticast(IPAddress group, uint16_t port);
+  int beginPacket(IPAddress address, uint16_t port);
+  size_t write(const uint8_t *buffer, size_t len);
+  int endPacket();
+  int parsePacket();
+  int read(uint8_t *buffer, size_t len);
+  void stop();
+
+private:
+  std::vector<uint8_t> packet;              ///< Packet being sent
+  size_t next = 0;                          ///< Next packet of \ref in
+  bool current = false;                     ///< A packet of \ref in is being read
+};
+
+#endif
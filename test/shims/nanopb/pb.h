@@ -0,0 +1,89 @@
+/**
+ * pb.h - Host stand-in of nanopb, enough to encode CastMessage
+ * https://github.com/andrasbiro/chromecastcontrol
+ *
+ * Used when the host build is configured without NANOPB_DIR. The field
+ * descriptors are built from the FIELDLIST macros of the generated headers,
+ * like nanopb does, and encoded with the same rules (fields in tag order,
+ * required static fields always, callback fields through their callback).
+ * Only static varint fields and callback fields are supported.
+ */
+
+#ifndef PB_H_INCLUDED
+#define PB_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define PB_PROTO_HEADER_VERSION 40
+
+typedef uint8_t pb_byte_t;
+
+typedef enum {
+  PB_WT_VARINT = 0,
+  PB_WT_64BIT  = 1,
+  PB_WT_STRING = 2,
+  PB_WT_32BIT  = 5
+} pb_wire_type_t;
+
+typedef struct pb_ostream_s {
+  pb_byte_t *buf;
+  size_t max_size;
+  size_t bytes_written;
+} pb_ostream_t;
+
+typedef struct pb_istream_s pb_istream_t;
+
+typedef struct pb_field_iter_s {
+  uint32_t tag;
+  pb_wire_type_t wiretype;
+} pb_field_iter_t;
+
+typedef struct pb_callback_s {
+  union {
+    bool (*decode)(pb_istream_t *stream, const pb_field_iter_t *field, void **arg);
+    bool (*encode)(pb_ostream_t *stream, const pb_field_iter_t *field, void * const *arg);
+  } funcs;
+  void *arg;
+} pb_callback_t;
+
+/**
+ * Field descriptor of the stand-in
+ */
+typedef struct pb_shim_field_s {
+  uint32_t tag;             /* 0 ends the list */
+  uint8_t callback;         /* CALLBACK allocation */
+  uint8_t required;         /* REQUIRED, otherwise OPTIONAL */
+  uint8_t wiretype;
+  size_t offset;
+  size_t size;
+} pb_shim_field_t;
+
+typedef struct pb_msgdesc_s {
+  const pb_shim_field_t *fields;
+} pb_msgdesc_t;
+
+#define PB_SHIM_ALLOC_STATIC 0
+#define PB_SHIM_ALLOC_CALLBACK 1
+#define PB_SHIM_HTYPE_REQUIRED 1
+#define PB_SHIM_HTYPE_OPTIONAL 0
+#define PB_SHIM_HTYPE_REPEATED 0
+#define PB_SHIM_LTYPE_UENUM PB_WT_VARINT
+#define PB_SHIM_LTYPE_BOOL PB_WT_VARINT
+#define PB_SHIM_LTYPE_STRING PB_WT_STRING
+#define PB_SHIM_LTYPE_BYTES PB_WT_STRING
+#define PB_SHIM_LTYPE_MESSAGE PB_WT_STRING
+
+#define PB_SHIM_FIELD(structname, atype, htype, ltype, fieldname, tag) \
+  { tag, PB_SHIM_ALLOC_##atype, PB_SHIM_HTYPE_##htype, PB_SHIM_LTYPE_##ltype, \
+    offsetof(structname, fieldname), sizeof(((structname*)0)->fieldname) },
+
+#define PB_BIND(msgname, structname, width) \
+  static const pb_shim_field_t msgname##_shim_fields[] = { \
+    msgname##_FIELDLIST(PB_SHIM_FIELD, structname) \
+    { 0, 0, 0, 0, 0, 0 } \
+  }; \
+  const pb_msgdesc_t msgname##_msg = { msgname##_shim_fields };
+
+#endif
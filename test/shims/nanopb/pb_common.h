@@ -0,0 +1,10 @@
+/**
+ * pb_common.h - Host stand-in of nanopb, see pb.h
+ */
+
+#ifndef PB_COMMON_H_INCLUDED
+#define PB_COMMON_H_INCLUDED
+
+#include "pb.h"
+
+#endif
@@ -0,0 +1,66 @@
+#include "pb_encode.h"
+
+#include <string.h>
+
+pb_ostream_t pb_ostream_from_buffer(pb_byte_t *buf, size_t bufsize){
+  pb_ostream_t stream = { buf, bufsize, 0 };
+  return stream;
+}
+
+bool pb_write(pb_ostream_t *stream, const pb_byte_t *buf, size_t count){
+  if ( count > stream->max_size - stream->bytes_written )
+    return false;
+  memcpy(stream->buf + stream->bytes_written, buf, count);
+  stream->bytes_written += count;
+  return true;
+}
+
+bool pb_encode_varint(pb_ostream_t *stream, uint64_t value){
+  pb_byte_t buffer[10];
+  size_t len = 0;
+  do {
+    buffer[len] = value & 0x7f;
+    value >>= 7;
+    if ( value )
+      buffer[len] |= 0x80;
+    len++;
+  } while ( value );
+  return pb_write(stream, buffer, len);
+}
+
+bool pb_encode_tag(pb_ostream_t *stream, pb_wire_type_t wiretype, uint32_t field_number){
+  return pb_encode_varint(stream, ((uint64_t)field_number << 3) | wiretype);
+}
+
+bool pb_encode_tag_for_field(pb_ostream_t *stream, const pb_field_iter_t *field){
+  return pb_encode_tag(stream, field->wiretype, field->tag);
+}
+
+bool pb_encode_string(pb_ostream_t *stream, const pb_byte_t *buffer, size_t size){
+  return pb_encode_varint(stream, size) && pb_write(stream, buffer, size);
+}
+
+bool pb_encode(pb_ostream_t *stream, const pb_msgdesc_t *fields, const void *src_struct){
+  const pb_shim_field_t *field;
+  for(field = fields->fields; field->tag != 0; field++){
+    const uint8_t *data = (const uint8_t*)src_struct + field->offset;
+    pb_field_iter_t iter;
+    iter.tag = field->tag;
+    iter.wiretype = (pb_wire_type_t)field->wiretype;
+    if ( field->callback ){
+      const pb_callback_t *callback = (const pb_callback_t*)data;
+      if ( callback->funcs.encode != NULL && !callback->funcs.encode(stream, &iter, &callback->arg) )
+        return false;
+    } else if ( field->required && field->wiretype == PB_WT_VARINT ){
+      uint64_t value = 0;
+      if ( field->size > sizeof(value) )
+        return false;
+      memcpy(&value, data, field->size); /* little endian host */
+      if ( !pb_encode_tag_for_field(stream, &iter) || !pb_encode_varint(stream, value) )
+        return false;
+    } else {
+      return false; /* not needed by the library */
+    }
+  }
+  return true;
+}
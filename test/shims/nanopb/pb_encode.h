@@ -0,0 +1,26 @@
+/**
+ * pb_encode.h - Host stand-in of the nanopb encoder, see pb.h
+ */
+
+#ifndef PB_ENCODE_H_INCLUDED
+#define PB_ENCODE_H_INCLUDED
+
+#include "pb.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+pb_ostream_t pb_ostream_from_buffer(pb_byte_t *buf, size_t bufsize);
+bool pb_write(pb_ostream_t *stream, const pb_byte_t *buf, size_t count);
+bool pb_encode_varint(pb_ostream_t *stream, uint64_t value);
+bool pb_encode_tag(pb_ostream_t *stream, pb_wire_type_t wiretype, uint32_t field_number);
+bool pb_encode_tag_for_field(pb_ostream_t *stream, const pb_field_iter_t *field);
+bool pb_encode_string(pb_ostream_t *stream, const pb_byte_t *buffer, size_t size);
+bool pb_encode(pb_ostream_t *stream, const pb_msgdesc_t *fields, const void *src_struct);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
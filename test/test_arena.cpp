@@ -0,0 +1,47 @@
+/**
+ * The arena allocator, and the memory configuration of the instances
+ */
+
+#include "cast_test.h"
+
+int main(){
+  ArduCastArena arena(100);
+  CHECK(arena.allocate(10) != NULL);
+  uint32_t mark = arena.getMark();
+  CHECK(arena.allocate(50) != NULL);
+  CHECK(arena.allocate(50) == NULL);
+  arena.release(mark);
+  CHECK(arena.getUsed() == 10);
+  CHECK(arena.getHighWater() >= 60);
+  CHECK(arena.allocate(50) != NULL);
+  CHECK(ArduCastArena(0).allocate(1) == NULL);
+
+  ArduCastControl cc;
+  castMemoryStats_t stats = cc.getMemoryStats();
+  CHECK(stats.bufferSize == CONNBUFFER_SIZE && stats.txBufferSize == TXBUFFER_SIZE);
+  CHECK(stats.arenaSize >= stats.bufferSize + stats.txBufferSize);
+  CHECK(cc.title[0] == '\0');
+  CHECK(cc.connect("1.2.3.4") == 0);
+  feed(cc, castFrame("receiver-0", CC_NS_RECEIVER, RECEIVER_STATUS));
+  cc.loop();
+  CHECK(strcmp(cc.displayName, "Spotify") == 0);
+  stats = cc.getMemoryStats();
+  CHECK(stats.largestMessage == castFrame("receiver-0", CC_NS_RECEIVER, RECEIVER_STATUS).size());
+  CHECK(stats.arenaHighWater <= stats.arenaSize);
+
+  //short strings are truncated
+  castConfig_t small = {1024, 256, 1024, 8};
+  ArduCastControl shortStrings(small);
+  CHECK(shortStrings.getMemoryStats().arenaSize < stats.arenaSize);
+  CHECK(shortStrings.connect("1.2.3.4") == 0);
+  feed(shortStrings, castFrame("receiver-0", CC_NS_RECEIVER, RECEIVER_STATUS));
+  shortStrings.loop();
+  CHECK(strcmp(shortStrings.displayName, "Spotify") == 0 && strcmp(shortStrings.statusText, "Casting") == 0);
+
+  //an impossible configuration leaves a usable, empty instance
+  castConfig_t huge = {0xFFFFFFF0u, 256, 0, 8};
+  ArduCastControl failed(huge);
+  CHECK(failed.getMemoryStats().bufferSize == 0 && failed.title[0] == '\0');
+  printf("test_arena ok\n");
+  return 0;
+}
@@ -0,0 +1,74 @@
+/**
+ * Binary payloads, sent and received on custom namespaces
+ */
+
+#include "cast_test.h"
+
+static const char NS[] = "urn:x-cast:com.example.telemetry";
+static std::vector<std::string> binary, text;
+
+static void onBinary(ArduCastControl &, uint8_t source, const char*, const uint8_t *payload, uint32_t len, void*){
+  binary.push_back(std::string((const char*)payload, len));
+  CHECK(source == SRC_APPLICATION);
+}
+
+static void onText(ArduCastControl &, uint8_t, const char*, const uint8_t *payload, uint32_t len, void*){
+  text.push_back(std::string((const char*)payload, len));
+}
+
+static std::vector<uint8_t> binaryFrame(const std::string &source, const std::string &destination, const std::string &payload){
+  castFrame_t frame;
+  frame.source = source;
+  frame.destination = destination;
+  frame.nameSpace = NS;
+  frame.payload = payload;
+  frame.binary = true;
+  return encodeFrame(frame);
+}
+
+int main(){
+  WiFiClientSecure client;
+  client.open = true;
+  uint8_t ring[4096];
+  ArduCastTxRing txRing(client, ring, sizeof(ring));
+  ArduCastConnection connection(client, 5000, txRing, CC_NS_MEDIA);
+  connection.connect("abc");
+  uint8_t buffer[512];
+  uint8_t payload[300];
+  for(int i = 0; i < 300; i++)
+    payload[i] = i;
+  int len = connection.encodeBinaryMsg(buffer, sizeof(buffer), NS, payload, 300);
+  CHECK(len == connection.getMsgLength(NS, 300));
+  CHECK(connection.encodeBinaryMsg(buffer, len - 1, NS, payload, 300) == -2);
+  std::vector<uint8_t> expected = binaryFrame("sender-0", "abc", std::string((const char*)payload, 300));
+  CHECK((size_t)len == expected.size() && memcmp(buffer, expected.data(), len) == 0);
+
+  ArduCastControl cc;
+  CHECK(cc.onBinaryNamespace(NS, onBinary) == 0);
+  CHECK(cc.onNamespace(NS, onText) == 0);
+  CHECK(cc.connect("1.2.3.4") == 0);
+  feed(cc, castFrame("receiver-0", CC_NS_RECEIVER, RECEIVER_STATUS));
+  for(int i = 0; i < 5; i++){
+    cc.loop();
+    hostAdvance(600);
+  }
+  cc.client.tx.clear();
+  std::string raw("\x00\x01\x02\xff", 4);
+  feed(cc, binaryFrame(SESSION_ID, "sender-0", raw));
+  feed(cc, castFrame(SESSION_ID, NS, "{}"));
+  cc.loop();
+  CHECK(binary.size() == 1 && binary[0] == raw);
+  CHECK(text.size() == 1 && text[0] == "{}");
+
+  CHECK(cc.sendBinaryMessage(SRC_APPLICATION, NS, (const uint8_t*)raw.data(), raw.size()) == 0);
+  std::vector<castFrame_t> frames = decodeFrames(cc.client.tx);
+  CHECK(!frames.empty() && frames.back().binary && frames.back().payload == raw);
+  CHECK(frames.back().destination == SESSION_ID);
+
+  cc.removeOnNamespace(NS, onBinary);
+  feed(cc, binaryFrame(SESSION_ID, "sender-0", raw));
+  cc.loop();
+  CHECK(binary.size() == 1);
+  printf("test_binary ok\n");
+  return 0;
+}
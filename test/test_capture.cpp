@@ -0,0 +1,119 @@
+/**
+ * Capture of a session against the stand-in receiver, streamed and in a
+ * ring. The capture is saved as session.acap, for test_replay.
+ */
+
+#include "cast_test.h"
+
+static const char APP_SESSION[] = "0b8c8f0e-5d3a-4c1e-9a0b-6f2d7e1c3a55";
+
+/**
+ * Collects what's printed
+ */
+class Collect : public Print {
+public:
+  std::vector<uint8_t> data;
+
+  size_t write(const uint8_t *buffer, size_t len){
+    data.insert(data.end(), buffer, buffer + len);
+    return len;
+  }
+};
+
+static uint32_t get32(const uint8_t *p){
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/**
+ * Counts the records of a capture in each direction, fails on a malformed
+ * capture
+ */
+static void countRecords(const std::vector<uint8_t> &capture, uint32_t &rx, uint32_t &tx){
+  CHECK(capture.size() >= CAPTURE_HEADER_SIZE && memcmp(capture.data(), "ACAP\x01", 5) == 0);
+  rx = tx = 0;
+  size_t pos = CAPTURE_HEADER_SIZE;
+  uint32_t lastAt = 0;
+  while ( pos < capture.size() ){
+    CHECK(pos + CAPTURE_RECORD_HEADER_SIZE <= capture.size());
+    uint32_t at = get32(&capture[pos]);
+    uint32_t len = get32(&capture[pos + 5]);
+    CHECK(at >= lastAt && len >= 4 && pos + CAPTURE_RECORD_HEADER_SIZE + len <= capture.size());
+    //the whole frame, with its length field
+    CHECK(get32(&capture[pos + CAPTURE_RECORD_HEADER_SIZE]) == len - 4);
+    if ( capture[pos + 4] == CAPTURE_RX )
+      rx++;
+    else
+      tx++;
+    lastAt = at;
+    pos += CAPTURE_RECORD_HEADER_SIZE + len;
+  }
+}
+
+static void run(ArduCastControl &cc, uint32_t ms){
+  for(uint32_t t = 0; t < ms; t += 10){
+    cc.loop();
+    hostAdvance(10);
+  }
+}
+
+int main(){
+  FakeReceiver receiver;
+  receiver.launch("CC32E753", "Spotify", APP_SESSION);
+  receiver.replyDelay = 30;
+
+  Collect file;
+  ArduCastCapture capture(file);
+  static uint8_t ring[1024];
+  ArduCastCapture ringCapture(ring, sizeof(ring));
+
+  ArduCastControl cc;
+  cc.client.peer = &receiver;
+  cc.setPushMode(true);
+  cc.setCapture(&capture);
+  CHECK(cc.connect("192.168.1.12") == 0);
+  run(cc, 2000);
+  CHECK(cc.getConnection() == APPLICATION_RUNNING);
+  //the rest goes to the ring too
+  cc.setCapture(&ringCapture);
+  receiver.volume = 0.6;
+  receiver.push(millis(), "receiver-0", CC_NS_RECEIVER, receiver.receiverStatus(0));
+  run(cc, 500);
+  cc.setCapture(&capture);
+  receiver.title = "Pushed title";
+  receiver.playerState = "PAUSED";
+  receiver.push(millis(), APP_SESSION, CC_NS_MEDIA, receiver.mediaStatus(0));
+  run(cc, 500);
+  CHECK(strcmp(cc.title, "Pushed title") == 0 && cc.playerState == PAUSED);
+  cc.setCapture(NULL);
+
+  //every frame is in one of the captures
+  uint32_t rx, tx, ringRx, ringTx;
+  countRecords(file.data, rx, tx);
+  Collect dumped;
+  CHECK(ringCapture.dump(dumped) == CAPTURE_HEADER_SIZE + ringCapture.getUsed());
+  countRecords(dumped.data, ringRx, ringTx);
+  CHECK(ringRx >= 1 && ringCapture.getDropped() == 0);
+  CHECK(rx + ringRx == receiver.framesOut && tx + ringTx == receiver.framesIn);
+
+  //the ring drops the oldest records when full
+  static uint8_t small[200];
+  ArduCastCapture smallCapture(small, sizeof(small));
+  std::vector<uint8_t> status = castFrame("receiver-0", CC_NS_RECEIVER, RECEIVER_STATUS);
+  smallCapture.record(CAPTURE_RX, status.data(), status.size());
+  CHECK(smallCapture.getUsed() == 0 && smallCapture.getDropped() == 1);
+  std::vector<uint8_t> ping = castFrame("receiver-0", CC_NS_HEARTBEAT, "{\"type\":\"PING\"}");
+  for(int i = 0; i < 5; i++)
+    smallCapture.record(CAPTURE_TX, ping.data(), ping.size());
+  CHECK(smallCapture.getDropped() > 1 && smallCapture.getUsed() <= sizeof(small));
+  dumped.data.clear();
+  smallCapture.dump(dumped);
+  countRecords(dumped.data, rx, tx);
+  CHECK(rx == 0 && tx == 5 + 1 - smallCapture.getDropped());
+
+  FILE *out = fopen("session.acap", "wb");
+  CHECK(out != NULL);
+  CHECK(fwrite(file.data.data(), 1, file.data.size(), out) == file.data.size());
+  fclose(out);
+  printf("test_capture ok\n");
+  return 0;
+}
@@ -0,0 +1,61 @@
+/**
+ * The command queue: requestIds, responses matched to the commands, error
+ * responses, timeouts and the full queue
+ */
+
+#include "cast_test.h"
+
+static int callbacks = 0;
+static int results[16];
+static uint32_t ids[16];
+
+static void onCommand(uint32_t requestId, int result, void*){
+  ids[callbacks] = requestId;
+  results[callbacks] = result;
+  callbacks++;
+}
+
+int main(){
+  ArduCastControl cc;
+  joinApplication(cc);
+  CHECK(cc.playerState == PLAYING);
+
+  cc.client.tx.clear();
+  CHECK(cc.next(onCommand) == 0);
+  CHECK(cc.next(onCommand) == 0);
+  CHECK(cc.pause(false, onCommand) == 0);
+  CHECK(cc.setVolume(false, 0.3, onCommand) == 0);
+  //the queue is full
+  CHECK(cc.prev(onCommand) == -11);
+
+  std::vector<std::string> sent = sentPayloads(cc);
+  CHECK(sent.size() == 4);
+  CHECK(sent[0] == "{\"type\": \"QUEUE_NEXT\", \"requestId\": 2, \"mediaSessionId\": 3}");
+  CHECK(sent[1] == "{\"type\": \"QUEUE_NEXT\", \"requestId\": 3, \"mediaSessionId\": 3}");
+  CHECK(sent[2] == "{\"type\": \"PAUSE\", \"requestId\": 4, \"mediaSessionId\": 3}");
+  CHECK(sent[3] == "{\"type\": \"SET_VOLUME\", \"requestId\": 5, \"volume\": {\"level\": 0.300000}}");
+
+  //responses in any order, matched by requestId
+  feed(cc, castFrame(SESSION_ID, CC_NS_MEDIA, mediaStatus(3)));
+  feed(cc, castFrame(SESSION_ID, CC_NS_MEDIA, "{\"type\":\"INVALID_REQUEST\",\"requestId\":2,\"reason\":\"INVALID_COMMAND\"}"));
+  cc.loop();
+  CHECK(callbacks == 2);
+  CHECK(ids[0] == 3 && results[0] == 0);
+  CHECK(ids[1] == 2 && results[1] == -13);
+
+  //the rest never answered
+  hostAdvance(COMMAND_TIMEOUT + 1000);
+  cc.loop();
+  CHECK(callbacks == 4);
+  CHECK(ids[2] == 4 && results[2] == -12);
+  CHECK(ids[3] == 5 && results[3] == -12);
+
+  //the slots are free again
+  CHECK(cc.prev(onCommand) == 0);
+  //and finished when the connection is closed
+  cc.client.stop();
+  cc.loop();
+  CHECK(callbacks == 5 && results[4] == -1);
+  printf("test_commands ok\n");
+  return 0;
+}
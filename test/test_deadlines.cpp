@@ -0,0 +1,82 @@
+/**
+ * The next deadline of an instance: status polls, response timeouts and the
+ * keepalive of each channel
+ */
+
+#include "cast_test.h"
+
+int main(){
+  ArduCastControl cc;
+  cc.setPushMode(true, 30000);
+  cc.setKeepAlive(SRC_DEVICE, 20000);
+  cc.setKeepAlive(SRC_APPLICATION, 8000);
+  CHECK(cc.connect("1.2.3.4") == 0);
+  //GET_STATUS is due, no status yet
+  CHECK(cc.nextDeadline() == millis());
+  cc.loop();
+  std::vector<std::string> sent = sentPayloads(cc);
+  CHECK(jsonField(sent.back(), "type") == "GET_STATUS");
+  CHECK(cc.nextDeadline() - millis() == RESPONSE_TIMEOUT + 1);
+
+  //connecting to the application is due
+  feed(cc, castFrame("receiver-0", CC_NS_RECEIVER, RECEIVER_STATUS));
+  cc.loop();
+  CHECK(cc.nextDeadline() == millis());
+  cc.client.tx.clear();
+  cc.loop();
+  CHECK(cc.getConnection() == WAIT_FOR_RESPONSE);
+  sent = sentPayloads(cc);
+  CHECK(sent.size() == 2 && jsonField(sent[0], "type") == "CONNECT" && jsonField(sent[1], "type") == "GET_STATUS");
+
+  //then the keepalive of the application
+  feed(cc, castFrame(SESSION_ID, CC_NS_MEDIA, mediaStatus(1)));
+  cc.loop();
+  long until = cc.nextDeadline() - millis();
+  CHECK(until == 8001);
+  hostAdvance(until - 1);
+  cc.client.tx.clear();
+  cc.loop();
+  CHECK(sentPayloads(cc).empty());
+  hostAdvance(1);
+  cc.loop();
+  sent = sentPayloads(cc);
+  CHECK(sent.size() == 1 && jsonField(sent[0], "type") == "PING");
+  feed(cc, castFrame(SESSION_ID, CC_NS_HEARTBEAT, "{\"type\":\"PONG\"}"));
+  cc.loop();
+  CHECK(cc.nextDeadline() - millis() == 8001);
+
+  //both channels due in the same pass
+  hostAdvance(20000);
+  cc.client.tx.clear();
+  cc.loop();
+  sent = sentPayloads(cc);
+  CHECK(sent.size() == 2 && jsonField(sent[0], "type") == "PING" && jsonField(sent[1], "type") == "PING");
+
+  //each channel waits for its own response, the device answering doesn't
+  //end the wait of the application
+  const castMetrics_t &metrics = cc.getMetrics();
+  uint32_t timeouts = metrics.responseTimeouts;
+  feed(cc, castFrame("receiver-0", CC_NS_HEARTBEAT, "{\"type\":\"PONG\"}"));
+  cc.loop();
+  CHECK(cc.getConnection() == WAIT_FOR_RESPONSE);
+  CHECK(cc.nextDeadline() - millis() == RESPONSE_TIMEOUT + 1);
+  hostAdvance(RESPONSE_TIMEOUT + 1);
+  cc.client.tx.clear();
+  cc.loop();
+  std::vector<castFrame_t> frames = decodeFrames(cc.client.tx);
+  CHECK(frames.size() == 1 && frames[0].destination == SESSION_ID && frames[0].nameSpace == CC_NS_HEARTBEAT);
+  CHECK(metrics.responseTimeouts == timeouts + 1);
+
+  //and the errors are counted per channel, a live device doesn't keep a
+  //silent application connected
+  connection_t connection = WAIT_FOR_RESPONSE;
+  for(int i = 0; i < 4 && connection != DISCONNECTED; i++){
+    feed(cc, castFrame("receiver-0", CC_NS_HEARTBEAT, "{\"type\":\"PONG\"}"));
+    cc.loop();
+    hostAdvance(RESPONSE_TIMEOUT + 1);
+    connection = cc.loop();
+  }
+  CHECK(connection == DISCONNECTED && metrics.responseTimeouts == timeouts + 5);
+  printf("test_deadlines ok\n");
+  return 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * Discovery against a stand-in mDNS responder: query and answers, address
+ * changes, goodbye, expiry and malformed packets
+ */
+
+#include "cast_test.h"
+#define private public
+#include "ArduCastDiscovery.h"
+#undef private
+#include "FakeResponder.h"
+
+static const uint8_t KITCHEN[4] = {192, 168, 1, 20};
+static const uint8_t LIVING_ROOM[4] = {192, 168, 1, 21};
+static const uint8_t LIVING_ROOM_NEW[4] = {192, 168, 1, 42};
+
+int main(){
+  FakeResponder responder;
+  responder.add("Kitchen", "0a1b2c3d", KITCHEN);
+  //the address record uses another case than the SRV target
+  responder.add("Living Room", "4e5f6a7b", LIVING_ROOM);
+  fakeDevice_t &kitchen = responder.devices[0];
+  fakeDevice_t &living = responder.devices[1];
+  living.target = "Living-Room-4E5F";
+  living.addressName = "living-room-4e5f";
+  responder.separateAddress = true;
+
+  ArduCastDiscovery discovery;
+  ArduCastControl cc;
+  discovery.udp.peer = &responder;
+  CHECK(discovery.connect(cc, "Kitchen") == -15);
+  CHECK(discovery.begin() == 0);
+  CHECK(discovery.udp.joined && discovery.udp.out.size() == 1 && responder.queries == 1);
+  CHECK(discovery.loop() == 2);
+
+  const castDevice_t *device = discovery.find("living room");
+  CHECK(device != NULL);
+  CHECK(strcmp(device->host, "192.168.1.21") == 0 && device->port == 8009);
+  CHECK(strcmp(device->model, "Chromecast Audio") == 0);
+  device = discovery.find("KITCHEN");
+  CHECK(device != NULL && strcmp(device->host, "192.168.1.20") == 0);
+  CHECK(discovery.find("Bedroom") == NULL);
+
+  //connecting by name, the control keeps a copy of the host
+  CHECK(discovery.connect(cc, "Living Room") == 0);
+  CHECK(strcmp(cc.host, "192.168.1.21") == 0 && cc.port == 8009);
+  CHECK(discovery.connect(cc, "Bedroom") == -15);
+
+  //DHCP gave a new address, announced by the device
+  living.address[0] = LIVING_ROOM_NEW[0];
+  living.address[3] = LIVING_ROOM_NEW[3];
+  responder.announce(discovery.udp, living, living.ttl);
+  CHECK(discovery.loop() == 2);
+  CHECK(strcmp(discovery.find("Living Room")->host, "192.168.1.42") == 0);
+  CHECK(strcmp(cc.host, "192.168.1.21") == 0);
+  cc.client.stop();
+  CHECK(discovery.connect(cc, "Living Room") == 0);
+  CHECK(strcmp(cc.host, "192.168.1.42") == 0);
+
+  //the device leaves the network
+  responder.announce(discovery.udp, kitchen, 0);
+  CHECK(discovery.loop() == 1 && discovery.find("Kitchen") == NULL);
+
+  //queried again before the records expire
+  responder.devices.erase(responder.devices.begin());
+  uint32_t sleep = discovery.getSleepTime();
+  CHECK(sleep > 0 && sleep <= DISCOVERY_QUERY_INTERVAL);
+  hostAdvance(DISCOVERY_QUERY_INTERVAL);
+  discovery.loop();
+  CHECK(discovery.udp.out.size() == 2 && responder.queries == 2);
+  //the answers are processed by the next loop
+  CHECK(discovery.udp.in.size() == 2);
+  CHECK(discovery.loop() == 1 && discovery.udp.in.empty());
+  //a device which stopped answering expires
+  responder.devices.clear();
+  hostAdvance(DISCOVERY_QUERY_INTERVAL);
+  CHECK(discovery.loop() == 1);
+  hostAdvance(DISCOVERY_QUERY_INTERVAL - 1);
+  CHECK(discovery.loop() == 1);
+  hostAdvance(1);
+  CHECK(discovery.loop() == 0);
+
+  //queries of other hosts are not answers
+  std::vector<uint8_t> query = discovery.udp.out[0];
+  discovery.processPacket(query.data(), query.size());
+  CHECK(discovery.getDeviceCount() == 0);
+
+  //malformed packets are ignored: a pointer loop, truncated and corrupted answers
+  uint8_t loop[] = {0, 0, 0x84, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0xC0, 12};
+  discovery.processPacket(loop, sizeof(loop));
+  fakeDevice_t bedroom = responder.add("Bedroom", "8c9d0e1f", KITCHEN);
+  std::vector<uint8_t> answer = responder.answer(bedroom, 120, true);
+  for(size_t len = 0; len < answer.size(); len++)
+    discovery.processPacket(answer.data(), len);
+  srand(1);
+  for(int i = 0; i < 20000; i++){
+    std::vector<uint8_t> corrupted = answer;
+    for(int k = 0; k < 3; k++)
+      corrupted[rand() % corrupted.size()] = rand();
+    discovery.processPacket(corrupted.data(), corrupted.size());
+  }
+  discovery.processPacket(answer.data(), answer.size());
+  CHECK(discovery.find("Bedroom") != NULL);
+
+  //a TTL too long for millis() is clamped, instead of wrapping to the past
+  responder.announce(discovery.udp, bedroom, 0xFFFFFFFFu);
+  discovery.loop();
+  device = discovery.find("Bedroom");
+  CHECK(device != NULL && device->expiresAt - millis() == DISCOVERY_MAX_TTL * 1000UL);
+  hostAdvance(DISCOVERY_QUERY_INTERVAL);
+  discovery.loop();
+  CHECK(discovery.find("Bedroom") != NULL);
+  printf("test_discovery ok\n");
+  return 0;
+}
@@ -0,0 +1,86 @@
+/**
+ * The direct CastMessage encoder and its precomputed prefixes: the same
+ * bytes as nanopb's pb_encode() and as an independent encoder
+ */
+
+#include "cast_test.h"
+
+static const char *DESTINATIONS[] = {
+  "receiver-0",
+  "7d5e8a5c-3f2a-4b8e-9d1c-0e6b5f4a3c2d",
+  "0123456789012345678901234567890123456789012345678", //longest destination
+};
+
+static const char *NAMESPACES[] = {
+  CC_NS_HEARTBEAT,
+  CC_NS_MEDIA,
+  CC_NS_RECEIVER,
+  CC_NS_CONNECTION,
+  //doesn't fit in the prefix cache
+  "urn:x-cast:very.long.namespace.that.will.not.fit.in.the.prefix.cache.entry.at.all.really",
+};
+
+int main(){
+  WiFiClientSecure client;
+  uint8_t ring1[512], ring2[512];
+  ArduCastTxRing tx1(client, ring1, sizeof(ring1)), tx2(client, ring2, sizeof(ring2));
+  ArduCastConnection direct(client, 5000, tx1);
+  ArduCastConnection generic(client, 5000, tx2);
+  static uint8_t a[70000], b[70000];
+
+  //payload lengths with 1, 2 and 3 byte varints
+  std::vector<std::string> payloads;
+  payloads.push_back("{\"type\": \"PING\"}");
+  payloads.push_back("");
+  payloads.push_back(std::string(127, 'x'));
+  payloads.push_back(std::string(128, 'x'));
+  payloads.push_back(std::string(300, 'x'));
+  payloads.push_back(std::string(20000, 'x'));
+
+  int compared = 0;
+  for(size_t d = 0; d < sizeof(DESTINATIONS)/sizeof(DESTINATIONS[0]); d++){
+    direct.connect(DESTINATIONS[d]);
+    generic.connect(DESTINATIONS[d]);
+    //the second and third rounds use the cached prefixes
+    for(int round = 0; round < 3; round++){
+      for(size_t n = 0; n < sizeof(NAMESPACES)/sizeof(NAMESPACES[0]); n++){
+        for(size_t p = 0; p < payloads.size(); p++){
+          const char *payload = payloads[p].c_str();
+          int len = direct.encodeMsg(a, sizeof(a), NAMESPACES[n], payload);
+          CHECK(len > 0);
+          CHECK(len == generic.encodeMsgPb(b, sizeof(b), NAMESPACES[n], payload));
+          CHECK(memcmp(a, b, len) == 0);
+          CHECK(len == direct.getMsgLength(NAMESPACES[n], payload));
+          std::vector<uint8_t> expected = castFrame("sender-0", NAMESPACES[n], payloads[p], DESTINATIONS[d]);
+          CHECK((size_t)len == expected.size() && memcmp(a, expected.data(), len) == 0);
+          compared++;
+        }
+      }
+    }
+  }
+  CHECK(compared == 3 * 3 * 5 * 6);
+  int len;
+
+#if MSG_PREFIX_CACHE > 0
+  //the cached prefix is the start of the message
+  direct.connect("receiver-0");
+  len = direct.encodeMsg(a, sizeof(a), CC_NS_MEDIA, "{}");
+  const msgPrefix_t *prefix = direct.getPrefix(CC_NS_MEDIA);
+  CHECK(prefix != NULL && prefix->len > 0 && len > 4 + prefix->len);
+  CHECK(memcmp(a + 4, prefix->data, prefix->len) == 0);
+  CHECK(memcmp(prefix->data + prefix->nsOffset, CC_NS_MEDIA, prefix->nsLen) == 0 && prefix->nsLen == strlen(CC_NS_MEDIA));
+  CHECK(direct.getPrefix(NAMESPACES[4]) == NULL);
+  //rebuilt when the destination changes
+  direct.connect("abc");
+  CHECK(direct.encodeMsg(a, sizeof(a), CC_NS_MEDIA, "{}") == len - (int)strlen("receiver-0") + 3);
+#endif
+
+  //doesn't fit
+  direct.connect("receiver-0");
+  len = direct.encodeMsg(a, sizeof(a), CC_NS_HEARTBEAT, "{\"type\": \"PING\"}");
+  CHECK(direct.encodeMsg(a, len - 1, CC_NS_HEARTBEAT, "{\"type\": \"PING\"}") == -2);
+  CHECK(direct.encodeMsg(a, 20, CC_NS_HEARTBEAT, "{\"type\": \"PING\"}") == -2);
+  CHECK(generic.encodeMsgPb(b, 20, CC_NS_HEARTBEAT, "{\"type\": \"PING\"}") == -2);
+  printf("test_encoder ok\n");
+  return 0;
+}
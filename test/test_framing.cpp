@@ -0,0 +1,88 @@
+/**
+ * Messages received in pieces across loop() calls, and partial messages
+ * abandoned by the device
+ */
+
+#include "cast_test.h"
+
+static const char STATUS[] = "{\"type\":\"RECEIVER_STATUS\",\"requestId\":0,\"status\":{\"volume\":{\"level\":0.5,\"muted\":true}}}";
+
+/**
+ * Calls getRawMessage() until it returns a message, at most \ref calls times
+ * \return
+ *    The length of the message, 0 if it's not complete
+ */
+static uint32_t receive(ArduCastControl &cc, uint32_t calls, uint32_t *used = NULL){
+  uint32_t len = 0;
+  uint32_t call = 0;
+  while ( len == 0 && call < calls ){
+    len = cc.getRawMessage(cc.connBuffer, CONNBUFFER_SIZE, cc.client, RX_TIMEOUT);
+    call++;
+  }
+  if ( used != NULL )
+    *used = call;
+  return len;
+}
+
+int main(){
+  ArduCastControl cc;
+  CHECK(cc.connect("1.2.3.4") == 0);
+  cc.loop();
+
+  //one byte per call, the message is reassembled across the calls
+  std::vector<uint8_t> status = castFrame("receiver-0", CC_NS_RECEIVER, STATUS);
+  cc.client.dribble = 1;
+  feed(cc, status);
+  uint32_t calls;
+  CHECK(receive(cc, 1) == 0 && cc.rxInProgress());
+  CHECK(receive(cc, 10 * status.size(), &calls) == status.size());
+  CHECK(calls == status.size() - 1);
+  CHECK(memcmp(cc.connBuffer, status.data(), status.size()) == 0);
+  CHECK(!cc.rxInProgress() && cc.client.rxPos == cc.client.rx.size());
+
+  //the same through loop()
+  feed(cc, status);
+  cc.loop();
+  CHECK(cc.rxInProgress());
+  for(calls = 0; calls < 10 * status.size() && cc.rxInProgress(); calls++)
+    cc.loop();
+  CHECK(!cc.rxInProgress() && cc.client.rxPos == cc.client.rx.size());
+  CHECK(calls >= status.size() / 2);
+
+  //an oversized message in between is dropped, the stream stays in sync
+  std::vector<uint8_t> oversized = castFrame("receiver-0", "urn:x-cast:custom", std::string(CONNBUFFER_SIZE + 1000, 'x'));
+  feed(cc, oversized);
+  feed(cc, status);
+  cc.client.dribble = 13;
+  CHECK(receive(cc, 5000) == CONNBUFFER_SIZE);
+  CHECK(memcmp(cc.connBuffer + 4, oversized.data() + 4, CONNBUFFER_SIZE - 4) == 0);
+  CHECK(receive(cc, 5000) == status.size());
+  CHECK(memcmp(cc.connBuffer, status.data(), status.size()) == 0);
+
+  //a stall shorter than the timeout is waited out
+  cc.client.dribble = SIZE_MAX;
+  feed(cc, std::vector<uint8_t>(status.begin(), status.begin() + 10));
+  CHECK(receive(cc, 1) == 0 && cc.rxInProgress());
+  hostAdvance(RX_TIMEOUT - 1);
+  CHECK(receive(cc, 1) == 0 && cc.rxInProgress());
+  feed(cc, std::vector<uint8_t>(status.begin() + 10, status.end()));
+  CHECK(receive(cc, 1) == status.size());
+
+  //a longer one drops the partial message, the next one is read from its start
+  feed(cc, std::vector<uint8_t>(status.begin(), status.begin() + 10));
+  CHECK(receive(cc, 1) == 0 && cc.rxInProgress());
+  hostAdvance(RX_TIMEOUT + 1);
+  CHECK(receive(cc, 1) == 0 && !cc.rxInProgress());
+  feed(cc, status);
+  cc.client.dribble = 1;
+  CHECK(receive(cc, 10 * status.size()) == status.size());
+  CHECK(memcmp(cc.connBuffer, status.data(), status.size()) == 0);
+
+  //a length above the protocol limit means the stream is out of sync
+  std::vector<uint8_t> garbage(4 + 100, 0xAA);
+  feed(cc, garbage);
+  cc.client.dribble = SIZE_MAX;
+  CHECK(receive(cc, 1) == 0 && !cc.rxInProgress() && cc.client.rxPos == cc.client.rx.size());
+  printf("test_framing ok\n");
+  return 0;
+}
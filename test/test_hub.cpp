@@ -0,0 +1,112 @@
+/**
+ * Several devices on one shared receive buffer
+ */
+
+#include "cast_test.h"
+#define private public
+#include "ArduCastHub.h"
+#undef private
+
+int main(){
+  ArduCastHub hub;
+  ArduCastControl a(hub.getBuffer()), b(hub.getBuffer()), solo;
+  CHECK(hub.add(a, "1.1.1.1") == 0);
+  CHECK(hub.add(b, "1.1.1.2") == 0);
+  //must use the buffer of the hub
+  CHECK(hub.add(solo, "1.1.1.3") == -14);
+  CHECK(hub.getDeviceCount() == 2);
+
+  //the devices don't allocate what the hub shares: the buffer, and with
+  //ArduinoJson the JSON workspace
+  uint32_t sharedSize = ARENA_ALIGNED(CONNBUFFER_SIZE);
+#ifdef ARDUCAST_USE_ARDUINOJSON
+  sharedSize += ARENA_ALIGNED(JSONBUFFER_SIZE);
+  CHECK(hub.shared.jsonArena == &hub.arena);
+#endif
+  CHECK(a.getMemoryStats().arenaSize + sharedSize == solo.getMemoryStats().arenaSize);
+
+  //one connection per loop
+  hostAdvance(10);
+  CHECK(hub.loop() == 1);
+  CHECK(hub.loop() == 2);
+  CHECK(a.getConnection() != DISCONNECTED && b.getConnection() != DISCONNECTED);
+
+  //the buffer is never taken from an instance in the middle of a message
+  std::vector<uint8_t> status = castFrame("receiver-0", CC_NS_RECEIVER, RECEIVER_STATUS);
+  a.client.dribble = 20;
+  b.client.dribble = 1000;
+  feed(a, status);
+  feed(b, status);
+  int loops = 0;
+  while ( (a.volume != 0.4f || b.volume != 0.4f) && loops < 500 ){
+    hub.loop();
+    loops++;
+    CHECK(!(hub.shared.owner == &a && b.rxInProgress()));
+    CHECK(!(hub.shared.owner == &b && a.rxInProgress()));
+  }
+  CHECK(a.volume == 0.4f && b.volume == 0.4f);
+  CHECK(hub.shared.owner == NULL);
+#ifdef ARDUCAST_USE_ARDUINOJSON
+  //the workspace is released after each status
+  CHECK(a.getMemoryStats().jsonHighWater > 0 && hub.arena.getUsed() == ARENA_ALIGNED(CONNBUFFER_SIZE));
+#endif
+
+  //commands are written while another instance is receiving
+  feed(a, status);
+  hub.nextDevice = 0;
+  hub.loop();
+  CHECK(hub.shared.owner == &a);
+  size_t before = b.client.tx.size();
+  CHECK(b.pause(true) == 0);
+  CHECK(b.client.tx.size() > before);
+  for(int i = 0; i < 200; i++)
+    hub.loop();
+  CHECK(hub.shared.owner == NULL);
+
+
+  //reconnected after the interval
+  a.client.stop();
+  hub.loop();
+  CHECK(a.getConnection() == DISCONNECTED);
+  hostAdvance(HUB_RECONNECT_INTERVAL + 1);
+  hub.loop();
+  hub.loop();
+  CHECK(a.getConnection() != DISCONNECTED);
+
+  hub.remove(a);
+  CHECK(hub.getDeviceCount() == 1 && hub.getDevice(0) == &b);
+
+  //data waiting behind the owner of the buffer is polled, not busy looped
+  ArduCastHub quiet;
+  ArduCastControl c(quiet.getBuffer()), d(quiet.getBuffer());
+  c.setPushMode(true);
+  d.setPushMode(true);
+  CHECK(quiet.add(c, "1.1.1.4") == 0);
+  CHECK(quiet.add(d, "1.1.1.5") == 0);
+  quiet.loop();
+  quiet.loop();
+  std::vector<uint8_t> idle = castFrame("receiver-0", CC_NS_RECEIVER, "{\"type\":\"RECEIVER_STATUS\",\"requestId\":1,\"status\":{\"volume\":{\"level\":0.4}}}");
+  feed(c, idle);
+  feed(d, idle);
+  for(int i = 0; i < 4; i++)
+    quiet.loop();
+  CHECK(c.volume == 0.4f && d.volume == 0.4f);
+  CHECK(d.getSleepTime() > RX_TIMEOUT);
+  feed(c, std::vector<uint8_t>(idle.begin(), idle.begin() + 10));
+  c.loop();
+  CHECK(quiet.shared.owner == &c);
+  d.volume = -1;
+  feed(d, idle);
+  CHECK(d.getSleepTime() == SHARED_RX_POLL_INTERVAL);
+  //until the message of the owner times out
+  hostAdvance(RX_TIMEOUT - 5);
+  CHECK(d.getSleepTime() == 6);
+  hostAdvance(6);
+  c.loop();
+  CHECK(quiet.shared.owner == NULL);
+  CHECK(d.getSleepTime() == 0);
+  d.loop();
+  CHECK(d.volume == 0.4f);
+  printf("test_hub ok\n");
+  return 0;
+}
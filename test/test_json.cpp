@@ -0,0 +1,60 @@
+/**
+ * The allocation free JSON extractor, and the status applied by loop()
+ */
+
+#include "cast_test.h"
+
+static const char MEDIA_STATUS[] = "{\"type\":\"MEDIA_STATUS\",\"status\":[{\"mediaSessionId\":3,\"playbackRate\":1,"
+  "\"playerState\":\"PLAYING\",\"currentTime\":12.5,\"supportedMediaCommands\":514511,\"volume\":{\"level\":1,\"muted\":false},"
+  "\"activeTrackIds\":[],\"media\":{\"contentId\":\"spotify:track:x\",\"streamType\":\"BUFFERED\",\"mediaCategory\":\"AUDIO\","
+  "\"contentType\":\"application/x-spotify.track\",\"metadata\":{\"metadataType\":3,\"title\":\"Whole Lotta Love - 1990 Remaster\","
+  "\"songName\":\"x\",\"artist\":\"Led Zeppelin\",\"albumName\":\"Led Zeppelin II\",\"images\":[{\"url\":\"https://i\",\"height\":640,"
+  "\"width\":640},{\"url\":\"https://j\",\"height\":300,\"width\":300}]},\"duration\":333.89},\"queueData\":{\"items\":[{\"itemId\":1},"
+  "{\"itemId\":2}]},\"currentItemId\":1,\"repeatMode\":\"REPEAT_OFF\"}],\"requestId\":0}";
+
+int main(){
+  castStatus_t status;
+  CHECK(jsonExtractStatus((const uint8_t*)RECEIVER_STATUS, strlen(RECEIVER_STATUS), &status));
+  CHECK((status.found & (CS_TYPE | CS_VOLUME_LEVEL | CS_VOLUME_MUTED | CS_SESSION_ID | CS_STATUS_TEXT | CS_DISPLAY_NAME | CS_REQUEST_ID))
+    == (CS_TYPE | CS_VOLUME_LEVEL | CS_VOLUME_MUTED | CS_SESSION_ID | CS_STATUS_TEXT | CS_DISPLAY_NAME | CS_REQUEST_ID));
+  CHECK(status.volume > 0.39 && status.volume < 0.41 && !status.muted && status.requestId == 1);
+  CHECK(jsonStringEquals(status.type, "RECEIVER_STATUS"));
+
+  //escapes, including \u and surrogate pairs, are decoded to UTF8
+  char text[50];
+  jsonCopyString(text, sizeof(text), status.statusText, true);
+  CHECK(strcmp(text, "Casting: Whole \"Lotta\" Love \xc3\xa9\xf0\x9f\x98\x80") == 0);
+  //truncated, but not in the middle of a UTF8 character
+  char small[33];
+  jsonCopyString(small, sizeof(small), status.statusText, true);
+  CHECK(strcmp(small, "Casting: Whole \"Lotta\" Love \xc3\xa9") == 0);
+
+  CHECK(jsonExtractStatus((const uint8_t*)MEDIA_STATUS, strlen(MEDIA_STATUS), &status));
+  CHECK(status.mediaSessionId == 3 && status.currentTime == 12.5f && status.duration > 333.8 && status.duration < 334);
+  CHECK(jsonStringEquals(status.playerState, "PLAYING"));
+  jsonCopyString(text, sizeof(text), status.title, true);
+  CHECK(strcmp(text, "Whole Lotta Love - 1990 Remaster") == 0);
+  //not valid JSON
+  CHECK(!jsonExtractStatus((const uint8_t*)MEDIA_STATUS, strlen(MEDIA_STATUS) - 3, &status));
+
+  //applied by loop()
+  ArduCastControl cc;
+  CHECK(cc.connect("1.2.3.4") == 0);
+  cc.client.dribble = 50;
+  feed(cc, castFrame("receiver-0", CC_NS_RECEIVER, RECEIVER_STATUS));
+  for(int i = 0; i < 200; i++){
+    cc.loop();
+    hostAdvance(10);
+  }
+  CHECK(cc.volume > 0.39 && cc.volume < 0.41 && !cc.isMuted);
+  CHECK(strcmp(cc.sessionId, SESSION_ID) == 0 && strcmp(cc.displayName, "Spotify") == 0);
+  feed(cc, castFrame(SESSION_ID, CC_NS_MEDIA, MEDIA_STATUS));
+  for(int i = 0; i < 200; i++){
+    cc.loop();
+    hostAdvance(10);
+  }
+  CHECK(cc.playerState == PLAYING && cc.mediaSessionId == 3);
+  CHECK(strcmp(cc.title, "Whole Lotta Love - 1990 Remaster") == 0 && strcmp(cc.artist, "Led Zeppelin") == 0);
+  printf("test_json ok\n");
+  return 0;
+}
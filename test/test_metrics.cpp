@@ -0,0 +1,53 @@
+/**
+ * Protocol metrics: traffic per namespace, errors, latency and parse time
+ */
+
+#include "cast_test.h"
+
+static uint32_t total(const castHistogram_t &histogram){
+  uint32_t sum = 0;
+  for(int i = 0; i < METRICS_HISTOGRAM_SIZE; i++)
+    sum += histogram.count[i];
+  return sum;
+}
+
+int main(){
+  ArduCastControl cc;
+  CHECK(cc.connect("1.2.3.4") == 0);
+  cc.loop();
+  feed(cc, castFrame("receiver-0", CC_NS_RECEIVER, RECEIVER_STATUS));
+  hostAdvance(20);
+  cc.loop();
+  feed(cc, castFrame("receiver-0", CC_NS_RECEIVER, "{not json"));
+  feed(cc, castFrame("receiver-0", "urn:x-cast:custom", "{}"));
+  cc.loop();
+  for(int i = 0; i < 5; i++){
+    cc.loop();
+    hostAdvance(600);
+  }
+
+  const castMetrics_t &metrics = cc.getMetrics();
+  CHECK(metrics.connects == 1 && metrics.connectFailures == 0);
+  CHECK(metrics.ns[NS_RECEIVER].framesIn == 2);
+  //unknown namespaces are counted together
+  CHECK(metrics.ns[0].framesIn == 1);
+  CHECK(metrics.ns[NS_CONNECTION].framesOut >= 1);
+  CHECK(metrics.ns[NS_RECEIVER].framesOut >= 1 && metrics.ns[NS_RECEIVER].bytesOut > 0);
+  CHECK(metrics.parseErrors == 1);
+  //the GET_STATUS was answered 20 ms later
+  CHECK(total(metrics.latency) >= 1 && metrics.latency.max >= 20);
+  CHECK(total(metrics.parseTime) == 3);
+  cc.dumpMetrics();
+
+  //bigger than the receive buffer
+  feed(cc, castFrame("receiver-0", "urn:x-cast:custom", std::string(5000, 'x')));
+  for(int i = 0; i < 3; i++)
+    cc.loop();
+  CHECK(metrics.framesTruncated == 1 && metrics.bytesDropped > 0);
+
+  cc.resetMetrics();
+  CHECK(metrics.connects == 0 && metrics.parseErrors == 0 && metrics.ns[NS_RECEIVER].framesIn == 0);
+  CHECK(metrics.connectTime == cc.getConnectTime());
+  printf("test_metrics ok\n");
+  return 0;
+}
@@ -0,0 +1,56 @@
+/**
+ * Handlers of custom namespaces, and messages sent on them
+ */
+
+#include "cast_test.h"
+
+static const char NS[] = "urn:x-cast:com.example.custom";
+static std::vector<std::string> received;
+static std::vector<int> sources;
+static int mediaSeen = 0;
+
+static void onCustom(ArduCastControl &cc, uint8_t source, const char *nameSpace, const uint8_t *payload, uint32_t len, void*){
+  received.push_back(std::string((const char*)payload, len));
+  sources.push_back(source);
+  CHECK(nameSpace == NS);
+  //echo back while the receive buffer is in use
+  CHECK(cc.sendMessage(SRC_APPLICATION, nameSpace, (const char*)payload, len) == 0);
+}
+
+static void onMedia(ArduCastControl &, uint8_t, const char*, const uint8_t*, uint32_t, void*){
+  mediaSeen++;
+}
+
+int main(){
+  ArduCastControl cc;
+  CHECK(cc.sendMessage(SRC_DEVICE, NS, "{}") == -1);
+  CHECK(cc.onNamespace(NS, onCustom) == 0);
+  CHECK(cc.onNamespace(CC_NS_MEDIA, onMedia) == 0);
+  joinApplication(cc);
+  CHECK(mediaSeen == 1);
+
+  cc.client.tx.clear();
+  //a custom message with requestId 1 is not a status or a command response
+  feed(cc, castFrame(SESSION_ID, NS, "{\"type\":\"MEDIA_STATUS\",\"requestId\":1,\"status\":[{\"mediaSessionId\":9}]}"));
+  feed(cc, castFrame("somebody", NS, "hello"));
+  cc.loop();
+  CHECK(received.size() == 2 && sources[0] == SRC_APPLICATION && sources[1] == 0 && received[1] == "hello");
+  CHECK(cc.mediaSessionId == 3);
+  std::vector<std::string> sent = sentPayloads(cc);
+  CHECK(sent.size() >= 2 && sent[0] == received[0] && sent[1] == "hello");
+
+  cc.removeOnNamespace(NS, onCustom);
+  CHECK(cc.namespaces.lookup((const uint8_t*)NS, strlen(NS)) == 0);
+  feed(cc, castFrame(SESSION_ID, NS, "x"));
+  cc.loop();
+  CHECK(received.size() == 2);
+  //the built in namespaces stay
+  cc.removeOnNamespace(CC_NS_MEDIA, onMedia);
+  CHECK(cc.namespaces.lookup((const uint8_t*)CC_NS_MEDIA, strlen(CC_NS_MEDIA)) == NS_MEDIA);
+
+  for(int i = 0; i < NAMESPACE_HANDLERS_SIZE; i++)
+    CHECK(cc.onNamespace(NS, onCustom, (void*)(intptr_t)i) == 0);
+  CHECK(cc.onNamespace(NS, onCustom) == -11);
+  printf("test_namespaces ok\n");
+  return 0;
+}
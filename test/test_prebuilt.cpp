@@ -0,0 +1,43 @@
+/**
+ * The prebuilt PING and GET_STATUS messages are the same bytes as the
+ * generic encoder writes
+ */
+
+#include "cast_test.h"
+
+int main(){
+  WiFiClientSecure client;
+  client.open = true;
+  uint8_t ring[4096];
+  ArduCastTxRing txRing(client, ring, sizeof(ring));
+  ArduCastConnection connection(client, 5000, txRing, CC_NS_MEDIA);
+  connection.connect("7d5e8a5c-3f2a-4b8e-9d1c-0e6b5f4a3c2d");
+
+  client.tx.clear();
+  CHECK(connection.writePing() == 0);
+  std::vector<uint8_t> ping = client.tx;
+  client.tx.clear();
+  CHECK(connection.writeMsg(CC_NS_HEARTBEAT, "{\"type\": \"PING\"}") == 0);
+  CHECK(ping == client.tx);
+
+  client.tx.clear();
+  CHECK(connection.writeGetStatus() == 0);
+  std::vector<uint8_t> getStatus = client.tx;
+  client.tx.clear();
+  CHECK(connection.writeMsg(CC_NS_MEDIA, "{\"type\": \"GET_STATUS\", \"requestId\": 1}") == 0);
+  CHECK(getStatus == client.tx);
+
+  //rebuilt for the new destination
+  connection.connect("receiver-0");
+  client.tx.clear();
+  CHECK(connection.writePing() == 0);
+  std::vector<uint8_t> devicePing = client.tx;
+  client.tx.clear();
+  CHECK(connection.writeMsg(CC_NS_HEARTBEAT, "{\"type\": \"PING\"}") == 0);
+  CHECK(devicePing == client.tx);
+  castFrame_t frame;
+  CHECK(decodeFrame(&devicePing[4], devicePing.size() - 4, &frame));
+  CHECK(frame.destination == "receiver-0" && frame.source == "sender-0" && frame.nameSpace == CC_NS_HEARTBEAT);
+  printf("test_prebuilt ok\n");
+  return 0;
+}
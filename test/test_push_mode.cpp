@@ -0,0 +1,84 @@
+/**
+ * Push mode: status pushed by the device replaces the periodic GET_STATUS,
+ * polled only when nothing was pushed for the fallback interval
+ */
+
+#include "cast_test.h"
+
+//runs loop(), answering pings and status requests like chromecast does
+static void run(ArduCastControl &cc, uint32_t ms){
+  for(uint32_t t = 0; t < ms; t += 100){
+    size_t sent = cc.client.tx.size();
+    cc.loop();
+    std::vector<uint8_t> written(cc.client.tx.begin() + sent, cc.client.tx.end());
+    std::vector<castFrame_t> frames = decodeFrames(written);
+    for(size_t i = 0; i < frames.size(); i++)
+      if ( frames[i].payload == "{\"type\": \"PING\"}" )
+        feed(cc, castFrame(frames[i].destination, frames[i].nameSpace, "{\"type\":\"PONG\"}"));
+      else if ( frames[i].payload.find("GET_STATUS") != std::string::npos )
+        feed(cc, frames[i].nameSpace == CC_NS_MEDIA ?
+          castFrame(SESSION_ID, CC_NS_MEDIA, mediaStatus(1)) :
+          castFrame("receiver-0", CC_NS_RECEIVER, RECEIVER_STATUS));
+    hostAdvance(100);
+  }
+}
+
+static int count(ArduCastControl &cc, const char *type){
+  std::vector<std::string> sent = sentPayloads(cc);
+  int found = 0;
+  for(size_t i = 0; i < sent.size(); i++)
+    if ( sent[i].find(type) != std::string::npos )
+      found++;
+  return found;
+}
+
+int main(){
+  ArduCastControl cc;
+  cc.setPushMode(true, 10000);
+  joinApplication(cc);
+  CHECK(cc.getConnection() == APPLICATION_RUNNING);
+
+  //a status pushed every 5 s, no polls needed
+  cc.client.tx.clear();
+  const pushStats_t &stats = cc.getPushStats();
+  uint32_t pushed = stats.statusPushed;
+  for(int i = 0; i < 6; i++){
+    feed(cc, castFrame(SESSION_ID, CC_NS_MEDIA, mediaStatus(0, "PLAYING", 20 + 5*i)));
+    feed(cc, castFrame("receiver-0", CC_NS_RECEIVER, std::string(RECEIVER_STATUS).replace(13, 1, "0")));
+    run(cc, 5000);
+  }
+  CHECK(count(cc, "GET_STATUS") == 0);
+  CHECK(stats.statusPushed == pushed + 12 && stats.pollsAvoided > 0);
+  //one avoided poll per channel at most every RESPONSE_TIMEOUT, not one per loop()
+  CHECK(stats.pollsAvoided <= 2 * (30000 / RESPONSE_TIMEOUT + 1));
+  CHECK(cc.currentTime >= 45);
+  //the pushed RECEIVER_STATUS didn't reconnect to the application
+  CHECK(count(cc, "CONNECT") == 0);
+
+  //nothing pushed: polled after the fallback interval, not before
+  run(cc, 4000);
+  CHECK(count(cc, "GET_STATUS") == 0);
+  //but the channels are kept alive
+  CHECK(count(cc, "PING") > 0);
+  run(cc, 2000);
+  CHECK(count(cc, "GET_STATUS") > 0);
+  CHECK(stats.pollsSent > 0);
+  CHECK(cc.getConnection() == APPLICATION_RUNNING);
+
+  //chromecast pings us, answered with a pong on the same channel
+  cc.client.tx.clear();
+  feed(cc, castFrame(SESSION_ID, "urn:x-cast:com.google.cast.tp.heartbeat", "{\"type\":\"PING\"}"));
+  cc.loop();
+  std::vector<castFrame_t> frames = decodeFrames(cc.client.tx);
+  CHECK(frames.size() >= 1);
+  CHECK(frames[0].payload == "{\"type\": \"PONG\"}" && frames[0].destination == SESSION_ID);
+
+  //without push mode, polled every few seconds
+  ArduCastControl polling;
+  joinApplication(polling);
+  polling.client.tx.clear();
+  run(polling, 20000);
+  CHECK(count(polling, "GET_STATUS") >= 4);
+  printf("test_push_mode ok\n");
+  return 0;
+}
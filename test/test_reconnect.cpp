@@ -0,0 +1,83 @@
+/**
+ * Reconnection: rejoining the application after the connection is lost,
+ * back-off while the device is unreachable, and the copy of the host
+ */
+
+#include "cast_test.h"
+
+int main(){
+  ArduCastControl cc;
+  cc.setPushMode(true);
+  cc.setAutoReconnect(true, 1000, 8000);
+  //the host is copied, the buffer can be reused after connect()
+  char host[HOST_NAME_SIZE];
+  strcpy(host, "1.2.3.4");
+  CHECK(cc.connect(host) == 0);
+  strcpy(host, "9.9.9.9");
+  feed(cc, castFrame("receiver-0", CC_NS_RECEIVER, RECEIVER_STATUS));
+  cc.loop();
+  cc.loop();
+  feed(cc, castFrame(SESSION_ID, CC_NS_MEDIA, mediaStatus(1)));
+  cc.loop();
+  CHECK(cc.getConnection() == APPLICATION_RUNNING && cc.mediaSessionId == 3);
+
+  //lost: reconnected to the same host in the same loop, the application is rejoined right away
+  cc.client.stop();
+  cc.client.tx.clear();
+  uint32_t connects = cc.client.connects;
+  cc.loop();
+  CHECK(cc.client.connects == connects + 1);
+  CHECK(strcmp(cc.host, "1.2.3.4") == 0);
+  std::vector<castFrame_t> sent = decodeFrames(cc.client.tx);
+  CHECK(sent.size() == 3);
+  CHECK(jsonField(sent[0].payload, "type") == "CONNECT" && sent[0].destination == "receiver-0");
+  CHECK(jsonField(sent[1].payload, "type") == "CONNECT" && sent[1].destination == SESSION_ID);
+  CHECK(jsonField(sent[2].payload, "type") == "GET_STATUS" && sent[2].destination == SESSION_ID);
+  CHECK(cc.getConnection() == WAIT_FOR_RESPONSE);
+  //the media session is remembered
+  CHECK(cc.next() == 0);
+
+  //the same host in another buffer is the same device
+  char same[] = "1.2.3.4";
+  CHECK(cc.connect(same) == 0);
+  CHECK(strcmp(cc.sessionId, SESSION_ID) == 0);
+
+  //unreachable: exponential, jittered back-off
+  cc.client.stop();
+  cc.client.refuse = true;
+  connects = cc.client.connects;
+  cc.loop();
+  CHECK(cc.client.connects == connects + 1);
+  uint32_t wait = cc.getSleepTime();
+  CHECK(wait >= 500 && wait <= 1000);
+  cc.loop();
+  CHECK(cc.client.connects == connects + 1);
+  hostAdvance(wait);
+  cc.loop();
+  CHECK(cc.client.connects == connects + 2);
+  wait = cc.getSleepTime();
+  CHECK(wait >= 1000 && wait <= 2000);
+  for(int i = 0; i < 6; i++){
+    hostAdvance(cc.getSleepTime());
+    cc.loop();
+  }
+  wait = cc.getSleepTime();
+  CHECK(wait >= 4000 && wait <= 8000);
+  cc.client.refuse = false;
+  hostAdvance(wait);
+  cc.loop();
+  CHECK(cc.client.connects == connects + 9 && cc.client.connected());
+  CHECK(cc.backoff == 1000);
+
+  //another host is another device, the application is forgotten
+  CHECK(cc.connect(host) == 0);
+  CHECK(strcmp(cc.host, "9.9.9.9") == 0);
+  CHECK(cc.sessionId[0] == '\0' && cc.getConnection() == CONNECTED);
+
+  //doesn't fit
+  std::string longHost(HOST_NAME_SIZE, 'a');
+  CHECK(cc.connect(longHost.c_str()) == -10);
+  CHECK(strcmp(cc.host, "9.9.9.9") == 0);
+  printf("test_reconnect ok\n");
+  return 0;
+}
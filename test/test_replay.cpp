@@ -0,0 +1,107 @@
+/**
+ * Replay (ARDUCAST_REPLAY) of the session captured by test_capture: the
+ * status after the replay is the same as at the end of the capture
+ */
+
+#include "cast_test.h"
+
+#ifndef ARDUCAST_REPLAY
+#error "build with ARDUCAST_REPLAY"
+#endif
+
+/**
+ * Reads a capture from memory, like a file
+ */
+class MemoryStream : public Stream {
+public:
+  const std::vector<uint8_t> &data;
+  size_t pos = 0;
+
+  MemoryStream(const std::vector<uint8_t> &_data) : data(_data) {}
+  int available() { return data.size() - pos; }
+  int read() { return pos < data.size() ? data[pos++] : -1; }
+  int peek() { return pos < data.size() ? data[pos] : -1; }
+  size_t write(const uint8_t*, size_t len) { return len; }
+};
+
+/**
+ * Runs the loop until the end of the replay, returns the simulated time it
+ * took
+ */
+static uint32_t replay(ArduCastControl &cc){
+  unsigned long start = millis();
+  CHECK(cc.connect("replay") == 0);
+  for(int loops = 0; cc.loop() != DISCONNECTED && loops < 100000; loops++)
+    hostAdvance(10);
+  return millis() - start;
+}
+
+/**
+ * Checks the status at the end of the captured session
+ */
+static void checkStatus(ArduCastControl &cc){
+  CHECK(strcmp(cc.displayName, "Spotify") == 0);
+  CHECK(strcmp(cc.title, "Pushed title") == 0 && strcmp(cc.artist, "Artist") == 0);
+  CHECK(cc.playerState == PAUSED && cc.mediaSessionId == 1);
+  //the volume change went to the ring, not to the file
+  CHECK(cc.volume > 0.39 && cc.volume < 0.41);
+  CHECK(cc.getMetrics().parseErrors == 0 && cc.getMetrics().framesMalformed == 0);
+}
+
+int main(){
+  FILE *in = fopen("session.acap", "rb");
+  CHECK(in != NULL);
+  std::vector<uint8_t> capture;
+  uint8_t chunk[512];
+  size_t got;
+  while ( (got = fread(chunk, 1, sizeof(chunk), in)) > 0 )
+    capture.insert(capture.end(), chunk, chunk + got);
+  fclose(in);
+
+  //frames received in the capture, and the time from the first record to the last one
+  uint32_t frames = 0, firstAt = 0, lastAt = 0;
+  for(size_t pos = CAPTURE_HEADER_SIZE; pos + CAPTURE_RECORD_HEADER_SIZE <= capture.size(); ){
+    uint32_t at = (capture[pos] << 24) | (capture[pos+1] << 16) | (capture[pos+2] << 8) | capture[pos+3];
+    uint32_t len = (capture[pos+5] << 24) | (capture[pos+6] << 16) | (capture[pos+7] << 8) | capture[pos+8];
+    if ( pos == CAPTURE_HEADER_SIZE )
+      firstAt = at;
+    lastAt = at;
+    if ( capture[pos+4] == CAPTURE_RX )
+      frames++;
+    pos += CAPTURE_RECORD_HEADER_SIZE + len;
+  }
+  CHECK(frames > 0);
+
+  //from memory, as fast as possible
+  ArduCastControl fast;
+  CHECK(fast.getClient().begin(capture.data(), capture.size(), 0));
+  uint32_t took = replay(fast);
+  CHECK(fast.getClient().getFrames() == frames);
+  checkStatus(fast);
+  CHECK(took < lastAt - firstAt);
+  //a capture is a single connection
+  CHECK(fast.connect("replay") == -10);
+
+  //from a stream, at the original speed
+  MemoryStream stream(capture);
+  ArduCastControl original;
+  CHECK(original.getClient().begin(stream, 1));
+  took = replay(original);
+  CHECK(original.getClient().getFrames() == frames);
+  checkStatus(original);
+  CHECK(took >= lastAt - firstAt);
+
+  //not a capture
+  ArduCastControl bad;
+  uint8_t header[CAPTURE_HEADER_SIZE] = {'X', 'C', 'A', 'P', 1};
+  CHECK(!bad.getClient().begin(header, sizeof(header)));
+  //a truncated capture ends the replay early
+  for(size_t len = CAPTURE_HEADER_SIZE; len < capture.size(); len += 37){
+    ArduCastControl truncated;
+    CHECK(truncated.getClient().begin(capture.data(), len, 0));
+    replay(truncated);
+    CHECK(truncated.getClient().getFrames() <= frames);
+  }
+  printf("test_replay ok\n");
+  return 0;
+}
@@ -0,0 +1,83 @@
+/**
+ * A whole session against the stand-in receiver: connection, joining the
+ * running application, commands, keepalive and status pushed by the device
+ */
+
+#include "cast_test.h"
+
+static const char APP_SESSION[] = "0b8c8f0e-5d3a-4c1e-9a0b-6f2d7e1c3a55";
+
+static int lastResult = 1;
+
+static void onCommand(uint32_t, int result, void*){
+  lastResult = result;
+}
+
+/**
+ * Runs the loop for \ref ms of simulated time
+ */
+static void run(ArduCastControl &cc, uint32_t ms){
+  for(uint32_t t = 0; t < ms; t += 10){
+    cc.loop();
+    hostAdvance(10);
+  }
+}
+
+int main(){
+  FakeReceiver receiver;
+  receiver.launch("CC32E753", "Spotify", APP_SESSION);
+  receiver.replyDelay = 30;
+
+  ArduCastControl cc;
+  cc.client.peer = &receiver;
+  CHECK(cc.connect("192.168.1.12") == 0);
+  run(cc, 2000);
+  CHECK(receiver.deviceConnected && receiver.appConnected);
+  CHECK(cc.getConnection() == APPLICATION_RUNNING);
+  CHECK(strcmp(cc.displayName, "Spotify") == 0 && strcmp(cc.title, "Title") == 0);
+  CHECK(cc.volume > 0.39 && cc.volume < 0.41);
+  CHECK(cc.playerState == PLAYING && cc.mediaSessionId == 1);
+
+  //commands, answered by the receiver with the requestId
+  CHECK(cc.pause(false, onCommand) == 0);
+  run(cc, 200);
+  CHECK(lastResult == 0 && cc.playerState == PAUSED && receiver.playerState == "PAUSED");
+  lastResult = 1;
+  CHECK(cc.next(onCommand) == 0);
+  run(cc, 200);
+  CHECK(lastResult == 0 && strcmp(cc.title, "Next title") == 0);
+  lastResult = 1;
+  CHECK(cc.setVolume(false, 0.7, onCommand) == 0);
+  run(cc, 200);
+  CHECK(lastResult == 0 && cc.volume > 0.69 && cc.volume < 0.71);
+
+  //keepalive: a minute later still connected, both channels pinged
+  run(cc, 60000);
+  CHECK(cc.getConnection() == APPLICATION_RUNNING);
+  CHECK(receiver.count("PING") >= 2);
+
+  //status pushed by the device, e.g. the track changed on the phone
+  receiver.title = "Pushed title";
+  receiver.push(millis(), APP_SESSION, CC_NS_MEDIA, receiver.mediaStatus(0));
+  run(cc, 100);
+  CHECK(strcmp(cc.title, "Pushed title") == 0);
+
+  //the application is stopped by another sender
+  receiver.stopApp();
+  receiver.push(millis(), "receiver-0", CC_NS_RECEIVER, receiver.receiverStatus(0));
+  receiver.push(millis(), APP_SESSION, CC_NS_CONNECTION, "{\"type\":\"CLOSE\"}");
+  run(cc, 2000);
+  CHECK(cc.sessionId[0] == '\0' && cc.displayName[0] == '\0');
+  CHECK(cc.applicationConnection.getConnectionStatus() == CH_DISCONNECTED);
+
+  //the device stops answering, the connection is dropped
+  receiver.responding = false;
+  run(cc, 120000);
+  CHECK(cc.getConnection() == DISCONNECTED);
+
+  const castMetrics_t &metrics = cc.getMetrics();
+  CHECK(metrics.parseErrors == 0 && metrics.framesMalformed == 0);
+  CHECK(metrics.ns[NS_MEDIA].framesIn >= 4 && metrics.ns[NS_RECEIVER].framesIn >= 2);
+  printf("test_session ok\n");
+  return 0;
+}
@@ -0,0 +1,38 @@
+/**
+ * Sleep time of an instance and of a hub, until the next deadline
+ */
+
+#include "cast_test.h"
+#include "ArduCastHub.h"
+
+int main(){
+  ArduCastHub hub;
+  ArduCastControl a(hub.getBuffer()), b(hub.getBuffer());
+  //nothing to do
+  CHECK(hub.getSleepTime() == UINT32_MAX);
+  a.setPushMode(true);
+  b.setPushMode(true);
+  CHECK(hub.add(a, "1.1.1.1") == 0);
+  CHECK(hub.add(b, "1.1.1.2") == 0);
+  //connecting is due
+  CHECK(hub.getSleepTime() == 0);
+  hub.loop();
+  CHECK(a.getConnection() != DISCONNECTED && b.getConnection() == DISCONNECTED);
+
+  feed(a, castFrame("receiver-0", CC_NS_RECEIVER, "{\"type\":\"RECEIVER_STATUS\",\"status\":{\"volume\":{\"level\":0.1}}}"));
+  //data is waiting
+  CHECK(a.getSleepTime() == 0);
+  a.loop();
+  CHECK(a.getSleepTime() == PING_TIMEOUT + 1);
+  //b still has to connect
+  CHECK(hub.getSleepTime() == 0);
+  hub.loop();
+  CHECK(b.getConnection() != DISCONNECTED);
+  b.loop();
+  uint32_t sleep = hub.getSleepTime();
+  CHECK(sleep > 0 && sleep <= a.getSleepTime() && sleep <= b.getSleepTime());
+  hostAdvance(sleep);
+  CHECK(hub.getSleepTime() == 0);
+  printf("test_sleep ok\n");
+  return 0;
+}
@@ -0,0 +1,81 @@
+/**
+ * Tracking of the changed status fields, and the estimated playback position
+ */
+
+#include "cast_test.h"
+
+static int changes = 0;
+static uint16_t lastChanged = 0;
+
+static void onChange(ArduCastControl &, uint16_t changed, void*){
+  changes++;
+  lastChanged = changed;
+}
+
+int main(){
+  ArduCastControl cc;
+  CHECK(cc.onChange(SF_MEDIA | SF_PLAYER_STATE | SF_VOLUME, onChange) == 0);
+  CHECK(cc.connect("1.2.3.4") == 0);
+  feed(cc, castFrame("receiver-0", CC_NS_RECEIVER, RECEIVER_STATUS));
+  cc.loop();
+  hostAdvance(600);
+  cc.loop();
+  CHECK(cc.getDirty() == (SF_VOLUME | SF_APPLICATION));
+  //only the fields the callback registered for
+  CHECK(changes == 1 && lastChanged == SF_VOLUME);
+  cc.clearDirty();
+
+  feed(cc, castFrame(SESSION_ID, CC_NS_MEDIA, mediaStatus(1)));
+  cc.loop();
+  CHECK(cc.getDirty() == (SF_PLAYER_STATE | SF_CURRENT_TIME | SF_MEDIA));
+  CHECK(changes == 2 && lastChanged == (SF_PLAYER_STATE | SF_MEDIA));
+  cc.clearDirty();
+
+  //only the position changed, nobody is notified
+  feed(cc, castFrame(SESSION_ID, CC_NS_MEDIA, mediaStatus(1, "PLAYING", 13)));
+  cc.loop();
+  CHECK(cc.getDirty() == SF_CURRENT_TIME && changes == 2);
+  cc.clearDirty(SF_CURRENT_TIME);
+  CHECK(cc.getDirty() == 0);
+
+  //the same status again is not a change
+  feed(cc, castFrame(SESSION_ID, CC_NS_MEDIA, mediaStatus(1, "PLAYING", 13)));
+  cc.loop();
+  CHECK(cc.getDirty() == 0 && changes == 2);
+
+  //estimated from the last reported position while playing
+  hostAdvance(2500);
+  CHECK(cc.getEstimatedTime() > 15.49 && cc.getEstimatedTime() < 15.51);
+  cc.client.tx.clear();
+  CHECK(cc.seek(true, 10) == 0);
+  std::vector<std::string> sent = sentPayloads(cc);
+  CHECK(sent.size() == 1 && jsonNumber(sent[0], "currentTime") > 25.49 && jsonNumber(sent[0], "currentTime") < 25.51);
+  //never past the end
+  feed(cc, castFrame(SESSION_ID, CC_NS_MEDIA, mediaStatus(1, "PLAYING", 330)));
+  cc.loop();
+  hostAdvance(10000);
+  CHECK(cc.getEstimatedTime() > 333.8 && cc.getEstimatedTime() < 334);
+  cc.clearDirty();
+
+  feed(cc, castFrame(SESSION_ID, CC_NS_MEDIA, mediaStatus(1, "PAUSED", 13)));
+  cc.loop();
+  CHECK(cc.getDirty() == (SF_PLAYER_STATE | SF_CURRENT_TIME) && lastChanged == SF_PLAYER_STATE);
+  //stands still while paused
+  hostAdvance(5000);
+  CHECK(cc.getEstimatedTime() == 13);
+
+  //a new playback rate has its own bit
+  cc.clearDirty();
+  std::string faster = mediaStatus(1, "PAUSED", 13);
+  faster.replace(faster.find("\"playbackRate\":1"), 16, "\"playbackRate\":2");
+  feed(cc, castFrame(SESSION_ID, CC_NS_MEDIA, faster));
+  cc.loop();
+  CHECK(cc.getDirty() == SF_PLAYBACK_RATE && cc.playbackRate == 2);
+
+  cc.removeOnChange(onChange);
+  feed(cc, castFrame(SESSION_ID, CC_NS_MEDIA, mediaStatus(1, "PLAYING", 13)));
+  cc.loop();
+  CHECK(changes == 3);
+  printf("test_status ok\n");
+  return 0;
+}
@@ -0,0 +1,68 @@
+/**
+ * The string table used to look up the sources and namespaces of the
+ * received messages
+ */
+
+#include "cast_test.h"
+#include "ArduCastStringTable.h"
+#include <random>
+
+int main(){
+  //random operations, compared with std::map
+  stringTableEntry_t entries[16];
+  ArduCastStringTable table(entries, 16);
+  std::mt19937 rng(3);
+  std::vector<std::string> pool;
+  for(int i = 0; i < 40; i++)
+    pool.push_back("ns." + std::to_string(rng() % 1000));
+  std::map<std::string, uint8_t> reference;
+  for(int it = 0; it < 20000; it++){
+    int op = rng() % 3;
+    std::string &s = pool[rng() % pool.size()];
+    if ( op == 0 ){
+      uint8_t id = 1 + rng() % 5;
+      if ( table.add(s.c_str(), id) == 0 )
+        reference[s] = id;
+      else
+        CHECK(reference.size() >= 15 && !reference.count(s));
+    } else if ( op == 1 ){
+      uint8_t id = 1 + rng() % 5;
+      table.remove(id);
+      for(std::map<std::string, uint8_t>::iterator i = reference.begin(); i != reference.end(); ){
+        if ( i->second == id )
+          reference.erase(i++);
+        else
+          ++i;
+      }
+    }
+    for(size_t i = 0; i < pool.size(); i++){
+      uint8_t expected = reference.count(pool[i]) ? reference[pool[i]] : 0;
+      CHECK(table.lookup((const uint8_t*)pool[i].data(), pool[i].size()) == expected);
+    }
+    //a prefix is not a match
+    for(std::map<std::string, uint8_t>::iterator i = reference.begin(); i != reference.end(); ++i){
+      std::string prefix = i->first.substr(0, i->first.size() - 1);
+      CHECK(table.lookup((const uint8_t*)prefix.data(), prefix.size()) == 0 || reference.count(prefix));
+    }
+  }
+
+  //the status of an unknown source is ignored
+  ArduCastControl cc;
+  CHECK(cc.connect("1.2.3.4") == 0);
+  feed(cc, castFrame("receiver", CC_NS_RECEIVER, RECEIVER_STATUS));
+  cc.loop();
+  CHECK(cc.volume == -1);
+  feed(cc, castFrame("receiver-0", CC_NS_RECEIVER, RECEIVER_STATUS));
+  hostAdvance(600);
+  cc.loop();
+  CHECK(cc.volume == 0.4f);
+  //the application is added as a source once joined
+  hostAdvance(600);
+  cc.loop();
+  feed(cc, castFrame(SESSION_ID, CC_NS_MEDIA, mediaStatus(0)));
+  hostAdvance(600);
+  cc.loop();
+  CHECK(cc.currentTime > 12);
+  printf("test_string_table ok\n");
+  return 0;
+}
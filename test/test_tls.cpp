@@ -0,0 +1,66 @@
+/**
+ * A session over TCP and TLS: the stand-in receiver served by a TlsReceiver
+ * on the loopback interface, so the frames arrive split into TLS records
+ * and delayed by the socket, like on the network
+ */
+
+#include "cast_test.h"
+#include "TlsReceiver.h"
+
+#include <unistd.h>
+
+static const char APP_SESSION[] = "0b8c8f0e-5d3a-4c1e-9a0b-6f2d7e1c3a55";
+
+static int lastResult = 1;
+
+static void onCommand(uint32_t, int result, void*){
+  lastResult = result;
+}
+
+/**
+ * Runs the loop until \ref done, for at most 5 s of real time. The
+ * simulated clock follows the real one, so the timeouts of the library
+ * see the real latency.
+ */
+template<typename Done> static bool runUntil(ArduCastControl &cc, Done done){
+  for(int i = 0; i < 5000; i++){
+    cc.loop();
+    if ( done() )
+      return true;
+    usleep(1000);
+    hostAdvance(1);
+  }
+  return false;
+}
+
+int main(){
+  FakeReceiver receiver;
+  receiver.launch("CC32E753", "Spotify", APP_SESSION);
+  TlsReceiver server(receiver);
+  uint16_t port = server.start();
+  CHECK(port != 0);
+
+  ArduCastControl cc;
+  cc.client.tls = true;
+  cc.client.tlsPort = port;
+  CHECK(cc.connect("127.0.0.1") == 0);
+  CHECK(runUntil(cc, [&]{ return cc.getConnection() == APPLICATION_RUNNING && cc.mediaSessionId == 1; }));
+  CHECK(strcmp(cc.displayName, "Spotify") == 0 && strcmp(cc.title, "Title") == 0);
+
+  CHECK(cc.pause(false, onCommand) == 0);
+  CHECK(runUntil(cc, [&]{ return lastResult != 1; }));
+  CHECK(lastResult == 0 && cc.playerState == PAUSED);
+  lastResult = 1;
+  CHECK(cc.next(onCommand) == 0);
+  CHECK(runUntil(cc, [&]{ return lastResult != 1; }));
+  CHECK(lastResult == 0 && strcmp(cc.title, "Next title") == 0);
+
+  //closed by the receiver, noticed by the library
+  server.stop();
+  CHECK(runUntil(cc, [&]{ return cc.getConnection() == DISCONNECTED; }));
+  CHECK(server.connections == 1 && receiver.fullHandshakes == 1);
+  CHECK(receiver.count("PAUSE") == 1 && receiver.count("QUEUE_NEXT") == 1);
+  CHECK(receiver.framesIn == decodeFrames(cc.client.tx).size());
+  printf("test_tls ok\n");
+  return 0;
+}
@@ -0,0 +1,53 @@
+/**
+ * TLS session resumption (TLS_SESSION_CACHE): the session is resumed when
+ * reconnecting to the same host, and never offered to another one
+ */
+
+#include "cast_test.h"
+
+#if !TLS_SESSION_CACHE
+#error "build with TLS_SESSION_CACHE=1"
+#endif
+
+int main(){
+  FakeReceiver receiver;
+  receiver.handshakeTime = 2000;
+  receiver.resumeTime = 150;
+  ArduCastControl cc;
+  cc.client.peer = &receiver;
+  cc.setAutoReconnect(true);
+
+  char host[HOST_NAME_SIZE];
+  strcpy(host, "192.168.1.12");
+  CHECK(cc.connect(host) == 0);
+  CHECK(receiver.fullHandshakes == 1 && cc.getConnectTime() == 2000);
+
+  //the connection is lost, loop() reconnects with the session
+  cc.client.stop();
+  cc.loop();
+  CHECK(cc.client.connected());
+  CHECK(receiver.resumedHandshakes == 1 && cc.getConnectTime() == 150);
+
+  //the same host in another buffer
+  char same[] = "192.168.1.12";
+  CHECK(cc.connect(same) == 0);
+  CHECK(receiver.resumedHandshakes == 2 && cc.getConnectTime() == 150);
+
+  //the buffer reused for another device: full handshake, the session of
+  //the first one is not offered
+  strcpy(host, "192.168.1.13");
+  CHECK(cc.connect(host) == 0);
+  CHECK(receiver.fullHandshakes == 2 && cc.getConnectTime() == 2000);
+  CHECK(receiver.foreignSessions == 0);
+  cc.client.stop();
+  cc.loop();
+  CHECK(receiver.resumedHandshakes == 3 && cc.getConnectTime() == 150);
+
+  //another port is another device too (e.g. an audio group)
+  CHECK(cc.connect("192.168.1.13", 32187) == 0);
+  CHECK(receiver.fullHandshakes == 3 && receiver.foreignSessions == 0);
+
+  printf("full handshake %u ms, resumed %u ms\n", receiver.handshakeTime, receiver.resumeTime);
+  printf("test_tls_resume ok\n");
+  return 0;
+}
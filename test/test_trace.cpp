@@ -0,0 +1,38 @@
+/**
+ * Trace points, built with and without ARDUCAST_TRACE
+ */
+
+#include "cast_test.h"
+
+int main(){
+  ArduCastControl cc;
+  CHECK(cc.connect("1.2.3.4") == 0);
+  cc.loop();
+  feed(cc, castFrame("receiver-0", CC_NS_RECEIVER, RECEIVER_STATUS));
+  cc.loop();
+#if ARDUCAST_TRACE
+  CHECK(ArduCastTrace::getCount() > 5);
+  bool json = false, read = false, write = false;
+  for(uint16_t i = 0; i < ArduCastTrace::getCount(); i++){
+    const traceRecord_t *record = ArduCastTrace::get(i);
+    json |= record->event == TRACE_JSON_PARSE;
+    read |= record->event == TRACE_FRAME_READ;
+    write |= record->event == TRACE_WRITE;
+  }
+  CHECK(json && read && write);
+  //the ring keeps the last records
+  for(int i = 0; i < 50; i++){
+    feed(cc, castFrame("receiver-0", CC_NS_RECEIVER, RECEIVER_STATUS));
+    cc.loop();
+  }
+  CHECK(ArduCastTrace::getCount() == TRACE_BUFFER_SIZE);
+  ArduCastTrace::dump(Serial);
+  ArduCastTrace::clear();
+  CHECK(ArduCastTrace::getCount() == 0 && ArduCastTrace::get(0) == NULL);
+#else
+  CHECK(ArduCastTrace::getCount() == 0 && ArduCastTrace::get(0) == NULL);
+  ArduCastTrace::dump(Serial);
+#endif
+  printf("test_trace ok\n");
+  return 0;
+}
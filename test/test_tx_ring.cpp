@@ -0,0 +1,82 @@
+/**
+ * The TX ring: partial writes by the TCP client keep the byte stream in
+ * order, and commands are queued while the client is not writable
+ */
+
+#include "cast_test.h"
+#include <random>
+
+int main(){
+  WiFiClientSecure client;
+  client.open = true;
+  uint8_t buffer[100];
+  ArduCastTxRing ring(client, buffer, sizeof(buffer));
+  std::mt19937 rng(1);
+  std::vector<uint8_t> expected;
+  uint8_t counter = 0;
+  int full = 0;
+  for(int i = 0; i < 20000; i++){
+    client.writeLimit = rng() % 30;
+    uint32_t len = 1 + rng() % 60;
+    uint8_t *p = ring.reserve(len);
+    if ( p != NULL ){
+      for(uint32_t k = 0; k < len; k++){
+        p[k] = counter;
+        expected.push_back(counter++);
+      }
+      ring.commit(len);
+    } else {
+      full++;
+    }
+    ring.flush();
+    CHECK(ring.pending() <= sizeof(buffer));
+  }
+  client.writeLimit = SIZE_MAX;
+  ring.flush();
+  CHECK(ring.pending() == 0);
+  CHECK(client.tx == expected);
+  CHECK(full > 0 && ring.getHighWater() == sizeof(buffer));
+  //never fits
+  CHECK(ring.reserve(sizeof(buffer) + 1) == NULL);
+  ArduCastConnection connection(client, 5000, ring, CC_NS_MEDIA);
+  connection.connect(SESSION_ID);
+  CHECK(connection.writePing() == -2);
+  CHECK(connection.writeGetStatus() == -2);
+  CHECK(connection.writeMsg(CC_NS_HEARTBEAT, "{\"type\": \"PING\"}") == -2);
+  //fits, but only after the ring is flushed
+  uint8_t small[60];
+  ArduCastTxRing smallRing(client, small, sizeof(small));
+  ArduCastConnection tiny(client, 5000, smallRing, CC_NS_MEDIA);
+  tiny.connect("r");
+  client.writeLimit = 0;
+  CHECK(tiny.writeMsg("n", "0123456789") == 0);
+  CHECK(tiny.writeMsg("n", "0123456789") == -3);
+  client.writeLimit = SIZE_MAX;
+  smallRing.flush();
+  CHECK(tiny.writeMsg("n", "0123456789") == 0);
+  //longer than the protocol allows
+  CHECK(connection.getMsgLength(CC_NS_MEDIA, MAX_MESSAGE_SIZE) == -2);
+  CHECK(connection.getMsgLength(CC_NS_MEDIA, MAX_MESSAGE_SIZE - 200) > MAX_MESSAGE_SIZE - 200);
+
+  //commands while the client doesn't accept anything
+  ArduCastControl cc;
+  joinApplication(cc);
+  cc.client.tx.clear();
+  cc.client.writeLimit = 0;
+  for(int i = 0; i < 4; i++)
+    CHECK(cc.setVolume(false, 0.1 * i) == 0);
+  uint32_t queued = cc.txRing.pending();
+  CHECK(queued > 0 && cc.client.tx.empty());
+  cc.client.writeLimit = SIZE_MAX;
+  cc.loop();
+  cc.loop();
+  std::vector<std::string> sent = sentPayloads(cc);
+  CHECK(sent.size() >= 4);
+  for(int i = 0; i < 4; i++){
+    CHECK(jsonField(sent[i], "type") == "SET_VOLUME");
+    CHECK(jsonNumber(sent[i], "requestId") == 2 + i);
+  }
+  CHECK(cc.getMemoryStats().txHighWater >= queued);
+  printf("test_tx_ring ok\n");
+  return 0;
+}